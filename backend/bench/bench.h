@@ -0,0 +1,36 @@
+#pragma once
+
+#include "core.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+// Microbenchmarks of the hot paths, built as `schedd-bench`. Every section prints one line per case.
+// Times are the fastest of `BenchRepetitions` runs, so they're comparable between cases rather than absolute.
+
+constexpr size_t BenchRepetitions = 5;
+
+extern volatile uint64_t _BenchSink; // results are folded into this, so the optimizer can't drop the work.
+
+// Nanoseconds per call of `func(iteration)`.
+template <typename TFunc>
+inline double bench_ns_per_iteration(const size_t iterations, TFunc &&func)
+{
+  int64_t fastestNs = INT64_MAX;
+
+  for (size_t run = 0; run < BenchRepetitions; run++)
+  {
+    const int64_t startNs = lsGetCurrentTimeNs();
+
+    for (size_t i = 0; i < iterations; i++)
+      func(i);
+
+    fastestNs = lsMin(fastestNs, lsGetCurrentTimeNs() - startNs);
+  }
+
+  return (double)fastestNs / (double)iterations;
+}
+
+void bench_lists();
+void bench_json_writer();
+void bench_response_compression();
+void bench_snapshot();
@@ -0,0 +1,150 @@
+#include "bench.h"
+
+#include "json_writer.h"
+
+#include "crow/json.h"
+
+#include <atomic>
+#include <new>
+
+//////////////////////////////////////////////////////////////////////////
+
+// Renders the `/task-search` response both ways: through the reused `json_writer` the handlers use now & through the `crow::json::wvalue` tree they used before.
+// Both end in the `std::string` that `crow::response` owns, which is the one allocation the writer can't avoid. Allocations through `operator new` are counted, the writer's own buffer is `lsRealloc`ated & only grows on the first response.
+
+constexpr size_t BenchJsonIterations = 20000;
+constexpr size_t BenchJsonWriterInitialCapacity = 4 * 1024; // as `ResponseWriterInitialCapacity`.
+
+static std::atomic<size_t> _BenchAllocationCount = 0;
+
+// Replaces the global allocation functions of the whole benchmark. Not inlined, otherwise the compiler pairs the `malloc` with the `delete` of the caller & warns.
+[[gnu::noinline]] void *operator new(const size_t size)
+{
+  _BenchAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+  if (void *pData = malloc(size > 0 ? size : 1))
+    return pData;
+
+  throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void *pData) noexcept
+{
+  free(pData);
+}
+
+[[gnu::noinline]] void operator delete(void *pData, const size_t) noexcept
+{
+  free(pData);
+}
+
+struct bench_json_result
+{
+  size_t id;
+  size_t durationInMinutes;
+  char name[32];
+  size_t nameLength;
+};
+
+static lsResult _BenchJsonWrite(json_writer *pWriter, const bench_json_result *pResults, const size_t count, _Out_ std::string *pBody)
+{
+  lsResult result = lsR_Success;
+
+  json_writer_reset(pWriter);
+
+  LS_ERROR_CHECK(json_writer_begin_object(pWriter));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "results"));
+  LS_ERROR_CHECK(json_writer_begin_array(pWriter));
+
+  for (size_t i = 0; i < count; i++)
+  {
+    LS_ERROR_CHECK(json_writer_begin_object(pWriter));
+    LS_ERROR_CHECK(json_writer_key(pWriter, "name"));
+    LS_ERROR_CHECK(json_writer_string(pWriter, pResults[i].name, pResults[i].nameLength));
+    LS_ERROR_CHECK(json_writer_key(pWriter, "duration"));
+    LS_ERROR_CHECK(json_writer_uint(pWriter, pResults[i].durationInMinutes));
+    LS_ERROR_CHECK(json_writer_key(pWriter, "id"));
+    LS_ERROR_CHECK(json_writer_uint(pWriter, pResults[i].id));
+    LS_ERROR_CHECK(json_writer_end_object(pWriter));
+  }
+
+  LS_ERROR_CHECK(json_writer_end_array(pWriter));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "truncated"));
+  LS_ERROR_CHECK(json_writer_bool(pWriter, false));
+  LS_ERROR_CHECK(json_writer_end_object(pWriter));
+
+  *pBody = std::string(pWriter->pBuffer, pWriter->size); // the copy `crow::response` is constructed from.
+
+epilogue:
+  return result;
+}
+
+static void _BenchJsonWvalue(const bench_json_result *pResults, const size_t count, _Out_ std::string *pBody)
+{
+  crow::json::wvalue ret;
+  crow::json::wvalue results = crow::json::rvalue(crow::json::type::List);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    auto &item = results[(uint32_t)i];
+    item["name"] = std::string(pResults[i].name, pResults[i].nameLength);
+    item["duration"] = pResults[i].durationInMinutes;
+    item["id"] = pResults[i].id;
+  }
+
+  ret["results"] = std::move(results);
+  ret["truncated"] = false;
+
+  *pBody = ret.dump();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void bench_json_writer()
+{
+  bench_json_result results[32];
+  json_writer writer;
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(results); i++)
+  {
+    results[i].id = i * 37;
+    results[i].durationInMinutes = 5 + (i % 12) * 5;
+    lsCopyString(results[i].name, LS_ARRAYSIZE(results[i].name), "Vacuum the \"Hallway\"", LS_ARRAYSIZE("Vacuum the \"Hallway\""));
+    results[i].nameLength = strlen(results[i].name);
+  }
+
+  if (LS_FAILED(json_writer_create(&writer, nullptr, BenchJsonWriterInitialCapacity)))
+  {
+    print_error_line("json_writer: failed to create the writer.");
+    return;
+  }
+
+  for (const size_t count : { (size_t)1, (size_t)8, LS_ARRAYSIZE(results) })
+  {
+    std::string writerBody, wvalueBody;
+
+    // Once up front, so the writer's buffer has grown. `wvalue` orders keys by its hash map, so only the sizes are comparable.
+    if (LS_FAILED(_BenchJsonWrite(&writer, results, count, &writerBody)))
+    {
+      print_error_line("json_writer: failed to write the response.");
+      break;
+    }
+
+    _BenchJsonWvalue(results, count, &wvalueBody);
+
+    if (writerBody.size() != wvalueBody.size())
+      print_error_line("json_writer: the bodies differ in size for ", count, " results.");
+
+    size_t allocationsBefore = _BenchAllocationCount.load(std::memory_order_relaxed);
+    const double writerNs = bench_ns_per_iteration(BenchJsonIterations, [&](const size_t) { _BenchJsonWrite(&writer, results, count, &writerBody); _BenchSink = _BenchSink + writerBody.size(); });
+    const double writerAllocations = (double)(_BenchAllocationCount.load(std::memory_order_relaxed) - allocationsBefore) / (BenchJsonIterations * BenchRepetitions);
+
+    allocationsBefore = _BenchAllocationCount.load(std::memory_order_relaxed);
+    const double wvalueNs = bench_ns_per_iteration(BenchJsonIterations, [&](const size_t) { _BenchJsonWvalue(results, count, &wvalueBody); _BenchSink = _BenchSink + wvalueBody.size(); });
+    const double wvalueAllocations = (double)(_BenchAllocationCount.load(std::memory_order_relaxed) - allocationsBefore) / (BenchJsonIterations * BenchRepetitions);
+
+    print("json_writer: search response, ", count, " results, ", writerBody.size(), " bytes: json_writer ", FD(Frac(1))(writerNs), " ns & ", FD(Frac(1))(writerAllocations), " allocations, wvalue ", FD(Frac(1))(wvalueNs), " ns & ", FD(Frac(1))(wvalueAllocations), " allocations.\n");
+  }
+
+  json_writer_destroy(&writer);
+}
@@ -0,0 +1,99 @@
+#include "bench.h"
+
+#include "schedd.h"
+
+#include <memory>
+
+//////////////////////////////////////////////////////////////////////////
+
+// The per-event & per-day lists used to be `local_list`s with hard bounds, now they're `small_list`s that spill to the heap.
+// The common case (a few users per event, a few tasks per day) has to stay as cheap as it was, spilling only pays off for large households.
+// Lists live in `pool` blocks, so they're measured in an array of them: filled like the scheduler does & read like the handlers do.
+
+constexpr size_t BenchListCount = 1024;
+constexpr size_t BenchListIterations = 200;
+constexpr size_t BenchListIdCount = 256; // power of 2.
+constexpr size_t BenchListFormerMaxUsersPerEvent = 16;
+constexpr size_t BenchListFormerMaxEventsPerUserPerDay = 32;
+
+struct bench_list_result
+{
+  double fillNs, readNs; // per list.
+};
+
+template <typename TList>
+static bench_list_result _BenchList(const size_t count)
+{
+  std::unique_ptr<TList[]> lists(new TList[BenchListCount]);
+  size_t ids[BenchListIdCount];
+
+  for (size_t i = 0; i < BenchListIdCount; i++)
+    ids[i] = (i * 7919) & (BenchListCount - 1);
+
+  bench_list_result result;
+
+  result.fillNs = bench_ns_per_iteration(BenchListIterations, [&](const size_t iteration)
+    {
+      for (size_t i = 0; i < BenchListCount; i++)
+      {
+        list_clear(&lists[i]);
+
+        for (size_t j = 0; j < count; j++)
+          list_add(&lists[i], ids[(i + j + iteration) & (BenchListIdCount - 1)]);
+      }
+    }) / BenchListCount;
+
+  result.readNs = bench_ns_per_iteration(BenchListIterations, [&](const size_t iteration)
+    {
+      uint64_t sum = 0;
+
+      for (size_t i = 0; i < BenchListCount; i++)
+      {
+        for (const size_t id : lists[i])
+          sum += id;
+
+        if (list_contains(lists[i], iteration & (BenchListCount - 1)) != nullptr)
+          sum++;
+      }
+
+      _BenchSink = _BenchSink + sum;
+    }) / BenchListCount;
+
+  return result;
+}
+
+template <typename TFormer, typename TCurrent>
+static void _BenchListCompare(const char *name, const size_t count)
+{
+  const bench_list_result former = _BenchList<TFormer>(count);
+  const bench_list_result current = _BenchList<TCurrent>(count);
+
+  print("lists: ", name, ", ", count, " entries: fill local_list ", FD(Frac(1))(former.fillNs), " ns, small_list ", FD(Frac(1))(current.fillNs), " ns; read local_list ", FD(Frac(1))(former.readNs), " ns, small_list ", FD(Frac(1))(current.readNs), " ns.\n");
+}
+
+template <typename TCurrent>
+static void _BenchListSpilled(const char *name, const size_t count)
+{
+  const bench_list_result current = _BenchList<TCurrent>(count);
+
+  print("lists: ", name, ", ", count, " entries (spilled): fill small_list ", FD(Frac(1))(current.fillNs), " ns; read small_list ", FD(Frac(1))(current.readNs), " ns.\n");
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void bench_lists()
+{
+  typedef local_list<size_t, BenchListFormerMaxUsersPerEvent> former_users_per_event;
+  typedef local_list<size_t, BenchListFormerMaxEventsPerUserPerDay> former_events_per_user_per_day;
+  typedef small_list<size_t, InlineUsersPerEvent> users_per_event;
+  typedef small_list<size_t, InlineEventsPerUserPerDay> events_per_user_per_day;
+
+  _BenchListCompare<former_users_per_event, users_per_event>("users per event", 1);
+  _BenchListCompare<former_users_per_event, users_per_event>("users per event", InlineUsersPerEvent);
+  _BenchListCompare<former_events_per_user_per_day, events_per_user_per_day>("events per user & day", 3);
+  _BenchListCompare<former_events_per_user_per_day, events_per_user_per_day>("events per user & day", InlineEventsPerUserPerDay);
+
+  // Beyond the former bounds, where the old lists would've dropped entries.
+  _BenchListSpilled<users_per_event>("users per event", 30);
+  _BenchListSpilled<events_per_user_per_day>("events per user & day", 200);
+}
@@ -0,0 +1,135 @@
+#include "bench.h"
+
+#include "json_writer.h"
+#include "response_compression.h"
+
+#include <string>
+
+#ifdef SCHEDD_ZLIB
+#include <zlib.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+// CPU time spent on compressing `/user-schedule` style responses versus the bytes it saves on the wire.
+// `response_compress` at `ResponseCompressionLevel` is compared with higher levels & with initializing zlib for every response instead of reusing the per-thread state.
+// At 1 MBit/s a saved byte is worth 8 us of transfer time.
+
+constexpr size_t BenchCompressionIterations = 200;
+constexpr size_t BenchCompressionSizes[] = { ResponseCompressionMinBytes, 8 * 1024, 64 * 1024 };
+constexpr const char *BenchCompressionTaskNames[] = { "Dishes", "Laundry", "Vacuum the Hallway", "Take out the Trash", "Water the Plants", "Clean the Bathroom", "Groceries" };
+
+#ifdef SCHEDD_ZLIB
+struct bench_deflate_state
+{
+  z_stream stream = {};
+  bool isInitialized = false;
+
+  ~bench_deflate_state()
+  {
+    if (isInitialized)
+      deflateEnd(&stream);
+  }
+};
+
+// Gzip like `response_compress`, but with a zlib state that's initialized & released for this response only.
+static size_t _BenchDeflateFresh(const std::string &json, std::string *pCompressed)
+{
+  bench_deflate_state state;
+
+  if (deflateInit2(&state.stream, ResponseCompressionLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return 0;
+
+  state.isInitialized = true;
+  pCompressed->resize(deflateBound(&state.stream, (uLong)json.size()));
+
+  state.stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(json.data()));
+  state.stream.avail_in = (uInt)json.size();
+  state.stream.next_out = reinterpret_cast<Bytef *>(pCompressed->data());
+  state.stream.avail_out = (uInt)pCompressed->size();
+
+  if (deflate(&state.stream, Z_FINISH) != Z_STREAM_END)
+    return 0;
+
+  return state.stream.total_out;
+}
+#endif
+
+static lsResult _BenchCompressionSchedule(const size_t minBytes, _Out_ std::string *pJson)
+{
+  lsResult result = lsR_Success;
+
+  json_writer writer;
+
+  LS_ERROR_CHECK(json_writer_create(&writer, [pJson](const char *pData, const size_t size) { pJson->append(pData, size); return lsR_Success; }));
+
+  LS_ERROR_CHECK(json_writer_begin_object(&writer));
+  LS_ERROR_CHECK(json_writer_key(&writer, "tasks"));
+  LS_ERROR_CHECK(json_writer_begin_array(&writer));
+
+  for (size_t i = 0; pJson->size() + writer.size < minBytes; i++)
+  {
+    LS_ERROR_CHECK(json_writer_begin_object(&writer));
+    LS_ERROR_CHECK(json_writer_key(&writer, "name"));
+    LS_ERROR_CHECK(json_writer_string(&writer, BenchCompressionTaskNames[i % LS_ARRAYSIZE(BenchCompressionTaskNames)]));
+    LS_ERROR_CHECK(json_writer_key(&writer, "duration"));
+    LS_ERROR_CHECK(json_writer_uint(&writer, 5 + (i * 7 % 12) * 5));
+    LS_ERROR_CHECK(json_writer_key(&writer, "id"));
+    LS_ERROR_CHECK(json_writer_uint(&writer, i * 13));
+    LS_ERROR_CHECK(json_writer_key(&writer, "isCompleted"));
+    LS_ERROR_CHECK(json_writer_bool(&writer, i % 3 == 0));
+    LS_ERROR_CHECK(json_writer_end_object(&writer));
+  }
+
+  LS_ERROR_CHECK(json_writer_end_array(&writer));
+  LS_ERROR_CHECK(json_writer_key(&writer, "long_tasks"));
+  LS_ERROR_CHECK(json_writer_begin_array(&writer));
+  LS_ERROR_CHECK(json_writer_end_array(&writer));
+  LS_ERROR_CHECK(json_writer_end_object(&writer));
+  LS_ERROR_CHECK(json_writer_flush(&writer));
+
+epilogue:
+  json_writer_destroy(&writer);
+  return result;
+}
+
+static void _BenchCompressionPrint(const char *name, const size_t size, const size_t compressedSize, const double ns)
+{
+  const size_t savedBytes = size > compressedSize ? size - compressedSize : 0;
+
+  print("compression: ", size, " bytes, ", name, ": ", compressedSize, " bytes (", savedBytes * 100 / size, "% saved), ", FD(Frac(1))(ns / 1000.0), " us, ", FD(Frac(1))(savedBytes > 0 ? ns / savedBytes : 0.0), " ns per saved byte.\n");
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void bench_response_compression()
+{
+#ifdef SCHEDD_ZLIB
+  for (const size_t minBytes : BenchCompressionSizes)
+  {
+    std::string json, compressed;
+
+    if (LS_FAILED(_BenchCompressionSchedule(minBytes, &json)) || LS_FAILED(response_compress(re_Gzip, json.data(), json.size(), &compressed)))
+    {
+      print_error_line("compression: failed to prepare ", minBytes, " bytes.");
+      continue;
+    }
+
+    const double responseNs = bench_ns_per_iteration(BenchCompressionIterations, [&](const size_t) { response_compress(re_Gzip, json.data(), json.size(), &compressed); _BenchSink = _BenchSink + compressed.size(); });
+    _BenchCompressionPrint("response_compress", json.size(), compressed.size(), responseNs);
+
+    size_t compressedSize = 0;
+
+    const double freshNs = bench_ns_per_iteration(BenchCompressionIterations, [&](const size_t) { compressedSize = _BenchDeflateFresh(json, &compressed); });
+    _BenchCompressionPrint("zlib initialized per response", json.size(), compressedSize, freshNs);
+
+    for (const int32_t level : { 6, ResponseCompressionMaxLevel }) // 6 is `Z_DEFAULT_COMPRESSION`.
+    {
+      const double levelNs = bench_ns_per_iteration(BenchCompressionIterations, [&](const size_t) { response_compress(re_Gzip, json.data(), json.size(), &compressed, level); _BenchSink = _BenchSink + compressed.size(); });
+      _BenchCompressionPrint(level == 6 ? "level 6" : "level 9", json.size(), compressed.size(), levelNs);
+    }
+  }
+#else
+  print("compression: built without SCHEDD_ZLIB, responses are sent uncompressed.\n");
+#endif
+}
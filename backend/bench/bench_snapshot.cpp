@@ -0,0 +1,163 @@
+#include "bench.h"
+
+#include "schedd.h"
+#include "snapshot.h"
+#include "writer.h"
+
+#ifdef SCHEDD_ZLIB
+#include <zlib.h>
+#endif
+
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////
+
+// Ratio & throughput of the snapshot segment codec on a full block of events, as `snapshot_write` stores it & `snapshot_load` reads it back.
+// Deflating without the delta encoded timestamps shows what the delta encoding contributes. Throughput is in bytes of the raw segment.
+
+constexpr size_t BenchSnapshotIterations = 2000;
+constexpr size_t BenchSnapshotRecordCount = sizeof(uint64_t) * CHAR_BIT; // one per slot of a `pool` block.
+constexpr size_t BenchSnapshotMaxUsersPerEvent = 3;
+constexpr uint64_t BenchSnapshotStartTime = 1760000000; // seconds, as `get_current_time`.
+constexpr const char *BenchSnapshotEventNames[] = { "Dishes", "Laundry", "Vacuum the Hallway", "Take out the Trash", "Water the Plants", "Clean the Bathroom", "Groceries", "Mow the Lawn" };
+
+// Lays out a segment like `snapshot_encode_segment`: header, records, ids, names.
+static lsResult _BenchSnapshotEventSegment(_Out_ writer_file *pFile)
+{
+  lsResult result = lsR_Success;
+
+  constexpr size_t IdsOffset = sizeof(snapshot_segment_header) + BenchSnapshotRecordCount * sizeof(snapshot_event_record);
+
+  std::string names;
+  size_t nameLengths[BenchSnapshotRecordCount];
+  size_t idCount = 0;
+
+  for (size_t i = 0; i < BenchSnapshotRecordCount; i++)
+  {
+    const size_t nameOffset = names.size();
+
+    names.append(BenchSnapshotEventNames[i % LS_ARRAYSIZE(BenchSnapshotEventNames)]);
+    names.append(" #");
+    names.append(std::to_string(i / LS_ARRAYSIZE(BenchSnapshotEventNames) + 1));
+
+    nameLengths[i] = names.size() - nameOffset;
+    idCount += 1 + i % BenchSnapshotMaxUsersPerEvent;
+  }
+
+  pFile->size = IdsOffset + idCount * sizeof(uint64_t) + names.size();
+  LS_ERROR_CHECK(lsAllocZero(&pFile->pData, pFile->size));
+
+  {
+    snapshot_segment_header *pHeader = reinterpret_cast<snapshot_segment_header *>(pFile->pData);
+    snapshot_event_record *pRecords = reinterpret_cast<snapshot_event_record *>(pFile->pData + sizeof(snapshot_segment_header));
+    uint64_t *pIds = reinterpret_cast<uint64_t *>(pFile->pData + IdsOffset);
+
+    pHeader->magic = SnapshotSegmentMagic;
+    pHeader->version = SnapshotVersion;
+    pHeader->poolType = spt_Events;
+    pHeader->encoding = sse_Raw;
+    pHeader->occupancyMask = (uint64_t)-1;
+    pHeader->idCount = idCount;
+    pHeader->stringBytes = names.size();
+
+    size_t idOffset = 0;
+    size_t nameOffset = 0;
+
+    for (size_t i = 0; i < BenchSnapshotRecordCount; i++)
+    {
+      snapshot_event_record &record = pRecords[i];
+
+      record.nameOffset = nameOffset;
+      record.nameLength = nameLengths[i];
+      record.userIdsOffset = idOffset;
+      record.userIdCount = 1 + i % BenchSnapshotMaxUsersPerEvent;
+      record.durationTimeSpan = time_span_from_minutes(5 + (i * 7 % 12) * 5);
+      record.weight = 10 + i % 5 * 5;
+      record.weightGrowthFactor = 5;
+      record.possibleExecutionDays = i % 4 == 0 ? wF_Saturday | wF_Sunday : wF_All;
+      record.repetitionTimeSpan = time_span_from_days(1 + i % 7);
+      record.creationTime = BenchSnapshotStartTime + i * 600 + i * i % 97; // created in bursts, minutes apart.
+      record.lastCompletedTime = i % 5 == 0 ? 0 : BenchSnapshotStartTime + 30 * 86400 + i * 3600;
+      record.lastModifiedTime = record.creationTime + (i % 3) * 86400;
+
+      for (size_t j = 0; j < record.userIdCount; j++)
+        pIds[idOffset++] = (i + j * 5) % 12;
+
+      nameOffset += nameLengths[i];
+    }
+
+    memcpy(pFile->pData + IdsOffset + idCount * sizeof(uint64_t), names.data(), names.size());
+  }
+
+epilogue:
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void bench_snapshot()
+{
+#ifdef SCHEDD_ZLIB
+  writer_file raw;
+  writer_file compressed;
+  uint8_t *pDecoded = nullptr;
+
+  if (LS_FAILED(_BenchSnapshotEventSegment(&raw)))
+  {
+    print_error_line("snapshot: failed to lay out the segment.");
+    return;
+  }
+
+  const double encodeNs = bench_ns_per_iteration(BenchSnapshotIterations, [&](const size_t)
+    {
+      writer_file file;
+
+      if (LS_FAILED(lsAlloc(&file.pData, raw.size)))
+        return;
+
+      memcpy(file.pData, raw.pData, raw.size); // `snapshot_compress_segment` replaces the buffer it's given.
+      file.size = raw.size;
+
+      snapshot_compress_segment(&file);
+
+      lsFreePtr(&compressed.pData);
+      compressed = file;
+    });
+
+  if (compressed.pData == nullptr || reinterpret_cast<const snapshot_segment_header *>(compressed.pData)->encoding != sse_Deflate)
+  {
+    print_error_line("snapshot: the segment was stored raw.");
+    lsFreePtr(&raw.pData);
+    lsFreePtr(&compressed.pData);
+    return;
+  }
+
+  const double decodeNs = bench_ns_per_iteration(BenchSnapshotIterations, [&](const size_t)
+    {
+      lsFreePtr(&pDecoded);
+      snapshot_decompress_segment(compressed.pData, compressed.size, raw.size, &pDecoded);
+    });
+
+  if (pDecoded == nullptr || memcmp(pDecoded + sizeof(snapshot_segment_header), raw.pData + sizeof(snapshot_segment_header), raw.size - sizeof(snapshot_segment_header)) != 0) // the headers differ in `encoding`.
+    print_error_line("snapshot: the decoded segment differs.");
+
+  // The same bytes without the delta encoding, on the same level.
+  uLongf plainSize = compressBound((uLong)raw.size);
+  uint8_t *pPlain = nullptr;
+
+  if (LS_SUCCESS(lsAlloc(&pPlain, plainSize)) && compress2(pPlain, &plainSize, raw.pData + sizeof(snapshot_segment_header), (uLong)(raw.size - sizeof(snapshot_segment_header)), Z_BEST_SPEED) == Z_OK)
+    plainSize += sizeof(snapshot_segment_header);
+  else
+    plainSize = 0;
+
+  print("snapshot: event segment, ", BenchSnapshotRecordCount, " events, ", raw.size, " bytes raw: ", compressed.size, " bytes with delta encoded times (", compressed.size * 100 / raw.size, "%), ", plainSize, " bytes without (", plainSize * 100 / raw.size, "%).\n");
+  print("snapshot: encode ", FD(Frac(1))(encodeNs / 1000.0), " us (", FD(Frac(1))(raw.size * 1000.0 / encodeNs), " MB/s), decode ", FD(Frac(1))(decodeNs / 1000.0), " us (", FD(Frac(1))(raw.size * 1000.0 / decodeNs), " MB/s).\n");
+
+  lsFreePtr(&pPlain);
+  lsFreePtr(&pDecoded);
+  lsFreePtr(&raw.pData);
+  lsFreePtr(&compressed.pData);
+#else
+  print("snapshot: built without SCHEDD_ZLIB, segments are stored raw.\n");
+#endif
+}
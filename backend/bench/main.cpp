@@ -0,0 +1,38 @@
+#include "bench.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+volatile uint64_t _BenchSink = 0;
+
+struct bench_section
+{
+  const char *name;
+  void (*func)();
+};
+
+constexpr bench_section BenchSections[] =
+{
+  { "lists", bench_lists },
+  { "json_writer", bench_json_writer },
+  { "compression", bench_response_compression },
+  { "snapshot", bench_snapshot },
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Runs every section, or only the ones named on the command line.
+int32_t main(int32_t argc, char **pArgv)
+{
+  for (const bench_section &section : BenchSections)
+  {
+    bool selected = argc <= 1;
+
+    for (int32_t i = 1; i < argc && !selected; i++)
+      selected = strcmp(pArgv[i], section.name) == 0;
+
+    if (selected)
+      section.func();
+  }
+
+  return 0;
+}
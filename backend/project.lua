@@ -1,4 +1,46 @@
 ProjectName = "schedd"
+
+-- Warnings & configurations, shared by all projects below.
+function ProjectSettings()
+
+warnings "Extra"
+flags { "FatalWarnings" }
+
+filter {"configurations:Release"}
+  targetname "%{prj.name}"
+filter {"configurations:Debug"}
+  targetname "%{prj.name}D"
+
+filter {}
+flags { "NoMinimalRebuild", "NoPCH" }
+rtti "On"
+floatingpoint "Fast"
+exceptionhandling "On"
+
+filter { "configurations:Debug*" }
+	defines { "_DEBUG" }
+	optimize "Off"
+	symbols "On"
+
+filter { "configurations:Release" }
+	defines { "NDEBUG" }
+	optimize "Speed"
+	flags { "NoBufferSecurityCheck", "NoIncrementalLink" }
+	omitframepointer "On"
+  symbols "On"
+
+filter { "system:linux", "configurations:ReleaseClang" }
+  buildoptions { "-O3" }
+
+filter { "system:windows", "configurations:Release" }
+	flags { "NoIncrementalLink" }
+
+editandcontinue "Off"
+
+filter {}
+
+end
+
 project(ProjectName)
 
   --Settings
@@ -47,6 +89,9 @@ project(ProjectName)
 
   filter { "system:windows" }
     --links { "3rdParty/asio/.lib" }
+  filter { "system:linux" }
+    defines { "SCHEDD_ZLIB" } -- compressed snapshot segments.
+    links { "z" }
   filter { "system:linux", "architecture:not ARM64" }
     links { "tinfo" }
     libdirs { "/usr/lib/x86_64-linux-gnu" }
@@ -60,36 +105,48 @@ project(ProjectName)
   
 filter {}
 
-warnings "Extra"
-flags { "FatalWarnings" }
+ProjectSettings()
 
-filter {"configurations:Release"}
-  targetname "%{prj.name}"
-filter {"configurations:Debug"}
-  targetname "%{prj.name}D"
+-- Microbenchmarks of the hot paths, linked against everything but the server's `main.cpp`.
+project(ProjectName .. "-bench")
 
-filter {}
-flags { "NoMinimalRebuild", "NoPCH" }
-rtti "On"
-floatingpoint "Fast"
-exceptionhandling "On"
+  kind "ConsoleApp"
+  language "C++"
+  staticruntime "On"
 
-filter { "configurations:Debug*" }
-	defines { "_DEBUG" }
-	optimize "Off"
-	symbols "On"
+  filter { "system:linux" }
+    cppdialect "C++20"
+    buildoptions { "-DASIO_STANDALONE" }
+  filter { "system:windows", "configurations:not *Clang" }
+    buildoptions { '/std:c++20' }
+    buildoptions { '/MP' }
+  filter { "system:windows", "configurations:*Clang" }
+    toolset("clang")
+    cppdialect "C++17"
+    defines { "__llvm__" }
+  filter { "architecture:ARM64" }
+    gccprefix "aarch64-linux-gnu-"
+  filter { }
 
-filter { "configurations:Release" }
-	defines { "NDEBUG" }
-	optimize "Speed"
-	flags { "NoBufferSecurityCheck", "NoIncrementalLink" }
-	omitframepointer "On"
-  symbols "On"
+  defines { "_CRT_SECURE_NO_WARNINGS", "SSE2" }
 
-filter { "system:linux", "configurations:ReleaseClang" }
-  buildoptions { "-O3" }
+  objdir "intermediate/obj/bench"
 
-filter { "system:windows", "configurations:Release" }
-	flags { "NoIncrementalLink" }
+  files { "bench/**.cpp", "bench/**.h", "src/**.cpp", "src/**.h" }
+  removefiles { "src/main.cpp" }
 
-editandcontinue "Off"
+  includedirs { "bench", "src**" }
+  includedirs { "3rdParty/crow/include" }
+  includedirs { "3rdParty/asio/include" }
+
+  filter { "system:linux" }
+    defines { "SCHEDD_ZLIB" }
+    links { "z" }
+  filter { }
+
+  targetdir "builds/bin"
+  debugdir "builds/bin"
+
+filter {}
+
+ProjectSettings()
@@ -0,0 +1,279 @@
+#include "admission.h"
+
+#include "schedd.h"
+
+#include <mutex>
+
+//////////////////////////////////////////////////////////////////////////
+
+constexpr int64_t AdmissionLatencyAverageShift = 3; // each completed request moves the average by 1/8 of the difference.
+
+static_assert((AdmissionBucketCount & (AdmissionBucketCount - 1)) == 0);
+static_assert(LS_ARRAYSIZE(AdmissionClassCost) == ac_Expensive + 1);
+
+struct admission_bucket
+{
+  uint64_t key;
+  double tokens;
+  int64_t lastRefillNs;
+  bool isUsed;
+};
+
+struct admission_bucket_table
+{
+  admission_bucket buckets[AdmissionBucketCount];
+  double tokensPerSecond;
+  double burstTokens;
+};
+
+static std::mutex _AdmissionLock; // Guards everything below.
+static admission_bucket_table _AdmissionIpBuckets = { {}, AdmissionIpTokensPerSecond, AdmissionIpBurstTokens };
+static admission_bucket_table _AdmissionSessionBuckets = { {}, AdmissionSessionTokensPerSecond, AdmissionSessionBurstTokens };
+static size_t _AdmissionInFlight = 0;
+static int64_t _AdmissionLatencyAverageNs = 0;
+static int64_t _AdmissionLastCompletionNs = 0;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Assumes `_AdmissionLock`.
+static void _AdmissionRefill(const admission_bucket_table &table, admission_bucket *pBucket, const int64_t now)
+{
+  const int64_t elapsedNs = lsMax<int64_t>(0, now - pBucket->lastRefillNs);
+
+  pBucket->tokens = lsMin(table.burstTokens, pBucket->tokens + elapsedNs * table.tokensPerSecond / 1e9);
+  pBucket->lastRefillNs = now;
+}
+
+// Assumes `_AdmissionLock`. Buckets that refilled completely are indistinguishable from new ones, so they're taken over by other keys.
+static admission_bucket *_AdmissionGetBucket(admission_bucket_table *pTable, const uint64_t key, const int64_t now)
+{
+  const size_t start = (size_t)etag_hash(&key, sizeof(key)) & (AdmissionBucketCount - 1);
+  admission_bucket *pReusable = nullptr;
+
+  for (size_t i = 0; i < AdmissionBucketProbeCount; i++)
+  {
+    admission_bucket *pBucket = &pTable->buckets[(start + i) & (AdmissionBucketCount - 1)];
+
+    if (pBucket->isUsed && pBucket->key == key)
+    {
+      _AdmissionRefill(*pTable, pBucket, now);
+      return pBucket;
+    }
+
+    if (pReusable == nullptr)
+    {
+      if (!pBucket->isUsed)
+      {
+        pReusable = pBucket;
+      }
+      else
+      {
+        _AdmissionRefill(*pTable, pBucket, now);
+
+        if (pBucket->tokens >= pTable->burstTokens)
+          pReusable = pBucket;
+      }
+    }
+  }
+
+  if (pReusable == nullptr)
+  {
+    admission_bucket *pShared = &pTable->buckets[start];
+    _AdmissionRefill(*pTable, pShared, now);
+
+    return pShared;
+  }
+
+  pReusable->key = key;
+  pReusable->tokens = pTable->burstTokens;
+  pReusable->lastRefillNs = now;
+  pReusable->isUsed = true;
+
+  return pReusable;
+}
+
+static size_t _AdmissionRetryAfterSeconds(const admission_bucket_table &table, const admission_bucket &bucket, const double cost)
+{
+  const double missingTokens = lsMax(0.0, cost - bucket.tokens);
+
+  return lsMax<size_t>(1, (size_t)(missingTokens / table.tokensPerSecond + 0.999));
+}
+
+static bool _AdmissionIsTrustedProxy(const char *address, const size_t length)
+{
+  for (const char *proxy : AdmissionTrustedProxies)
+    if (strlen(proxy) == length && memcmp(proxy, address, length) == 0)
+      return true;
+
+  return false;
+}
+
+// Strips whitespace, quotes, brackets & ports: `"[2001:db8::1]:4711"` or `192.0.2.1:80` as the `Forwarded` header allows them.
+static void _AdmissionTrimAddress(const char **pAddress, size_t *pLength)
+{
+  const char *address = *pAddress;
+  size_t length = *pLength;
+
+  while (length > 0 && (*address == ' ' || *address == '\t' || *address == '"'))
+  {
+    address++;
+    length--;
+  }
+
+  while (length > 0 && (address[length - 1] == ' ' || address[length - 1] == '\t' || address[length - 1] == '"'))
+    length--;
+
+  if (length > 0 && *address == '[')
+  {
+    const char *end = reinterpret_cast<const char *>(memchr(address, ']', length));
+
+    address++;
+    length = end != nullptr ? (size_t)(end - address) : length - 1;
+  }
+  else
+  {
+    const char *colon = reinterpret_cast<const char *>(memchr(address, ':', length));
+
+    if (colon != nullptr && memchr(colon + 1, ':', length - (size_t)(colon + 1 - address)) == nullptr) // a single colon separates the port of an IPv4 address.
+      length = (size_t)(colon - address);
+  }
+
+  *pAddress = address;
+  *pLength = length;
+}
+
+// Finds the `for=` parameter of a `Forwarded` element, the element ends at `end`.
+static bool _AdmissionFindForwardedFor(const char *element, const char *end, _Out_ const char **pValue, _Out_ size_t *pLength)
+{
+  const char *pair = element;
+
+  while (pair < end)
+  {
+    const char *pairEnd = reinterpret_cast<const char *>(memchr(pair, ';', (size_t)(end - pair)));
+
+    if (pairEnd == nullptr)
+      pairEnd = end;
+
+    while (pair < pairEnd && (*pair == ' ' || *pair == '\t'))
+      pair++;
+
+    if (pairEnd - pair > 4 && (pair[0] == 'f' || pair[0] == 'F') && (pair[1] == 'o' || pair[1] == 'O') && (pair[2] == 'r' || pair[2] == 'R') && pair[3] == '=')
+    {
+      *pValue = pair + 4;
+      *pLength = (size_t)(pairEnd - pair - 4);
+      return true;
+    }
+
+    pair = pairEnd + 1;
+  }
+
+  return false;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void admission_resolve_client_address(const char *peerAddress, const char *forwardedFor, const char *forwarded, _Out_ char (&address)[AdmissionMaxAddressLength + 1])
+{
+  const bool useForwardedFor = forwardedFor != nullptr && *forwardedFor != '\0';
+  const char *list = useForwardedFor ? forwardedFor : forwarded;
+  const char *client = peerAddress != nullptr ? peerAddress : "";
+  size_t clientLength = strlen(client);
+
+  // Every proxy appends the address it received the request from, so the rightmost entry not added by a trusted proxy is the client.
+  if (_AdmissionIsTrustedProxy(client, clientLength) && list != nullptr)
+  {
+    const char *element = list;
+
+    while (*element != '\0')
+    {
+      const char *end = strchr(element, ',');
+
+      if (end == nullptr)
+        end = element + strlen(element);
+
+      const char *value = element;
+      size_t length = (size_t)(end - element);
+
+      if (useForwardedFor || _AdmissionFindForwardedFor(element, end, &value, &length))
+      {
+        _AdmissionTrimAddress(&value, &length);
+
+        if (length > 0 && !_AdmissionIsTrustedProxy(value, length))
+        {
+          client = value;
+          clientLength = length;
+        }
+      }
+
+      element = *end == ',' ? end + 1 : end;
+    }
+  }
+
+  clientLength = lsMin(clientLength, AdmissionMaxAddressLength);
+  memcpy(address, client, clientLength);
+  address[clientLength] = '\0';
+}
+
+admission_verdict admission_begin(const char *clientAddress, const bool hasSession, const uint32_t sessionId, const admission_class requestClass, _Out_ int64_t *pStartTimeNs, _Out_ size_t *pRetryAfterSeconds)
+{
+  const int64_t now = lsGetCurrentTimeNs();
+  const double cost = AdmissionClassCost[requestClass];
+  const uint64_t ipKey = clientAddress != nullptr ? etag_hash(clientAddress, strlen(clientAddress)) : 0;
+
+  *pStartTimeNs = now;
+  *pRetryAfterSeconds = 0;
+
+  std::scoped_lock lock(_AdmissionLock);
+
+  if (requestClass == ac_Expensive)
+  {
+    const bool isLatencyCurrent = now - _AdmissionLastCompletionNs < AdmissionLatencyWindowNs;
+
+    if (_AdmissionInFlight >= AdmissionOverloadInFlight || (isLatencyCurrent && _AdmissionLatencyAverageNs >= AdmissionOverloadLatencyNs))
+    {
+      *pRetryAfterSeconds = 1;
+      return av_Overloaded;
+    }
+  }
+
+  // Both buckets have to cover the cost before either of them is charged.
+  admission_bucket *pIpBucket = _AdmissionGetBucket(&_AdmissionIpBuckets, ipKey, now);
+  admission_bucket *pSessionBucket = hasSession ? _AdmissionGetBucket(&_AdmissionSessionBuckets, sessionId, now) : nullptr;
+
+  if (pIpBucket->tokens < cost)
+    *pRetryAfterSeconds = _AdmissionRetryAfterSeconds(_AdmissionIpBuckets, *pIpBucket, cost);
+
+  if (pSessionBucket != nullptr && pSessionBucket->tokens < cost)
+    *pRetryAfterSeconds = lsMax(*pRetryAfterSeconds, _AdmissionRetryAfterSeconds(_AdmissionSessionBuckets, *pSessionBucket, cost));
+
+  if (*pRetryAfterSeconds > 0)
+    return av_RateLimited;
+
+  pIpBucket->tokens -= cost;
+
+  if (pSessionBucket != nullptr)
+    pSessionBucket->tokens -= cost;
+
+  _AdmissionInFlight++;
+
+  return av_Admitted;
+}
+
+void admission_end(const int64_t startTimeNs)
+{
+  const int64_t now = lsGetCurrentTimeNs();
+  const int64_t latencyNs = lsMax<int64_t>(0, now - startTimeNs);
+
+  std::scoped_lock lock(_AdmissionLock);
+
+  lsAssert(_AdmissionInFlight > 0);
+  _AdmissionInFlight--;
+
+  // Restarts from the sample once the average went stale, instead of dragging old load along.
+  if (now - _AdmissionLastCompletionNs >= AdmissionLatencyWindowNs)
+    _AdmissionLatencyAverageNs = latencyNs;
+  else
+    _AdmissionLatencyAverageNs += (latencyNs - _AdmissionLatencyAverageNs) >> AdmissionLatencyAverageShift;
+
+  _AdmissionLastCompletionNs = now;
+}
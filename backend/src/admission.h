@@ -0,0 +1,49 @@
+#pragma once
+
+#include "core.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+// Admission control in front of the handlers, so one client looping on a request can't monopolize `_ThreadLock`.
+// Every request pays tokens from the bucket of its IP address & of its session (if it has one), both refill at a fixed rate up to a burst.
+// Independently of that, the server is overloaded while too many requests are in flight or the recent handling latency is high:
+// expensive requests are shed then, while regular ones like `/user-schedule` still get through.
+
+constexpr size_t AdmissionBucketCount = 4096; // per table (IPs, sessions), power of 2. Colliding clients that are both active share a bucket.
+constexpr size_t AdmissionBucketProbeCount = 8;
+
+constexpr double AdmissionIpTokensPerSecond = 20;
+constexpr double AdmissionIpBurstTokens = 60; // a page load & a few clicks, for every user behind the address.
+constexpr double AdmissionSessionTokensPerSecond = 5;
+constexpr double AdmissionSessionBurstTokens = 20;
+
+// Requests from these peers are forwarded by a reverse proxy, the client address is taken from `X-Forwarded-For` or `Forwarded` instead.
+// Otherwise all clients behind the proxy would share one address bucket.
+constexpr const char *AdmissionTrustedProxies[] = { "127.0.0.1", "::1", "::ffff:127.0.0.1" };
+constexpr size_t AdmissionMaxAddressLength = 63;
+
+constexpr size_t AdmissionOverloadInFlight = 4; // requests being handled at once, beyond that they mostly wait for the lock.
+constexpr int64_t AdmissionOverloadLatencyNs = 25 * 1000 * 1000; // moving average of the handling time.
+constexpr int64_t AdmissionLatencyWindowNs = 1000 * 1000 * 1000; // the average is disregarded once no request completed for this long.
+
+enum admission_class
+{
+  ac_Regular,
+  ac_Expensive, // searches & registration: shed while overloaded. `/batch` admits each of its sub-requests by their own class.
+};
+
+enum admission_verdict
+{
+  av_Admitted,
+  av_RateLimited,
+  av_Overloaded,
+};
+
+constexpr double AdmissionClassCost[] = { 1, 4 }; // tokens, index: `admission_class`.
+
+// The rightmost forwarded address that isn't a trusted proxy, or `peerAddress` if the peer isn't a trusted proxy itself. Headers may be `nullptr`.
+void admission_resolve_client_address(const char *peerAddress, const char *forwardedFor, const char *forwarded, _Out_ char (&address)[AdmissionMaxAddressLength + 1]);
+
+// Every admitted request has to be ended with `admission_end`, passing the start time.
+admission_verdict admission_begin(const char *clientAddress, const bool hasSession, const uint32_t sessionId, const admission_class requestClass, _Out_ int64_t *pStartTimeNs, _Out_ size_t *pRetryAfterSeconds);
+void admission_end(const int64_t startTimeNs);
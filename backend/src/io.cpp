@@ -1,5 +1,17 @@
 #include "io.h"
 
+#ifdef LS_PLATFORM_WINDOWS
+#include <corecrt_io.h> // `<io.h>` would resolve to this project's header.
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <errno.h>
+#endif
+
+#include <filesystem>
+
 //////////////////////////////////////////////////////////////////////////
 
 constexpr bool LogIO = true;
@@ -101,3 +113,532 @@ epilogue:
 
   return result;
 }
+
+lsResult lsWriteFileBytesAtomic(const char *filename, const uint8_t *pData, const size_t size)
+{
+  lsResult result = lsR_Success;
+
+  atomic_file file;
+
+  LS_ERROR_IF(filename == nullptr || (pData == nullptr && size > 0), lsR_ArgumentNull);
+
+  LS_ERROR_CHECK(lsOpenAtomicFile(filename, &file));
+  LS_ERROR_CHECK(lsWriteAtomicFile(&file, pData, size));
+  LS_ERROR_CHECK(lsCommitAtomicFile(&file));
+
+epilogue:
+  lsDiscardAtomicFile(&file);
+  return result;
+}
+
+lsResult lsOpenAtomicFile(const char *filename, _Out_ atomic_file *pFile)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(filename == nullptr || pFile == nullptr, lsR_ArgumentNull);
+
+  pFile->pFile = nullptr;
+
+  LS_ERROR_IF(!lsCopyString(pFile->filename, LS_ARRAYSIZE(pFile->filename), filename, lsStringLength(filename) + 1), lsR_ArgumentOutOfBounds);
+  LS_ERROR_IF(!sformat_to(pFile->tempFilename, LS_ARRAYSIZE(pFile->tempFilename), filename, ".tmp"), lsR_ArgumentOutOfBounds);
+
+  pFile->pFile = fopen(pFile->tempFilename, "wb");
+
+  if constexpr (LogIO)
+    if (pFile->pFile == nullptr)
+      print_error_line(IOLogPrefix "Failed to open file: '", pFile->tempFilename, "' with write access.");
+
+  LS_ERROR_IF(pFile->pFile == nullptr, lsR_IOFailure);
+
+epilogue:
+  return result;
+}
+
+lsResult lsWriteAtomicFile(atomic_file *pFile, const void *pData, const size_t size)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pFile == nullptr || (pData == nullptr && size > 0), lsR_ArgumentNull);
+  LS_ERROR_IF(pFile->pFile == nullptr, lsR_ResourceStateInvalid);
+
+  LS_ERROR_IF(size > 0 && size != fwrite(pData, 1, size, pFile->pFile), lsR_IOFailure);
+
+epilogue:
+  return result;
+}
+
+lsResult lsCommitAtomicFile(atomic_file *pFile)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pFile == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(pFile->pFile == nullptr, lsR_ResourceStateInvalid);
+
+  LS_ERROR_CHECK(lsSyncFile(pFile->pFile));
+
+  fclose(pFile->pFile);
+  pFile->pFile = nullptr;
+
+#ifdef LS_PLATFORM_WINDOWS
+  LS_ERROR_IF(!MoveFileExA(pFile->tempFilename, pFile->filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH), lsR_IOFailure);
+#else
+  LS_ERROR_IF(0 != rename(pFile->tempFilename, pFile->filename), lsR_IOFailure);
+
+  // Sync the directory, so the rename itself survives a crash.
+  {
+    std::filesystem::path directory = std::filesystem::path(pFile->filename).parent_path();
+
+    if (directory.empty())
+      directory = ".";
+
+    const int fd = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    LS_ERROR_IF(fd < 0, lsR_IOFailure);
+
+    const int syncResult = fsync(fd);
+    close(fd);
+
+    LS_ERROR_IF(syncResult != 0, lsR_IOFailure);
+  }
+#endif
+
+epilogue:
+  if (LS_FAILED(result))
+    lsDiscardAtomicFile(pFile);
+
+  return result;
+}
+
+void lsDiscardAtomicFile(atomic_file *pFile)
+{
+  if (pFile == nullptr || pFile->pFile == nullptr)
+    return;
+
+  fclose(pFile->pFile);
+  pFile->pFile = nullptr;
+
+  remove(pFile->tempFilename);
+}
+
+lsResult lsSyncFile(FILE *pFile)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pFile == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(0 != fflush(pFile), lsR_IOFailure);
+
+#ifdef LS_PLATFORM_WINDOWS
+  LS_ERROR_IF(0 != _commit(_fileno(pFile)), lsR_IOFailure);
+#else
+  LS_ERROR_IF(0 != fsync(fileno(pFile)), lsR_IOFailure);
+#endif
+
+epilogue:
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult lsMapFile(const char *filename, _Out_ mapped_file *pFile)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(filename == nullptr || pFile == nullptr, lsR_ArgumentNull);
+
+  *pFile = mapped_file();
+
+#ifdef LS_PLATFORM_WINDOWS
+  {
+    LARGE_INTEGER fileSize;
+
+    pFile->fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LS_ERROR_IF(pFile->fileHandle == INVALID_HANDLE_VALUE, lsR_ResourceNotFound);
+
+    LS_ERROR_IF(!GetFileSizeEx(pFile->fileHandle, &fileSize), lsR_IOFailure);
+    pFile->size = (size_t)fileSize.QuadPart;
+
+    if (pFile->size == 0)
+      goto epilogue;
+
+    pFile->mappingHandle = CreateFileMappingA(pFile->fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    LS_ERROR_IF(pFile->mappingHandle == nullptr, lsR_IOFailure);
+
+    pFile->pData = reinterpret_cast<const uint8_t *>(MapViewOfFile(pFile->mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    LS_ERROR_IF(pFile->pData == nullptr, lsR_IOFailure);
+  }
+#else
+  {
+    struct stat fileStat;
+    void *pMapping = nullptr;
+
+    const int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    LS_ERROR_IF(fd < 0, lsR_ResourceNotFound);
+
+    if (fstat(fd, &fileStat) != 0)
+    {
+      close(fd);
+      LS_ERROR_SET(lsR_IOFailure);
+    }
+
+    pFile->size = (size_t)fileStat.st_size;
+
+    if (pFile->size > 0)
+      pMapping = mmap(nullptr, pFile->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd); // the mapping stays valid.
+
+    if (pFile->size == 0)
+      goto epilogue;
+
+    LS_ERROR_IF(pMapping == MAP_FAILED, lsR_IOFailure);
+    pFile->pData = reinterpret_cast<const uint8_t *>(pMapping);
+  }
+#endif
+
+epilogue:
+  if (LS_FAILED(result) && pFile != nullptr)
+    lsUnmapFile(pFile);
+
+  return result;
+}
+
+void lsUnmapFile(mapped_file *pFile)
+{
+  if (pFile == nullptr)
+    return;
+
+#ifdef LS_PLATFORM_WINDOWS
+  if (pFile->pData != nullptr)
+    UnmapViewOfFile(pFile->pData);
+
+  if (pFile->mappingHandle != nullptr)
+    CloseHandle(pFile->mappingHandle);
+
+  if (pFile->fileHandle != INVALID_HANDLE_VALUE)
+    CloseHandle(pFile->fileHandle);
+#else
+  if (pFile->pData != nullptr)
+    munmap(const_cast<uint8_t *>(pFile->pData), pFile->size);
+#endif
+
+  *pFile = mapped_file();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+#ifdef LS_PLATFORM_WINDOWS
+constexpr size_t MaxBytesPerFileCall = 1 << 30; // `ReadFile` & `WriteFile` take a `DWORD`.
+
+inline OVERLAPPED lsGetFileOffset(const size_t offset)
+{
+  OVERLAPPED overlapped;
+  lsZeroMemory(&overlapped);
+
+  overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+  overlapped.OffsetHigh = (DWORD)((uint64_t)offset >> 32);
+
+  return overlapped;
+}
+#else
+constexpr size_t MaxVectorsPerWrite = 64; // well below `IOV_MAX`.
+#endif
+
+lsResult lsOpenFile(const char *filename, const file_open_mode mode, _Out_ io_file *pFile)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(filename == nullptr || pFile == nullptr, lsR_ArgumentNull);
+
+  *pFile = io_file();
+
+#ifdef LS_PLATFORM_WINDOWS
+  if (mode == fom_Read)
+    pFile->handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  else
+    pFile->handle = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  LS_ERROR_IF(pFile->handle == INVALID_HANDLE_VALUE, mode == fom_Read ? lsR_ResourceNotFound : lsR_IOFailure);
+#else
+  if (mode == fom_Read)
+    pFile->fd = open(filename, O_RDONLY | O_CLOEXEC);
+  else
+    pFile->fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+  LS_ERROR_IF(pFile->fd < 0, mode == fom_Read ? lsR_ResourceNotFound : lsR_IOFailure);
+#endif
+
+epilogue:
+  return result;
+}
+
+void lsCloseFile(io_file *pFile)
+{
+  if (pFile == nullptr || !lsIsFileOpen(*pFile))
+    return;
+
+#ifdef LS_PLATFORM_WINDOWS
+  CloseHandle(pFile->handle);
+#else
+  close(pFile->fd);
+#endif
+
+  *pFile = io_file();
+}
+
+bool lsIsFileOpen(const io_file &file)
+{
+#ifdef LS_PLATFORM_WINDOWS
+  return file.handle != INVALID_HANDLE_VALUE;
+#else
+  return file.fd >= 0;
+#endif
+}
+
+lsResult lsGetFileSize(const io_file &file, _Out_ size_t *pSize)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pSize == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(!lsIsFileOpen(file), lsR_ResourceStateInvalid);
+
+#ifdef LS_PLATFORM_WINDOWS
+  {
+    LARGE_INTEGER fileSize;
+    LS_ERROR_IF(!GetFileSizeEx(file.handle, &fileSize), lsR_IOFailure);
+
+    *pSize = (size_t)fileSize.QuadPart;
+  }
+#else
+  {
+    struct stat fileStat;
+    LS_ERROR_IF(fstat(file.fd, &fileStat) != 0, lsR_IOFailure);
+
+    *pSize = (size_t)fileStat.st_size;
+  }
+#endif
+
+epilogue:
+  return result;
+}
+
+lsResult lsReadFileAt(const io_file &file, const size_t offset, _Out_ void *pData, const size_t size)
+{
+  lsResult result = lsR_Success;
+
+  uint8_t *pBytes = reinterpret_cast<uint8_t *>(pData);
+  size_t bytesRead = 0;
+
+  LS_ERROR_IF(pData == nullptr && size > 0, lsR_ArgumentNull);
+  LS_ERROR_IF(!lsIsFileOpen(file), lsR_ResourceStateInvalid);
+
+  // Both APIs may return fewer bytes than requested.
+  while (bytesRead < size)
+  {
+#ifdef LS_PLATFORM_WINDOWS
+    OVERLAPPED overlapped = lsGetFileOffset(offset + bytesRead);
+    DWORD chunkBytesRead = 0;
+
+    if (!ReadFile(file.handle, pBytes + bytesRead, (DWORD)lsMin(size - bytesRead, MaxBytesPerFileCall), &chunkBytesRead, &overlapped))
+      LS_ERROR_IF(GetLastError() != ERROR_HANDLE_EOF, lsR_IOFailure);
+
+    LS_ERROR_IF(chunkBytesRead == 0, lsR_EndOfStream);
+    bytesRead += chunkBytesRead;
+#else
+    const ssize_t chunkBytesRead = pread(file.fd, pBytes + bytesRead, size - bytesRead, (off_t)(offset + bytesRead));
+
+    if (chunkBytesRead < 0 && errno == EINTR)
+      continue;
+
+    LS_ERROR_IF(chunkBytesRead < 0, lsR_IOFailure);
+    LS_ERROR_IF(chunkBytesRead == 0, lsR_EndOfStream);
+    bytesRead += (size_t)chunkBytesRead;
+#endif
+  }
+
+epilogue:
+  return result;
+}
+
+lsResult lsWriteFileAt(const io_file &file, const size_t offset, const void *pData, const size_t size)
+{
+  lsResult result = lsR_Success;
+
+  const uint8_t *pBytes = reinterpret_cast<const uint8_t *>(pData);
+  size_t bytesWritten = 0;
+
+  LS_ERROR_IF(pData == nullptr && size > 0, lsR_ArgumentNull);
+  LS_ERROR_IF(!lsIsFileOpen(file), lsR_ResourceStateInvalid);
+
+  while (bytesWritten < size)
+  {
+#ifdef LS_PLATFORM_WINDOWS
+    OVERLAPPED overlapped = lsGetFileOffset(offset + bytesWritten);
+    DWORD chunkBytesWritten = 0;
+
+    LS_ERROR_IF(!WriteFile(file.handle, pBytes + bytesWritten, (DWORD)lsMin(size - bytesWritten, MaxBytesPerFileCall), &chunkBytesWritten, &overlapped), lsR_IOFailure);
+    LS_ERROR_IF(chunkBytesWritten == 0, lsR_IOFailure);
+    bytesWritten += chunkBytesWritten;
+#else
+    const ssize_t chunkBytesWritten = pwrite(file.fd, pBytes + bytesWritten, size - bytesWritten, (off_t)(offset + bytesWritten));
+
+    if (chunkBytesWritten < 0 && errno == EINTR)
+      continue;
+
+    LS_ERROR_IF(chunkBytesWritten <= 0, lsR_IOFailure);
+    bytesWritten += (size_t)chunkBytesWritten;
+#endif
+  }
+
+epilogue:
+  return result;
+}
+
+lsResult lsWriteFileGatheredAt(const io_file &file, const size_t offset, const io_buffer *pBuffers, const size_t count)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pBuffers == nullptr && count > 0, lsR_ArgumentNull);
+  LS_ERROR_IF(!lsIsFileOpen(file), lsR_ResourceStateInvalid);
+
+#ifdef LS_PLATFORM_WINDOWS
+  {
+    size_t position = offset;
+
+    for (size_t i = 0; i < count; i++)
+    {
+      LS_ERROR_CHECK(lsWriteFileAt(file, position, pBuffers[i].pData, pBuffers[i].size));
+      position += pBuffers[i].size;
+    }
+  }
+#else
+  {
+    struct iovec vectors[MaxVectorsPerWrite];
+    size_t position = offset;
+    size_t bufferIndex = 0;
+    size_t bufferOffset = 0; // bytes of `pBuffers[bufferIndex]` that have already been written.
+
+    while (bufferIndex < count)
+    {
+      size_t vectorCount = 0;
+      size_t vectorBytes = 0;
+
+      for (size_t i = bufferIndex; i < count && vectorCount < MaxVectorsPerWrite; i++)
+      {
+        const size_t skip = (i == bufferIndex) ? bufferOffset : 0;
+
+        vectors[vectorCount].iov_base = const_cast<uint8_t *>(reinterpret_cast<const uint8_t *>(pBuffers[i].pData)) + skip;
+        vectors[vectorCount].iov_len = pBuffers[i].size - skip;
+        vectorBytes += vectors[vectorCount].iov_len;
+        vectorCount++;
+      }
+
+      const ssize_t written = vectorBytes == 0 ? 0 : pwritev(file.fd, vectors, (int)vectorCount, (off_t)position);
+
+      if (written < 0 && errno == EINTR)
+        continue;
+
+      LS_ERROR_IF(written < 0 || (written == 0 && vectorBytes > 0), lsR_IOFailure);
+
+      position += (size_t)written;
+
+      // Skip the buffers that have been written completely, partial writes continue in the middle of a buffer.
+      size_t remaining = (size_t)written;
+
+      while (bufferIndex < count && remaining >= pBuffers[bufferIndex].size - bufferOffset)
+      {
+        remaining -= pBuffers[bufferIndex].size - bufferOffset;
+        bufferIndex++;
+        bufferOffset = 0;
+      }
+
+      bufferOffset += remaining;
+    }
+  }
+#endif
+
+epilogue:
+  return result;
+}
+
+lsResult lsPreallocateFile(const io_file &file, const size_t offset, const size_t size)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(!lsIsFileOpen(file), lsR_ResourceStateInvalid);
+
+  if (size == 0)
+    goto epilogue;
+
+#ifdef LS_PLATFORM_WINDOWS
+  {
+    size_t fileSize;
+    LS_ERROR_CHECK(lsGetFileSize(file, &fileSize));
+
+    if (offset + size > fileSize)
+    {
+      FILE_ALLOCATION_INFO allocationInfo;
+      allocationInfo.AllocationSize.QuadPart = (LONGLONG)(offset + size);
+      LS_ERROR_IF(!SetFileInformationByHandle(file.handle, FileAllocationInfo, &allocationInfo, sizeof(allocationInfo)), lsR_IOFailure);
+
+      FILE_END_OF_FILE_INFO endOfFileInfo;
+      endOfFileInfo.EndOfFile.QuadPart = (LONGLONG)(offset + size);
+      LS_ERROR_IF(!SetFileInformationByHandle(file.handle, FileEndOfFileInfo, &endOfFileInfo, sizeof(endOfFileInfo)), lsR_IOFailure);
+    }
+  }
+#else
+  {
+    int error;
+
+    do
+    {
+      error = posix_fallocate(file.fd, (off_t)offset, (off_t)size); // returns the error instead of setting `errno`.
+    } while (error == EINTR);
+
+    LS_ERROR_IF(error == ENOSPC, lsR_ResourceInsufficient);
+    LS_ERROR_IF(error != 0, lsR_IOFailure);
+  }
+#endif
+
+epilogue:
+  return result;
+}
+
+lsResult lsTruncateFile(const io_file &file, const size_t size)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(!lsIsFileOpen(file), lsR_ResourceStateInvalid);
+
+#ifdef LS_PLATFORM_WINDOWS
+  {
+    FILE_END_OF_FILE_INFO endOfFileInfo;
+    endOfFileInfo.EndOfFile.QuadPart = (LONGLONG)size;
+
+    LS_ERROR_IF(!SetFileInformationByHandle(file.handle, FileEndOfFileInfo, &endOfFileInfo, sizeof(endOfFileInfo)), lsR_IOFailure);
+  }
+#else
+  LS_ERROR_IF(0 != ftruncate(file.fd, (off_t)size), lsR_IOFailure);
+#endif
+
+epilogue:
+  return result;
+}
+
+lsResult lsSyncFile(const io_file &file, const file_sync_mode mode)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(!lsIsFileOpen(file), lsR_ResourceStateInvalid);
+
+#ifdef LS_PLATFORM_WINDOWS
+  (void)mode; // Windows doesn't distinguish.
+  LS_ERROR_IF(!FlushFileBuffers(file.handle), lsR_IOFailure);
+#else
+  if (mode == fsm_Data)
+    LS_ERROR_IF(0 != fdatasync(file.fd), lsR_IOFailure);
+  else
+    LS_ERROR_IF(0 != fsync(file.fd), lsR_IOFailure);
+#endif
+
+epilogue:
+  return result;
+}
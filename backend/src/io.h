@@ -19,8 +19,91 @@ lsResult lsReadFileSized(const char *filename, _Out_ T *pData, const size_t coun
 
 lsResult lsWriteFileBytes(const char *filename, const uint8_t *pData, const size_t size);
 
+// Writes to `<filename>.tmp`, syncs it & renames it over `filename`, so a crash leaves either the old or the new contents behind.
+lsResult lsWriteFileBytesAtomic(const char *filename, const uint8_t *pData, const size_t size);
+
+template <typename T>
+lsResult lsWriteFileAtomic(const char *filename, const T *pData, const size_t count)
+{
+  return lsWriteFileBytesAtomic(filename, reinterpret_cast<const uint8_t *>(pData), count * sizeof(T));
+}
+
+lsResult lsSyncFile(FILE *pFile); // Flushes the stream & waits until the data reached the disk.
+
+// Streamed variant of `lsWriteFileBytesAtomic`: write the contents in chunks, then commit or discard them.
+struct atomic_file
+{
+  FILE *pFile = nullptr;
+  char filename[1024];
+  char tempFilename[1024];
+};
+
+lsResult lsOpenAtomicFile(const char *filename, _Out_ atomic_file *pFile);
+lsResult lsWriteAtomicFile(atomic_file *pFile, const void *pData, const size_t size);
+lsResult lsCommitAtomicFile(atomic_file *pFile); // Syncs the temporary file & renames it over `filename`. Discards it on failure.
+void lsDiscardAtomicFile(atomic_file *pFile); // Removes the temporary file if it hasn't been committed.
+
 template <typename T>
 lsResult lsWriteFile(const char *filename, const T *pData, const size_t count)
 {
   return lsWriteFileBytes(filename, reinterpret_cast<const uint8_t *>(pData), count * sizeof(T));
 }
+
+//////////////////////////////////////////////////////////////////////////
+
+struct mapped_file
+{
+  const uint8_t *pData = nullptr;
+  size_t size = 0;
+
+#ifdef LS_PLATFORM_WINDOWS
+  HANDLE fileHandle = INVALID_HANDLE_VALUE;
+  HANDLE mappingHandle = nullptr;
+#endif
+};
+
+// Maps the whole file read-only. Empty files are valid and result in `pData == nullptr`.
+lsResult lsMapFile(const char *filename, _Out_ mapped_file *pFile);
+void lsUnmapFile(mapped_file *pFile);
+
+//////////////////////////////////////////////////////////////////////////
+
+// Unbuffered file access at explicit offsets, for callers that track their own file positions. Nothing is copied through a stdio buffer.
+struct io_file
+{
+#ifdef LS_PLATFORM_WINDOWS
+  HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+  int fd = -1;
+#endif
+};
+
+enum file_open_mode
+{
+  fom_Read, // the file has to exist.
+  fom_ReadWrite, // creates the file if it doesn't exist, existing contents are kept.
+};
+
+enum file_sync_mode
+{
+  fsm_Data, // contents & size (`fdatasync`), enough to read the data back after a crash.
+  fsm_All, // incl. all other metadata like timestamps (`fsync`).
+};
+
+struct io_buffer
+{
+  const void *pData;
+  size_t size;
+};
+
+lsResult lsOpenFile(const char *filename, const file_open_mode mode, _Out_ io_file *pFile);
+void lsCloseFile(io_file *pFile);
+bool lsIsFileOpen(const io_file &file);
+
+lsResult lsGetFileSize(const io_file &file, _Out_ size_t *pSize);
+lsResult lsReadFileAt(const io_file &file, const size_t offset, _Out_ void *pData, const size_t size); // Fails with `lsR_EndOfStream` if the file ends early.
+lsResult lsWriteFileAt(const io_file &file, const size_t offset, const void *pData, const size_t size);
+lsResult lsWriteFileGatheredAt(const io_file &file, const size_t offset, const io_buffer *pBuffers, const size_t count); // Writes the buffers back to back, with as few calls as possible (`pwritev`).
+lsResult lsPreallocateFile(const io_file &file, const size_t offset, const size_t size); // Reserves the disk space for the range & extends the file if necessary, so writes into it can't run out of space.
+lsResult lsTruncateFile(const io_file &file, const size_t size);
+lsResult lsSyncFile(const io_file &file, const file_sync_mode mode);
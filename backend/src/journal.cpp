@@ -0,0 +1,634 @@
+#include "journal.h"
+
+#include "schedd.h"
+#include "snapshot.h"
+#include "writer.h"
+#include "io.h"
+
+#include <condition_variable>
+#include <filesystem>
+#include <thread>
+
+//////////////////////////////////////////////////////////////////////////
+
+constexpr size_t JournalMinPendingCapacity = 64 * 1024;
+constexpr auto JournalFlushInterval = std::chrono::seconds(1);
+
+static std::mutex _JournalLock; // pending records, sequences & stream offsets.
+static std::mutex _JournalFileLock; // the file & the flush buffer, held while writing outside of `_JournalLock`.
+static std::condition_variable _JournalCondition;
+static std::thread *_pJournalThread = nullptr;
+static bool _JournalIsRunning = false;
+static journal_fsync_policy _JournalPolicy = jfp_Always;
+static lsResult _JournalError = lsR_Success; // of the last flush, cleared once a flush succeeds again.
+static uint64_t _JournalFailedSequence = 0; // last sequence the failed flush should have made durable.
+
+static uint8_t *_pJournalPending = nullptr;
+static size_t _JournalPendingSize = 0;
+static size_t _JournalPendingCapacity = 0;
+
+static uint64_t _JournalSequence = 0; // of the last appended record.
+static uint64_t _JournalDurableSequence = 0; // of the last record written (& synced, depending on the policy).
+static size_t _JournalStreamSize = 0; // bytes appended since the journal has been created.
+static size_t _JournalCheckpointOffset = 0; // stream offset of the last checkpoint.
+
+// Assume journal file lock.
+static io_file _JournalFile; // written at `_JournalFileEnd - _JournalFileStart`.
+static const char *_JournalFilename = nullptr;
+static uint8_t *_pJournalFlushBuffer = nullptr;
+static size_t _JournalFlushCapacity = 0;
+static size_t _JournalFlushSize = 0; // bytes of a failed flush, written again (in front of the pending records) by the next one.
+static size_t _JournalFileStart = 0; // stream offset of the first byte in the file.
+static size_t _JournalFileEnd = 0; // stream offset of the last byte in the file.
+
+//////////////////////////////////////////////////////////////////////////
+
+inline size_t journal_align(const size_t offset)
+{
+  return (offset + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+inline uint64_t journal_get_record_checksum(const uint8_t *pRecord, const size_t payloadSize)
+{
+  return snapshot_checksum(pRecord + sizeof(uint64_t), sizeof(journal_record_header) - sizeof(uint64_t) + payloadSize);
+}
+
+template <typename TFunc>
+lsResult journal_append(const journal_record_type type, const size_t payloadSize, const TFunc &fill, _Out_ uint64_t *pSequence) // Assumes mutex lock
+{
+  lsResult result = lsR_Success;
+
+  const size_t recordSize = journal_align(sizeof(journal_record_header) + payloadSize);
+
+  LS_ERROR_IF(pSequence == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(payloadSize > lsMaxValue<uint32_t>(), lsR_ArgumentOutOfBounds);
+
+  *pSequence = 0;
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_JournalLock);
+
+    if (!_JournalIsRunning)
+      goto epilogue;
+
+    if (_JournalPendingSize + recordSize > _JournalPendingCapacity)
+    {
+      const size_t newCapacity = lsMax(lsMax(_JournalPendingCapacity * 2, _JournalPendingSize + recordSize), JournalMinPendingCapacity);
+
+      LS_ERROR_CHECK(lsRealloc(&_pJournalPending, newCapacity));
+      _JournalPendingCapacity = newCapacity;
+    }
+
+    uint8_t *pRecord = _pJournalPending + _JournalPendingSize;
+    journal_record_header header;
+
+    lsZeroMemory(pRecord, recordSize);
+    fill(pRecord + sizeof(journal_record_header));
+
+    header.sequence = ++_JournalSequence;
+    header.type = type;
+    header.payloadSize = (uint32_t)payloadSize;
+    header.checksum = 0;
+    memcpy(pRecord, &header, sizeof(header));
+
+    header.checksum = journal_get_record_checksum(pRecord, payloadSize);
+    memcpy(pRecord, &header.checksum, sizeof(header.checksum));
+
+    _JournalPendingSize += recordSize;
+    _JournalStreamSize += recordSize;
+    *pSequence = header.sequence;
+  }
+
+  if (_JournalPolicy == jfp_Always)
+    _JournalCondition.notify_all();
+
+epilogue:
+  return result;
+}
+
+template <typename TRecord, typename TIds>
+void journal_write_item(uint8_t *pPayload, const size_t id, const TRecord &record, const TIds &ids, const arena_string &name)
+{
+  const uint64_t id64 = id;
+
+  memcpy(pPayload, &id64, sizeof(id64));
+  pPayload += sizeof(id64);
+
+  memcpy(pPayload, &record, sizeof(record));
+  pPayload += sizeof(record);
+
+  for (const size_t itemId : ids)
+  {
+    const uint64_t itemId64 = itemId;
+
+    memcpy(pPayload, &itemId64, sizeof(itemId64));
+    pPayload += sizeof(itemId64);
+  }
+
+  memcpy(pPayload, arena_string_get(name), arena_string_length(name));
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult journal_put_user(const size_t userId, const user &usr, _Out_ uint64_t *pSequence)
+{
+  const size_t nameLength = arena_string_length(usr.username);
+  const size_t idCount = usr.completedTasksForCurrentDay.count;
+  const size_t payloadSize = sizeof(uint64_t) + sizeof(snapshot_user_record) + idCount * sizeof(uint64_t) + nameLength;
+
+  return journal_append(jrt_PutUser, payloadSize, [&](uint8_t *pPayload) {
+    snapshot_user_record record;
+    snapshot_record_from_user(usr, &record);
+
+    record.nameLength = nameLength;
+    record.completedTaskCount = idCount;
+
+    journal_write_item(pPayload, userId, record, usr.completedTasksForCurrentDay, usr.username);
+  }, pSequence);
+}
+
+lsResult journal_put_event(const size_t eventId, const event &evnt, _Out_ uint64_t *pSequence)
+{
+  const size_t nameLength = arena_string_length(evnt.name);
+  const size_t idCount = evnt.userIds.count;
+  const size_t payloadSize = sizeof(uint64_t) + sizeof(snapshot_event_record) + idCount * sizeof(uint64_t) + nameLength;
+
+  return journal_append(jrt_PutEvent, payloadSize, [&](uint8_t *pPayload) {
+    snapshot_event_record record;
+    snapshot_record_from_event(evnt, &record);
+
+    record.nameLength = nameLength;
+    record.userIdCount = idCount;
+
+    journal_write_item(pPayload, eventId, record, evnt.userIds, evnt.name);
+  }, pSequence);
+}
+
+lsResult journal_clear_completed_tasks(_Out_ uint64_t *pSequence)
+{
+  return journal_append(jrt_ClearCompletedTasks, 0, [](uint8_t *) {}, pSequence);
+}
+
+lsResult journal_wait(const uint64_t sequence)
+{
+  lsResult result = lsR_Success;
+
+  if (sequence == 0 || _JournalPolicy != jfp_Always)
+    goto epilogue;
+
+  // Scope Lock
+  {
+    std::unique_lock lock(_JournalLock);
+
+    // Only fails if the flush that should have included `sequence` failed, the records are retried by the next flush nonetheless.
+    _JournalCondition.wait(lock, [&] { return _JournalDurableSequence >= sequence || (LS_FAILED(_JournalError) && _JournalFailedSequence >= sequence); });
+
+    LS_ERROR_IF(_JournalDurableSequence < sequence, _JournalError);
+  }
+
+epilogue:
+  return result;
+}
+
+size_t journal_get_size()
+{
+  std::scoped_lock lock(_JournalLock);
+
+  return _JournalStreamSize - _JournalCheckpointOffset;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult journal_flush() // Assumes journal file lock
+{
+  lsResult result = lsR_Success;
+
+  uint64_t sequence;
+  size_t size;
+
+  // Scope Lock: Swap buffers, so mutations can continue appending while writing.
+  {
+    std::scoped_lock lock(_JournalLock);
+
+    sequence = _JournalSequence;
+
+    if (_JournalFlushSize == 0)
+    {
+      std::swap(_pJournalPending, _pJournalFlushBuffer);
+      std::swap(_JournalPendingCapacity, _JournalFlushCapacity);
+
+      size = _JournalPendingSize;
+      _JournalPendingSize = 0;
+    }
+    else
+    {
+      // The records of the failed flush precede the pending ones in the stream.
+      size = _JournalFlushSize + _JournalPendingSize;
+
+      if (size > _JournalFlushCapacity)
+      {
+        LS_ERROR_CHECK(lsRealloc(&_pJournalFlushBuffer, size));
+        _JournalFlushCapacity = size;
+      }
+
+      memcpy(_pJournalFlushBuffer + _JournalFlushSize, _pJournalPending, _JournalPendingSize);
+      _JournalPendingSize = 0;
+    }
+
+    _JournalFlushSize = size;
+  }
+
+  if (size > 0)
+  {
+    // Rewrites whatever a failed attempt left at the end of the file.
+    LS_ERROR_CHECK(lsWriteFileAt(_JournalFile, _JournalFileEnd - _JournalFileStart, _pJournalFlushBuffer, size));
+
+    if (_JournalPolicy != jfp_Never)
+      LS_ERROR_CHECK(lsSyncFile(_JournalFile, fsm_Data)); // the timestamps don't need to be durable.
+
+    _JournalFileEnd += size;
+    _JournalFlushSize = 0;
+  }
+
+epilogue:
+  // Scope Lock
+  {
+    std::scoped_lock lock(_JournalLock);
+
+    if (LS_FAILED(result))
+    {
+      _JournalError = result;
+      _JournalFailedSequence = sequence;
+    }
+    else
+    {
+      _JournalError = lsR_Success;
+      _JournalDurableSequence = sequence;
+    }
+  }
+
+  _JournalCondition.notify_all();
+
+  return result;
+}
+
+void journal_flush_thread()
+{
+  bool isRunning = true;
+
+  while (isRunning)
+  {
+    // Scope Lock
+    {
+      std::unique_lock lock(_JournalLock);
+
+      // Group commit: everything appended while the previous write was in flight goes out with the next one.
+      // After a failed flush, the records are retried once per interval instead of on every append.
+      _JournalCondition.wait_for(lock, JournalFlushInterval, [] { return !_JournalIsRunning || (_JournalPolicy == jfp_Always && _JournalPendingSize > 0 && LS_SUCCESS(_JournalError)); });
+
+      isRunning = _JournalIsRunning;
+    }
+
+    // Scope Lock
+    {
+      std::scoped_lock lock(_JournalFileLock);
+
+      if (LS_FAILED(journal_flush()))
+        print_error_line("Failed to write journal '", _JournalFilename, "'.");
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template <typename TRecord>
+lsResult journal_read_item(const uint8_t *pPayload, const size_t payloadSize, uint64_t TRecord::*pIdCount, _Out_ size_t *pId, _Out_ TRecord *pRecord, _Out_ const uint64_t **ppIds, _Out_ const char **ppName)
+{
+  lsResult result = lsR_Success;
+
+  uint64_t id;
+  size_t remainingSize = payloadSize;
+
+  LS_ERROR_IF(remainingSize < sizeof(id) + sizeof(TRecord), lsR_ResourceInvalid);
+
+  memcpy(&id, pPayload, sizeof(id));
+  memcpy(pRecord, pPayload + sizeof(id), sizeof(TRecord));
+  remainingSize -= sizeof(id) + sizeof(TRecord);
+
+  LS_ERROR_IF(pRecord->*pIdCount > remainingSize / sizeof(uint64_t), lsR_ResourceInvalid);
+  remainingSize -= pRecord->*pIdCount * sizeof(uint64_t);
+
+  LS_ERROR_IF(pRecord->nameOffset != 0 || !snapshot_record_valid(*pRecord, remainingSize, pRecord->*pIdCount), lsR_ResourceInvalid);
+  LS_ERROR_IF(id > lsMaxValue<uint32_t>(), lsR_ResourceInvalid);
+
+  *pId = (size_t)id;
+  *ppIds = reinterpret_cast<const uint64_t *>(pPayload + sizeof(id) + sizeof(TRecord)); // records are 8 byte aligned.
+  *ppName = reinterpret_cast<const char *>(*ppIds + pRecord->*pIdCount);
+
+epilogue:
+  return result;
+}
+
+lsResult journal_apply_record(const journal_record_header &header, const uint8_t *pPayload) // Assumes mutex lock
+{
+  lsResult result = lsR_Success;
+
+  size_t id;
+  const uint64_t *pIds = nullptr;
+  const char *pName = nullptr;
+
+  switch (header.type)
+  {
+  case jrt_PutUser:
+  {
+    snapshot_user_record record;
+    user usr;
+
+    LS_ERROR_CHECK(journal_read_item(pPayload, header.payloadSize, &snapshot_user_record::completedTaskCount, &id, &record, &pIds, &pName));
+    LS_ERROR_CHECK(snapshot_user_from_record(record, pName, pIds, &usr));
+    LS_ERROR_CHECK(pool_insertAt(&_Users, std::move(usr), id, true));
+    _UserDataEpoch++; // outdates the schedules loaded with the snapshot.
+    break;
+  }
+
+  case jrt_PutEvent:
+  {
+    snapshot_event_record record;
+    event evnt;
+
+    LS_ERROR_CHECK(journal_read_item(pPayload, header.payloadSize, &snapshot_event_record::userIdCount, &id, &record, &pIds, &pName));
+    LS_ERROR_CHECK(snapshot_event_from_record(record, pName, pIds, &evnt));
+    LS_ERROR_CHECK(pool_insertAt(&_Events, std::move(evnt), id, true));
+    _EventDataEpoch++;
+    break;
+  }
+
+  case jrt_ClearCompletedTasks:
+  {
+    for (const auto &&_user : _Users)
+    {
+      list_clear(&_user.pItem->completedTasksForCurrentDay);
+      pool_mark_dirty(&_Users, _user.index);
+    }
+
+    break;
+  }
+
+  default:
+  {
+    LS_ERROR_SET(lsR_ResourceInvalid);
+  }
+  }
+
+epilogue:
+  return result;
+}
+
+lsResult journal_replay(const char *filename, const uint64_t snapshotSequence)
+{
+  lsResult result = lsR_Success;
+
+  mapped_file file;
+  size_t fileSize = 0;
+  size_t offset = 0;
+  size_t appliedCount = 0;
+  size_t skippedCount = 0;
+  uint64_t previousSequence = 0; // 0 before the first record, which continues wherever the compacted journal starts.
+  uint64_t lastSequence = snapshotSequence;
+
+  LS_ERROR_IF(filename == nullptr, lsR_ArgumentNull);
+
+  if (std::filesystem::exists(filename))
+  {
+    LS_ERROR_CHECK(lsMapFile(filename, &file));
+    fileSize = file.size;
+
+    // Scope Lock
+    {
+      std::scoped_lock lock(_ThreadLock);
+
+      while (fileSize - offset >= sizeof(journal_record_header))
+      {
+        const uint8_t *pRecord = file.pData + offset;
+        journal_record_header header;
+
+        memcpy(&header, pRecord, sizeof(header));
+
+        // Anything that doesn't check out is the torn tail of an interrupted write. Sequences have no gaps, so a missing record ends the journal as well.
+        if (header.payloadSize > fileSize - offset - sizeof(header) || header.checksum != journal_get_record_checksum(pRecord, header.payloadSize) || (previousSequence != 0 && header.sequence != previousSequence + 1))
+          break;
+
+        // Intact records that can't be applied are skipped, the records after them are still valid.
+        if (header.sequence > snapshotSequence)
+        {
+          if (LS_FAILED(journal_apply_record(header, pRecord + sizeof(header))))
+          {
+            print_error_line("Failed to apply journal record ", header.sequence, " (type ", header.type, ") from '", filename, "', skipping it.");
+            skippedCount++;
+          }
+          else
+          {
+            appliedCount++;
+          }
+        }
+
+        previousSequence = header.sequence;
+        lastSequence = lsMax(lastSequence, header.sequence);
+        offset = lsMin(journal_align(offset + sizeof(header) + header.payloadSize), fileSize);
+      }
+    }
+
+    lsUnmapFile(&file);
+
+    if (offset < fileSize)
+    {
+      print_error_line("Journal '", filename, "' is torn at byte ", offset, ", discarding the last ", fileSize - offset, " bytes.");
+
+      std::error_code error;
+      std::filesystem::resize_file(filename, offset, error);
+      LS_ERROR_IF(error, lsR_IOFailure);
+    }
+
+    print_log_line("Replayed ", appliedCount, " journal records from '", filename, "', skipped ", skippedCount, ".");
+  }
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_JournalLock);
+
+    _JournalSequence = lastSequence;
+    _JournalDurableSequence = lastSequence;
+    _JournalStreamSize = offset;
+    _JournalCheckpointOffset = 0;
+  }
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_JournalFileLock);
+
+    _JournalFileStart = 0;
+    _JournalFileEnd = offset;
+  }
+
+epilogue:
+  lsUnmapFile(&file);
+  return result;
+}
+
+lsResult journal_open(const char *filename, const journal_fsync_policy policy)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(filename == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(_pJournalThread != nullptr, lsR_ResourceStateInvalid);
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_JournalFileLock);
+
+    size_t fileSize;
+
+    LS_ERROR_CHECK(lsOpenFile(filename, fom_ReadWrite, &_JournalFile));
+    LS_ERROR_CHECK(lsGetFileSize(_JournalFile, &fileSize));
+    LS_ERROR_IF(fileSize != _JournalFileEnd - _JournalFileStart, lsR_ResourceStateInvalid); // `journal_replay` hasn't been called.
+
+    _JournalFilename = filename;
+  }
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_JournalLock);
+
+    _JournalPolicy = policy;
+    _JournalIsRunning = true;
+  }
+
+  _pJournalThread = new std::thread(journal_flush_thread);
+
+epilogue:
+  if (LS_FAILED(result))
+    lsCloseFile(&_JournalFile);
+
+  return result;
+}
+
+void journal_close()
+{
+  if (_pJournalThread == nullptr)
+    return;
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_JournalLock);
+
+    _JournalIsRunning = false;
+  }
+
+  _JournalCondition.notify_all();
+
+  _pJournalThread->join(); // flushes once more before exiting.
+  delete _pJournalThread;
+  _pJournalThread = nullptr;
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_JournalFileLock);
+
+    lsCloseFile(&_JournalFile);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult journal_compact(const size_t streamOffset) // Keeps the records from `streamOffset` onwards.
+{
+  lsResult result = lsR_Success;
+
+  std::scoped_lock lock(_JournalFileLock);
+
+  uint8_t *pTail = nullptr;
+  size_t tailSize = 0;
+
+  if (!lsIsFileOpen(_JournalFile))
+    goto epilogue;
+
+  LS_ERROR_CHECK(journal_flush()); // Everything up to `streamOffset` is in the file now.
+  LS_ERROR_IF(streamOffset < _JournalFileStart || streamOffset > _JournalFileEnd, lsR_ResourceStateInvalid);
+
+  tailSize = _JournalFileEnd - streamOffset;
+
+  // Read the records appended since the snapshot has been built. These are usually few.
+  if (tailSize > 0)
+  {
+    LS_ERROR_CHECK(lsAlloc(&pTail, tailSize));
+    LS_ERROR_CHECK(lsReadFileAt(_JournalFile, streamOffset - _JournalFileStart, pTail, tailSize));
+  }
+
+  // Swap in the compacted journal.
+  {
+    lsCloseFile(&_JournalFile); // Windows can't replace open files.
+
+    const lsResult writeResult = lsWriteFileBytesAtomic(_JournalFilename, pTail, tailSize);
+
+    LS_ERROR_CHECK(lsOpenFile(_JournalFilename, fom_ReadWrite, &_JournalFile));
+    LS_ERROR_CHECK(writeResult);
+
+    _JournalFileStart = streamOffset;
+  }
+
+epilogue:
+  lsFreePtr(&pTail);
+  return result;
+}
+
+lsResult journal_checkpoint(const char *snapshotFilename)
+{
+  lsResult result = lsR_Success;
+
+  uint64_t sequence;
+  size_t streamOffset;
+
+  LS_ERROR_IF(snapshotFilename == nullptr, lsR_ArgumentNull);
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_ThreadLock);
+
+    // Scope Lock: All records up to `sequence` have been applied to the pools, the ones after it will be appended from `streamOffset` onwards.
+    {
+      std::scoped_lock journalLock(_JournalLock);
+
+      sequence = _JournalSequence;
+      streamOffset = _JournalStreamSize;
+    }
+
+    result = snapshot_build(snapshotFilename, sequence);
+
+    if (result == lsR_ResourceBusy) // the previous checkpoint is still being written, the next one will pick up its changes.
+    {
+      result = lsR_Success;
+      goto epilogue;
+    }
+
+    LS_ERROR_CHECK(result);
+  }
+
+  // The journal may only be compacted once the snapshot is on disk.
+  LS_ERROR_CHECK(snapshot_write([streamOffset](const lsResult writeResult) {
+    if (LS_FAILED(writeResult))
+      return;
+
+    if (LS_FAILED(journal_compact(streamOffset)))
+    {
+      print_error_line("Failed to compact journal '", _JournalFilename, "'.");
+      return;
+    }
+
+    std::scoped_lock lock(_JournalLock);
+    _JournalCheckpointOffset = streamOffset;
+  }));
+
+epilogue:
+  return result;
+}
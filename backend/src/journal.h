@@ -0,0 +1,58 @@
+#pragma once
+
+#include "core.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+// Append-only log of the pool mutations since the last snapshot:
+//
+//   journal_record_header, payload, padding to 8 bytes
+//
+// Puts carry the full state of one user / event (`snapshot_*_record`, ids, name), so replaying a record twice is harmless.
+// Records are grouped in memory & written by a flush thread, so every mutation costs O(size of the changed item) instead of a full pool rewrite.
+// `journal_checkpoint` compacts the journal into a snapshot, the records after the snapshot's sequence are kept.
+
+enum journal_record_type : uint32_t
+{
+  jrt_PutUser, // payload: uint64_t id, snapshot_user_record, uint64_t completedTasks[], name.
+  jrt_PutEvent, // payload: uint64_t id, snapshot_event_record, uint64_t userIds[], name.
+  jrt_ClearCompletedTasks, // no payload.
+
+  jrt_Count,
+};
+
+struct journal_record_header
+{
+  uint64_t checksum; // of everything after this field, incl. the payload.
+  uint64_t sequence;
+  uint32_t type;
+  uint32_t payloadSize; // excluding the padding.
+};
+
+static_assert(sizeof(journal_record_header) % sizeof(uint64_t) == 0);
+
+enum journal_fsync_policy
+{
+  jfp_Never, // written by the flush thread, durability is left to the OS.
+  jfp_Periodic, // synced by the flush thread about once per second, a crash may lose the last second.
+  jfp_Always, // mutations wait in `journal_wait` until their group of records has been synced.
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+struct user;
+struct event;
+
+lsResult journal_replay(const char *filename, const uint64_t snapshotSequence); // Call before `journal_open`. Applies all records after `snapshotSequence` and cuts off a torn tail (incl. sequence gaps). Records that fail to apply are skipped.
+lsResult journal_open(const char *filename, const journal_fsync_policy policy);
+void journal_close(); // Flushes & syncs the remaining records.
+
+// Return the sequence of the appended record (0 if the journal isn't open), pass it to `journal_wait` once the mutex is unlocked.
+lsResult journal_put_user(const size_t userId, const user &usr, _Out_ uint64_t *pSequence); // Assumes mutex lock
+lsResult journal_put_event(const size_t eventId, const event &evnt, _Out_ uint64_t *pSequence); // Assumes mutex lock
+lsResult journal_clear_completed_tasks(_Out_ uint64_t *pSequence); // Assumes mutex lock
+
+lsResult journal_wait(const uint64_t sequence); // Only blocks with `jfp_Always`.
+
+size_t journal_get_size(); // bytes appended since the last checkpoint.
+lsResult journal_checkpoint(const char *snapshotFilename); // Locks the mutex while copying the pools. The snapshot is written & the journal compacted on the writer thread.
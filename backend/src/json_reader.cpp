@@ -0,0 +1,471 @@
+#include "json_reader.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+constexpr size_t JsonReaderMaxIntDigits = 18; // every 18 digit number fits into `int64_t`.
+constexpr size_t JsonReaderMaxUIntDigits = 19; // every 19 digit number fits into `uint64_t`.
+
+//////////////////////////////////////////////////////////////////////////
+
+inline void json_reader_skip_whitespace(json_reader *pReader)
+{
+  while (pReader->pPos < pReader->pEnd && (*pReader->pPos == ' ' || *pReader->pPos == '\t' || *pReader->pPos == '\n' || *pReader->pPos == '\r'))
+    pReader->pPos++;
+}
+
+lsResult json_reader_begin_value(json_reader *pReader)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pReader == nullptr, lsR_ArgumentNull);
+
+  json_reader_skip_whitespace(pReader);
+  LS_ERROR_IF(pReader->pPos >= pReader->pEnd, lsR_EndOfStream);
+
+epilogue:
+  return result;
+}
+
+lsResult json_reader_begin_scope(json_reader *pReader, const char open)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(json_reader_begin_value(pReader));
+  LS_ERROR_IF(*pReader->pPos != open, lsR_ResourceInvalid);
+  LS_ERROR_IF(pReader->depth >= JsonReaderMaxDepth, lsR_ResourceFull);
+
+  pReader->pPos++;
+  pReader->hasValuesMask &= ~((uint64_t)1 << pReader->depth);
+  pReader->depth++;
+
+epilogue:
+  return result;
+}
+
+// Consumes either the closing bracket or the separator before the next value.
+lsResult json_reader_next_in_scope(json_reader *pReader, const char close, _Out_ bool *pHasNext)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pHasNext == nullptr, lsR_ArgumentNull);
+  LS_ERROR_CHECK(json_reader_begin_value(pReader));
+  LS_ERROR_IF(pReader->depth == 0, lsR_ResourceStateInvalid);
+
+  {
+    const uint64_t depthBit = (uint64_t)1 << (pReader->depth - 1);
+
+    if (*pReader->pPos == close)
+    {
+      pReader->pPos++;
+      pReader->depth--;
+      *pHasNext = false;
+      goto epilogue;
+    }
+
+    if (pReader->hasValuesMask & depthBit)
+    {
+      LS_ERROR_IF(*pReader->pPos != ',', lsR_ResourceInvalid);
+      pReader->pPos++;
+
+      LS_ERROR_CHECK(json_reader_begin_value(pReader));
+      LS_ERROR_IF(*pReader->pPos == close, lsR_ResourceInvalid); // trailing separator.
+    }
+
+    pReader->hasValuesMask |= depthBit;
+    *pHasNext = true;
+  }
+
+epilogue:
+  return result;
+}
+
+// Expects `pPos` at the opening quote, leaves it after the closing one.
+lsResult json_reader_skip_string(json_reader *pReader, _Out_ const char **pStart, _Out_ const char **pStringEnd)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(*pReader->pPos != '"', lsR_ResourceInvalid);
+
+  pReader->pPos++;
+  *pStart = pReader->pPos;
+
+  while (true)
+  {
+    LS_ERROR_IF(pReader->pPos >= pReader->pEnd, lsR_EndOfStream);
+
+    const char c = *(pReader->pPos++);
+
+    if (c == '"')
+      break;
+
+    if (c == '\\')
+    {
+      LS_ERROR_IF(pReader->pPos >= pReader->pEnd, lsR_EndOfStream);
+      pReader->pPos++;
+    }
+  }
+
+  *pStringEnd = pReader->pPos - 1;
+
+epilogue:
+  return result;
+}
+
+lsResult json_reader_parse_hex4(json_reader *pReader, _Out_ uint32_t *pValue)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pReader->pEnd - pReader->pPos < 4, lsR_EndOfStream);
+
+  *pValue = 0;
+
+  for (size_t i = 0; i < 4; i++)
+  {
+    const char c = *(pReader->pPos++);
+    uint32_t digit = 0;
+
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      digit = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      digit = c - 'A' + 10;
+    else
+      LS_ERROR_SET(lsR_ResourceInvalid);
+
+    *pValue = (*pValue << 4) | digit;
+  }
+
+epilogue:
+  return result;
+}
+
+// Checks that an integer is followed by a delimiter inside the input, so `lsParseInt` & `lsParseUInt` can't read past the end.
+lsResult json_reader_scan_integer(json_reader *pReader, const bool allowNegative, const size_t maxDigits)
+{
+  lsResult result = lsR_Success;
+
+  const char *pDigits = pReader->pPos;
+
+  if (allowNegative && pDigits < pReader->pEnd && *pDigits == '-')
+    pDigits++;
+
+  {
+    const char *pDigitsEnd = pDigits;
+
+    while (pDigitsEnd < pReader->pEnd && *pDigitsEnd >= '0' && *pDigitsEnd <= '9')
+      pDigitsEnd++;
+
+    LS_ERROR_IF(pDigitsEnd == pDigits, lsR_ResourceInvalid);
+    LS_ERROR_IF((size_t)(pDigitsEnd - pDigits) > maxDigits, lsR_ArgumentOutOfBounds);
+    LS_ERROR_IF(pDigitsEnd >= pReader->pEnd, lsR_EndOfStream);
+    LS_ERROR_IF(*pDigitsEnd == '.' || *pDigitsEnd == 'e' || *pDigitsEnd == 'E', lsR_ResourceInvalid); // not an integer.
+  }
+
+epilogue:
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult json_reader_create(_Out_ json_reader *pReader, const char *pData, const size_t size)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pReader == nullptr || (pData == nullptr && size > 0), lsR_ArgumentNull);
+
+  *pReader = json_reader();
+  pReader->pPos = pData;
+  pReader->pEnd = pData + size;
+
+epilogue:
+  return result;
+}
+
+lsResult json_reader_end(json_reader *pReader)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pReader == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(pReader->depth != 0, lsR_ResourceStateInvalid);
+
+  json_reader_skip_whitespace(pReader);
+  LS_ERROR_IF(pReader->pPos != pReader->pEnd, lsR_ResourceInvalid);
+
+epilogue:
+  return result;
+}
+
+lsResult json_reader_begin_array(json_reader *pReader)
+{
+  return json_reader_begin_scope(pReader, '[');
+}
+
+lsResult json_reader_next_element(json_reader *pReader, _Out_ bool *pHasElement)
+{
+  return json_reader_next_in_scope(pReader, ']', pHasElement);
+}
+
+lsResult json_reader_begin_object(json_reader *pReader)
+{
+  return json_reader_begin_scope(pReader, '{');
+}
+
+lsResult json_reader_next_member(json_reader *pReader, _Out_ bool *pHasMember, _Out_ json_reader_key *pKey)
+{
+  lsResult result = lsR_Success;
+
+  const char *pKeyEnd = nullptr;
+
+  LS_ERROR_IF(pKey == nullptr, lsR_ArgumentNull);
+  LS_ERROR_CHECK(json_reader_next_in_scope(pReader, '}', pHasMember));
+
+  if (!*pHasMember)
+    goto epilogue;
+
+  LS_ERROR_CHECK(json_reader_skip_string(pReader, &pKey->text, &pKeyEnd));
+  pKey->length = pKeyEnd - pKey->text;
+
+  LS_ERROR_CHECK(json_reader_begin_value(pReader));
+  LS_ERROR_IF(*pReader->pPos != ':', lsR_ResourceInvalid);
+  pReader->pPos++;
+
+epilogue:
+  return result;
+}
+
+lsResult json_reader_string(json_reader *pReader, _Out_ char *buffer, const size_t capacity, _Out_ size_t *pLength)
+{
+  lsResult result = lsR_Success;
+
+  size_t length = 0;
+
+  LS_ERROR_IF(buffer == nullptr || pLength == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(capacity == 0, lsR_ArgumentOutOfBounds);
+  LS_ERROR_CHECK(json_reader_begin_value(pReader));
+  LS_ERROR_IF(*pReader->pPos != '"', lsR_ResourceInvalid);
+
+  pReader->pPos++;
+
+  while (true)
+  {
+    LS_ERROR_IF(pReader->pPos >= pReader->pEnd, lsR_EndOfStream);
+
+    char c = *(pReader->pPos++);
+
+    if (c == '"')
+      break;
+
+    LS_ERROR_IF((uint8_t)c < 0x20, lsR_ResourceInvalid);
+
+    if (c != '\\')
+    {
+      LS_ERROR_IF(length + 1 >= capacity, lsR_ArgumentOutOfBounds);
+      buffer[length++] = c;
+      continue;
+    }
+
+    LS_ERROR_IF(pReader->pPos >= pReader->pEnd, lsR_EndOfStream);
+    c = *(pReader->pPos++);
+
+    switch (c)
+    {
+    case '"': case '\\': case '/': break;
+    case 'b': c = '\b'; break;
+    case 'f': c = '\f'; break;
+    case 'n': c = '\n'; break;
+    case 'r': c = '\r'; break;
+    case 't': c = '\t'; break;
+
+    case 'u':
+    {
+      uint32_t codePoint;
+      LS_ERROR_CHECK(json_reader_parse_hex4(pReader, &codePoint));
+
+      if (codePoint >= 0xD800 && codePoint <= 0xDBFF) // high surrogate, the low one has to follow.
+      {
+        uint32_t lowSurrogate;
+
+        LS_ERROR_IF(pReader->pEnd - pReader->pPos < 2 || pReader->pPos[0] != '\\' || pReader->pPos[1] != 'u', lsR_ResourceInvalid);
+        pReader->pPos += 2;
+
+        LS_ERROR_CHECK(json_reader_parse_hex4(pReader, &lowSurrogate));
+        LS_ERROR_IF(lowSurrogate < 0xDC00 || lowSurrogate > 0xDFFF, lsR_ResourceInvalid);
+
+        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+      }
+      else
+      {
+        LS_ERROR_IF(codePoint >= 0xDC00 && codePoint <= 0xDFFF, lsR_ResourceInvalid);
+      }
+
+      // UTF-8.
+      {
+        const size_t bytes = codePoint < 0x80 ? 1 : codePoint < 0x800 ? 2 : codePoint < 0x10000 ? 3 : 4;
+
+        LS_ERROR_IF(length + bytes >= capacity, lsR_ArgumentOutOfBounds);
+
+        switch (bytes)
+        {
+        case 1:
+          buffer[length++] = (char)codePoint;
+          break;
+
+        case 2:
+          buffer[length++] = (char)(0xC0 | (codePoint >> 6));
+          buffer[length++] = (char)(0x80 | (codePoint & 0x3F));
+          break;
+
+        case 3:
+          buffer[length++] = (char)(0xE0 | (codePoint >> 12));
+          buffer[length++] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+          buffer[length++] = (char)(0x80 | (codePoint & 0x3F));
+          break;
+
+        default:
+          buffer[length++] = (char)(0xF0 | (codePoint >> 18));
+          buffer[length++] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+          buffer[length++] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+          buffer[length++] = (char)(0x80 | (codePoint & 0x3F));
+          break;
+        }
+      }
+
+      continue;
+    }
+
+    default:
+    {
+      LS_ERROR_SET(lsR_ResourceInvalid);
+    }
+    }
+
+    LS_ERROR_IF(length + 1 >= capacity, lsR_ArgumentOutOfBounds);
+    buffer[length++] = c;
+  }
+
+  buffer[length] = '\0';
+  *pLength = length;
+
+epilogue:
+  return result;
+}
+
+lsResult json_reader_int(json_reader *pReader, _Out_ int64_t *pValue)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pValue == nullptr, lsR_ArgumentNull);
+  LS_ERROR_CHECK(json_reader_begin_value(pReader));
+  LS_ERROR_CHECK(json_reader_scan_integer(pReader, true, JsonReaderMaxIntDigits));
+
+  *pValue = lsParseInt(pReader->pPos, &pReader->pPos);
+
+epilogue:
+  return result;
+}
+
+lsResult json_reader_uint(json_reader *pReader, _Out_ uint64_t *pValue)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pValue == nullptr, lsR_ArgumentNull);
+  LS_ERROR_CHECK(json_reader_begin_value(pReader));
+  LS_ERROR_CHECK(json_reader_scan_integer(pReader, false, JsonReaderMaxUIntDigits));
+
+  *pValue = lsParseUInt(pReader->pPos, &pReader->pPos);
+
+epilogue:
+  return result;
+}
+
+lsResult json_reader_peek(json_reader *pReader, _Out_ json_value_type *pType)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pType == nullptr, lsR_ArgumentNull);
+  LS_ERROR_CHECK(json_reader_begin_value(pReader));
+
+  switch (*pReader->pPos)
+  {
+  case 'n': *pType = jvt_Null; break;
+  case 't': case 'f': *pType = jvt_Bool; break;
+  case '"': *pType = jvt_String; break;
+  case '[': *pType = jvt_Array; break;
+  case '{': *pType = jvt_Object; break;
+
+  default:
+  {
+    LS_ERROR_IF(*pReader->pPos != '-' && (*pReader->pPos < '0' || *pReader->pPos > '9'), lsR_ResourceInvalid);
+    *pType = jvt_Number;
+    break;
+  }
+  }
+
+epilogue:
+  return result;
+}
+
+lsResult json_reader_skip(json_reader *pReader)
+{
+  lsResult result = lsR_Success;
+
+  const char *pUnused;
+
+  LS_ERROR_CHECK(json_reader_begin_value(pReader));
+
+  switch (*pReader->pPos)
+  {
+  case '"':
+  {
+    LS_ERROR_CHECK(json_reader_skip_string(pReader, &pUnused, &pUnused));
+    break;
+  }
+
+  case '[':
+  case '{':
+  {
+    size_t nesting = 0;
+
+    do
+    {
+      LS_ERROR_IF(pReader->pPos >= pReader->pEnd, lsR_EndOfStream);
+
+      switch (*pReader->pPos)
+      {
+      case '"':
+        LS_ERROR_CHECK(json_reader_skip_string(pReader, &pUnused, &pUnused));
+        continue;
+
+      case '[':
+      case '{':
+        nesting++;
+        break;
+
+      case ']':
+      case '}':
+        nesting--;
+        break;
+      }
+
+      pReader->pPos++;
+    } while (nesting > 0);
+
+    break;
+  }
+
+  default: // numbers & literals.
+  {
+    const char *pStart = pReader->pPos;
+
+    while (pReader->pPos < pReader->pEnd && strchr(",]} \t\r\n", *pReader->pPos) == nullptr)
+      pReader->pPos++;
+
+    LS_ERROR_IF(pReader->pPos == pStart, lsR_ResourceInvalid);
+    break;
+  }
+  }
+
+epilogue:
+  return result;
+}
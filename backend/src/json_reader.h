@@ -0,0 +1,54 @@
+#pragma once
+
+#include "core.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+// Pull parser over a JSON document in memory (e.g. a mapped file), the counterpart of `json_writer`.
+// The caller walks the document & reads values straight into its own structures, nothing is allocated.
+// The input doesn't need to be null terminated, every read is bounds checked.
+
+constexpr size_t JsonReaderMaxDepth = sizeof(uint64_t) * CHAR_BIT;
+
+struct json_reader
+{
+  const char *pPos = nullptr;
+  const char *pEnd = nullptr;
+  size_t depth = 0;
+  uint64_t hasValuesMask = 0; // bit per depth: a separator is required before the next value.
+};
+
+enum json_value_type
+{
+  jvt_Null,
+  jvt_Bool,
+  jvt_Number,
+  jvt_String,
+  jvt_Array,
+  jvt_Object,
+};
+
+struct json_reader_key
+{
+  const char *text; // raw, escape sequences are not decoded.
+  size_t length;
+};
+
+lsResult json_reader_create(_Out_ json_reader *pReader, const char *pData, const size_t size);
+lsResult json_reader_end(json_reader *pReader); // Expects nothing but whitespace after the document.
+
+lsResult json_reader_begin_array(json_reader *pReader);
+lsResult json_reader_next_element(json_reader *pReader, _Out_ bool *pHasElement); // Consumes the separator or the closing bracket.
+lsResult json_reader_begin_object(json_reader *pReader);
+lsResult json_reader_next_member(json_reader *pReader, _Out_ bool *pHasMember, _Out_ json_reader_key *pKey); // Consumes the separator, the key & the colon or the closing brace.
+
+lsResult json_reader_string(json_reader *pReader, _Out_ char *buffer, const size_t capacity, _Out_ size_t *pLength); // Decodes escape sequences, null terminates `buffer`.
+lsResult json_reader_int(json_reader *pReader, _Out_ int64_t *pValue);
+lsResult json_reader_uint(json_reader *pReader, _Out_ uint64_t *pValue);
+lsResult json_reader_peek(json_reader *pReader, _Out_ json_value_type *pType); // The type of the next value, without consuming it.
+lsResult json_reader_skip(json_reader *pReader); // Skips over any value, incl. nested arrays & objects.
+
+inline bool json_reader_key_equals(const json_reader_key &key, const char *name)
+{
+  return strncmp(key.text, name, key.length) == 0 && name[key.length] == '\0';
+}
@@ -0,0 +1,291 @@
+#include "json_writer.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+static const sformatState _JsonWriterNumberFormat; // plain decimal, independent of changes to the thread's `sformat` state.
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult json_writer_reserve(json_writer *pWriter, const size_t bytes)
+{
+  lsResult result = lsR_Success;
+
+  if (pWriter->size + bytes <= pWriter->capacity)
+    goto epilogue;
+
+  if (pWriter->flush)
+  {
+    LS_ERROR_CHECK(json_writer_flush(pWriter));
+
+    if (bytes <= pWriter->capacity)
+      goto epilogue;
+  }
+
+  // No flush function or a single value larger than the buffer.
+  {
+    const size_t newCapacity = lsMax(pWriter->capacity * 2, pWriter->size + bytes);
+
+    LS_ERROR_CHECK(lsRealloc(&pWriter->pBuffer, newCapacity));
+    pWriter->capacity = newCapacity;
+  }
+
+epilogue:
+  return result;
+}
+
+lsResult json_writer_begin_value(json_writer *pWriter, const size_t maxBytes)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pWriter == nullptr, lsR_ArgumentNull);
+  LS_ERROR_CHECK(json_writer_reserve(pWriter, maxBytes + 1));
+
+  if (pWriter->afterKey)
+  {
+    pWriter->afterKey = false;
+  }
+  else if (pWriter->depth > 0)
+  {
+    const uint64_t depthBit = (uint64_t)1 << (pWriter->depth - 1);
+
+    if (pWriter->hasValuesMask & depthBit)
+      pWriter->pBuffer[pWriter->size++] = ',';
+
+    pWriter->hasValuesMask |= depthBit;
+  }
+
+epilogue:
+  return result;
+}
+
+size_t json_writer_get_escaped_max_bytes(const size_t length)
+{
+  return 2 + length * 6; // every character escaped as `\u00XX` at worst.
+}
+
+void json_writer_append_escaped(json_writer *pWriter, const char *text, const size_t length) // Expects the space to be reserved.
+{
+  constexpr char HexDigits[] = "0123456789abcdef";
+
+  char *pOut = pWriter->pBuffer + pWriter->size;
+
+  *(pOut++) = '"';
+
+  for (size_t i = 0; i < length; i++)
+  {
+    const char c = text[i];
+
+    switch (c)
+    {
+    case '"': *(pOut++) = '\\'; *(pOut++) = '"'; break;
+    case '\\': *(pOut++) = '\\'; *(pOut++) = '\\'; break;
+    case '\n': *(pOut++) = '\\'; *(pOut++) = 'n'; break;
+    case '\r': *(pOut++) = '\\'; *(pOut++) = 'r'; break;
+    case '\t': *(pOut++) = '\\'; *(pOut++) = 't'; break;
+
+    default:
+    {
+      if ((uint8_t)c < 0x20)
+      {
+        memcpy(pOut, "\\u00", 4);
+        pOut[4] = HexDigits[(uint8_t)c >> 4];
+        pOut[5] = HexDigits[(uint8_t)c & 0xF];
+        pOut += 6;
+      }
+      else
+      {
+        *(pOut++) = c;
+      }
+
+      break;
+    }
+    }
+  }
+
+  *(pOut++) = '"';
+
+  pWriter->size = pOut - pWriter->pBuffer;
+}
+
+lsResult json_writer_begin_scope(json_writer *pWriter, const char open)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pWriter == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(pWriter->depth >= JsonWriterMaxDepth, lsR_ResourceFull);
+  LS_ERROR_CHECK(json_writer_begin_value(pWriter, 1));
+
+  pWriter->pBuffer[pWriter->size++] = open;
+  pWriter->hasValuesMask &= ~((uint64_t)1 << pWriter->depth);
+  pWriter->depth++;
+
+epilogue:
+  return result;
+}
+
+lsResult json_writer_end_scope(json_writer *pWriter, const char close)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pWriter == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(pWriter->depth == 0 || pWriter->afterKey, lsR_ResourceStateInvalid);
+  LS_ERROR_CHECK(json_writer_reserve(pWriter, 1));
+
+  pWriter->pBuffer[pWriter->size++] = close;
+  pWriter->depth--;
+
+epilogue:
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult json_writer_create(_Out_ json_writer *pWriter, json_writer_flush_func &&flush, const size_t capacity)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pWriter == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(capacity == 0, lsR_InvalidParameter);
+
+  *pWriter = json_writer();
+
+  LS_ERROR_CHECK(lsAlloc(&pWriter->pBuffer, capacity));
+
+  pWriter->capacity = capacity;
+  pWriter->flush = std::move(flush);
+
+epilogue:
+  return result;
+}
+
+void json_writer_destroy(json_writer *pWriter)
+{
+  if (pWriter == nullptr)
+    return;
+
+  lsFreePtr(&pWriter->pBuffer);
+  *pWriter = json_writer();
+}
+
+lsResult json_writer_flush(json_writer *pWriter)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pWriter == nullptr, lsR_ArgumentNull);
+
+  if (!pWriter->flush || pWriter->size == 0)
+    goto epilogue;
+
+  LS_ERROR_CHECK(pWriter->flush(pWriter->pBuffer, pWriter->size));
+  pWriter->size = 0;
+
+epilogue:
+  return result;
+}
+
+void json_writer_reset(json_writer *pWriter)
+{
+  if (pWriter == nullptr)
+    return;
+
+  pWriter->size = 0;
+  pWriter->depth = 0;
+  pWriter->hasValuesMask = 0;
+  pWriter->afterKey = false;
+}
+
+lsResult json_writer_begin_object(json_writer *pWriter)
+{
+  return json_writer_begin_scope(pWriter, '{');
+}
+
+lsResult json_writer_end_object(json_writer *pWriter)
+{
+  return json_writer_end_scope(pWriter, '}');
+}
+
+lsResult json_writer_begin_array(json_writer *pWriter)
+{
+  return json_writer_begin_scope(pWriter, '[');
+}
+
+lsResult json_writer_end_array(json_writer *pWriter)
+{
+  return json_writer_end_scope(pWriter, ']');
+}
+
+lsResult json_writer_key(json_writer *pWriter, const char *key)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pWriter == nullptr || key == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(pWriter->depth == 0 || pWriter->afterKey, lsR_ResourceStateInvalid);
+
+  {
+    const size_t length = strlen(key);
+
+    LS_ERROR_CHECK(json_writer_begin_value(pWriter, json_writer_get_escaped_max_bytes(length) + 1));
+
+    json_writer_append_escaped(pWriter, key, length);
+    pWriter->pBuffer[pWriter->size++] = ':';
+    pWriter->afterKey = true;
+  }
+
+epilogue:
+  return result;
+}
+
+lsResult json_writer_string(json_writer *pWriter, const char *text, const size_t length)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(text == nullptr && length > 0, lsR_ArgumentNull);
+  LS_ERROR_CHECK(json_writer_begin_value(pWriter, json_writer_get_escaped_max_bytes(length)));
+
+  json_writer_append_escaped(pWriter, text, length);
+
+epilogue:
+  return result;
+}
+
+lsResult json_writer_string(json_writer *pWriter, const char *text)
+{
+  return json_writer_string(pWriter, text, text == nullptr ? 0 : strlen(text));
+}
+
+lsResult json_writer_int(json_writer *pWriter, const int64_t value)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(json_writer_begin_value(pWriter, sformat_GetMaxBytes(value, _JsonWriterNumberFormat)));
+
+  pWriter->size += _sformat_Append(value, _JsonWriterNumberFormat, pWriter->pBuffer + pWriter->size);
+
+epilogue:
+  return result;
+}
+
+lsResult json_writer_uint(json_writer *pWriter, const uint64_t value)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(json_writer_begin_value(pWriter, sformat_GetMaxBytes(value, _JsonWriterNumberFormat)));
+
+  pWriter->size += _sformat_Append(value, _JsonWriterNumberFormat, pWriter->pBuffer + pWriter->size);
+
+epilogue:
+  return result;
+}
+
+lsResult json_writer_bool(json_writer *pWriter, const bool value)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(json_writer_begin_value(pWriter, 5));
+
+  memcpy(pWriter->pBuffer + pWriter->size, value ? "true" : "false", value ? 4 : 5);
+  pWriter->size += value ? 4 : 5;
+
+epilogue:
+  return result;
+}
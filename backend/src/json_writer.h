@@ -0,0 +1,45 @@
+#pragma once
+
+#include "core.h"
+
+#include <functional>
+
+//////////////////////////////////////////////////////////////////////////
+
+// Streaming JSON encoder: values are appended to a fixed size buffer, which is handed to `flush` whenever it runs full.
+// Nothing is buffered per value, so encoding costs one pass & `JsonWriterBufferSize` bytes regardless of the size of the document.
+// Without a `flush` function the buffer grows instead & holds the whole document.
+
+constexpr size_t JsonWriterBufferSize = 64 * 1024;
+constexpr size_t JsonWriterMaxDepth = sizeof(uint64_t) * CHAR_BIT;
+
+typedef std::function<lsResult(const char *pData, const size_t size)> json_writer_flush_func;
+
+struct json_writer
+{
+  char *pBuffer = nullptr;
+  size_t capacity = 0;
+  size_t size = 0;
+  size_t depth = 0;
+  uint64_t hasValuesMask = 0; // bit per depth: a separator is required before the next value.
+  bool afterKey = false;
+  json_writer_flush_func flush;
+};
+
+lsResult json_writer_create(_Out_ json_writer *pWriter, json_writer_flush_func &&flush, const size_t capacity = JsonWriterBufferSize);
+void json_writer_destroy(json_writer *pWriter);
+
+lsResult json_writer_flush(json_writer *pWriter); // Hands the buffered bytes to `flush`. Call once the document is complete.
+void json_writer_reset(json_writer *pWriter); // Starts a new document, keeping the buffer. Drops anything not flushed yet.
+
+lsResult json_writer_begin_object(json_writer *pWriter);
+lsResult json_writer_end_object(json_writer *pWriter);
+lsResult json_writer_begin_array(json_writer *pWriter);
+lsResult json_writer_end_array(json_writer *pWriter);
+lsResult json_writer_key(json_writer *pWriter, const char *key);
+
+lsResult json_writer_string(json_writer *pWriter, const char *text, const size_t length);
+lsResult json_writer_string(json_writer *pWriter, const char *text);
+lsResult json_writer_int(json_writer *pWriter, const int64_t value);
+lsResult json_writer_uint(json_writer *pWriter, const uint64_t value);
+lsResult json_writer_bool(json_writer *pWriter, const bool value);
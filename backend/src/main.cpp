@@ -46,41 +46,126 @@ namespace asio
 
 #include "schedd.h"
 #include "io.h"
+#include "snapshot.h"
+#include "journal.h"
+#include "writer.h"
+#include "push.h"
+#include "json_writer.h"
+#include "json_reader.h"
+#include "response_compression.h"
+#include "static_assets.h"
+#include "admission.h"
 
 //////////////////////////////////////////////////////////////////////////
 
+struct request_fields;
+
 crow::response handle_login(const crow::request &req);
 crow::response handle_logout(const crow::request &req);
 crow::response handle_user_registration(const crow::request &req);
-crow::response handle_user_time_info(const crow::request &req);
+crow::response handle_user_time_info(const crow::request &req, const request_fields &fields, const size_t userId);
 crow::response handle_user_edit(const crow::request &req);
 crow::response handle_task_creation_modification(const crow::request &req, const bool isCreation);
-crow::response handle_user_schedule(const crow::request &req);
-crow::response handle_user_search(const crow::request &req);
-crow::response handle_event_search(const crow::request &req);
+crow::response handle_user_schedule(const crow::request &req, const request_fields &fields, const size_t userId);
+crow::response handle_user_search(const crow::request &req, const request_fields &fields, const size_t userId);
+crow::response handle_event_search(const crow::request &req, const request_fields &fields, const size_t userId);
 crow::response handle_event_completed(const crow::request &req, const bool needsReschdule);
-crow::response handle_task_details(const crow::request &req);
+crow::response handle_task_details(const crow::request &req, const request_fields &fields, const size_t userId);
+crow::response handle_batch(const crow::request &req);
+crow::response handle_static_asset(const crow::request &req, const char *path);
+
+typedef crow::response (*session_handler)(const crow::request &req, const request_fields &fields, const size_t userId);
+crow::response handle_with_session(const crow::request &req, const session_handler handler);
+void handle_schedule_updates_message(crow::websocket::connection &connection, const std::string &message, const bool isBinary);
+void handle_schedule_updates_close(crow::websocket::connection &connection);
+
+// Rejects requests with `429` before their handler runs, see `admission.h`.
+struct admission_middleware
+{
+  struct context
+  {
+    int64_t startTimeNs = 0;
+    bool isAdmitted = false;
+  };
+
+  void before_handle(crow::request &req, crow::response &res, context &ctx);
+  void after_handle(crow::request &req, crow::response &res, context &ctx);
+};
+
+// Compresses the bodies of all responses once their handler is done, see `response_compression.h`.
+struct response_compression_middleware
+{
+  struct context {};
+
+  void before_handle(crow::request &, crow::response &, context &) {}
+  void after_handle(crow::request &req, crow::response &res, context &);
+};
 
 //////////////////////////////////////////////////////////////////////////
 
 std::atomic<bool> _IsRunning = true;
 std::thread *pAsyncTasksThread = nullptr;
-static std::mutex _ThreadLock;
 
-void async_tasks();
+void async_tasks(const bool schedulesAreCurrent);
+void write_checkpoint();
 void writeUsersPoolToFile();
 void writeEventsPoolToFile();
 
 void deserializeUsersPool();
 void deserialzieEventsPool();
 
+const char *_FileNameSnapshot = "schedd.snapshot";
+const char *_FileNameJournal = "schedd.journal";
+const char *_FrontendDirectory = "../frontend";
+
+constexpr journal_fsync_policy JournalFsyncPolicy = jfp_Always;
+constexpr size_t CheckpointJournalSize = 4 * 1024 * 1024; // bytes.
+constexpr size_t CheckpointIntervalSeconds = 60 * 60;
+constexpr size_t ScheduleUpdatesMaxRequestBytes = 256; // the authenticating message, nothing else is read.
+
 //////////////////////////////////////////////////////////////////////////
 
 int32_t main(void)
 {
+  uint64_t snapshotSequence = 0;
+  bool needsCheckpoint = false;
+
+  if (LS_FAILED(writer_start()))
+    print_error_line("Failed to start the writer thread.");
+
   // Deserialize.
-  deserializeUsersPool();
-  deserialzieEventsPool();
+  if (LS_FAILED(snapshot_load(_FileNameSnapshot, &snapshotSequence)))
+  {
+    print_log_line("Snapshot '", _FileNameSnapshot, "' unavailable, falling back to the JSON pools.");
+
+    deserializeUsersPool();
+    deserialzieEventsPool();
+
+    snapshotSequence = 0; // Puts are idempotent, so replaying records the JSON pools already contain is fine.
+    needsCheckpoint = true;
+  }
+
+  if (LS_FAILED(journal_replay(_FileNameJournal, snapshotSequence)))
+    print_error_line("Failed to replay journal '", _FileNameJournal, "'.");
+
+  if (LS_FAILED(journal_open(_FileNameJournal, JournalFsyncPolicy)))
+    print_error_line("Failed to open journal '", _FileNameJournal, "'. Changes will not be persisted.");
+
+  if (needsCheckpoint)
+    if (LS_FAILED(journal_checkpoint(_FileNameSnapshot)))
+      print_error_line("Failed to write checkpoint.");
+
+  if (LS_FAILED(rebuild_event_ids_by_user()))
+    print_error_line("Failed to index events by user.");
+
+  // Replayed journal records outdate the snapshot's schedules, so only clean restarts on the same day reuse them.
+  const bool schedulesAreCurrent = schedules_are_current(get_days_since_new_year());
+
+  if (schedulesAreCurrent)
+    print_log_line("Reusing the schedules of the snapshot.");
+
+  if (LS_FAILED(static_assets_load(_FrontendDirectory)))
+    print_error_line("Failed to load the frontend from '", _FrontendDirectory, "'. Only the API will be served.");
 
   //user poepe;
   //lsCopyString(poepe.username, "poepe");
@@ -90,39 +175,64 @@ int32_t main(void)
   //
   //add_new_user(poepe);
 
-  crow::App<crow::CORSHandler> app;
+  // Rejected requests still pass the CORS middleware on their way out, so browsers can read the `429`.
+  crow::App<crow::CORSHandler, admission_middleware, response_compression_middleware> app;
 
   auto &cors = app.get_middleware<crow::CORSHandler>();
 #ifndef SCHEDD_LOCALHOST
   cors.global().origin(SCHEDD_HOSTNAME);
 #else
-  cors.global().origin("*");
+  cors.global().origin("http://localhost:61919"); // local builds only serve the local frontend, not any site the browser happens to be on.
 #endif
 
+  CROW_ROUTE(app, "/")([](const crow::request &req) { return handle_static_asset(req, StaticAssetIndexPath); });
+  CROW_ROUTE(app, "/assets/<path>")([](const crow::request &req, const std::string &path) { return handle_static_asset(req, ("assets/" + path).c_str()); });
   CROW_ROUTE(app, "/login").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_login(req); });
   CROW_ROUTE(app, "/logout").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_logout(req); });
   CROW_ROUTE(app, "/registration").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_user_registration(req); });
-  CROW_ROUTE(app, "/user-time-info").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_user_time_info(req); });
+  CROW_ROUTE(app, "/user-time-info").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_with_session(req, handle_user_time_info); });
   CROW_ROUTE(app, "/user-edit").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_user_edit(req); });
   CROW_ROUTE(app, "/task-creation").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_task_creation_modification(req, true); });
   CROW_ROUTE(app, "/task-edit").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_task_creation_modification(req, false); });
-  CROW_ROUTE(app, "/user-schedule").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_user_schedule(req); });
-  CROW_ROUTE(app, "/task-search").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_event_search(req); });
-  CROW_ROUTE(app, "/user-search").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_user_search(req); });
+  CROW_ROUTE(app, "/user-schedule").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_with_session(req, handle_user_schedule); });
+  CROW_ROUTE(app, "/task-search").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_with_session(req, handle_event_search); });
+  CROW_ROUTE(app, "/user-search").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_with_session(req, handle_user_search); });
   CROW_ROUTE(app, "/task-done").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_event_completed(req, false); });
   CROW_ROUTE(app, "/task-done-reschedule").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_event_completed(req, true); });
-  CROW_ROUTE(app, "/task").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_task_details(req); });
+  CROW_ROUTE(app, "/batch").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_batch(req); });
+  CROW_ROUTE(app, "/task").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_with_session(req, handle_task_details); });
+
+  CROW_WEBSOCKET_ROUTE(app, "/schedule-updates")
+    .max_payload(ScheduleUpdatesMaxRequestBytes)
+    .onaccept([](const crow::request &, void **ppUserData) { *ppUserData = nullptr; return true; })
+    .onmessage([](crow::websocket::connection &connection, const std::string &message, bool isBinary) { handle_schedule_updates_message(connection, message, isBinary); })
+    .onclose([](crow::websocket::connection &connection, const std::string &) { handle_schedule_updates_close(connection); });
 
-  pAsyncTasksThread = new std::thread(async_tasks);
+  if (LS_FAILED(push_start()))
+    print_error_line("Failed to start the push thread. Schedule updates will not be pushed.");
+
+  pAsyncTasksThread = new std::thread(async_tasks, schedulesAreCurrent);
 
   app.port(61919).multithreaded().run();
 
   _IsRunning = false;
+
+  push_stop();
+
+  pAsyncTasksThread->join();
+  delete pAsyncTasksThread;
+  pAsyncTasksThread = nullptr;
+
+  // Leaves an empty journal & the current schedules behind, so the next start can skip rescheduling.
+  write_checkpoint();
+
+  writer_stop();
+  journal_close();
 }
 
 //////////////////////////////////////////////////////////////////////////
 
-void async_tasks()
+void async_tasks(const bool schedulesAreCurrent)
 {
   constexpr size_t WaitTimeSeconds = 20;
 
@@ -130,7 +240,8 @@ void async_tasks()
   size_t eventChangingStatusBefore = 0;
   size_t explicitlyRequestedRescheduleBefore = 0;
   size_t dayBefore = get_days_since_new_year();
-  bool firstRun = true;
+  size_t secondsSinceCheckpoint = 0;
+  bool firstRun = !schedulesAreCurrent;
 
   while (true)
   {
@@ -159,34 +270,30 @@ void async_tasks()
       clearCompletedTasks();
     }
 
-    // If Changed: Serialize. Reschedule.
-    if (userChangingStatusBefore < userChangingStatusCurrent)
-    {      
-      // Serialize _Users pool
-      writeUsersPoolToFile();
-      
+    // If Changed: Reschedule. The changes themselves have already been journaled.
+    if (userChangingStatusBefore < userChangingStatusCurrent || eventChangingStatusBefore < eventChangingStatusCurrent)
       needsReschedule = true;
-    }
-    
-    if (eventChangingStatusBefore < eventChangingStatusCurrent)
+
+    // Compact the journal once it grew large or has been around for a while.
+    secondsSinceCheckpoint += WaitTimeSeconds;
+
     {
-      // Serialize _Events pool
-      writeEventsPoolToFile();
-    
-      needsReschedule = true;
+      const size_t journalSize = journal_get_size();
+
+      if (journalSize >= CheckpointJournalSize || (journalSize > 0 && secondsSinceCheckpoint >= CheckpointIntervalSeconds))
+      {
+        write_checkpoint();
+        secondsSinceCheckpoint = 0;
+      }
     }
-    
+
     if (needsReschedule || firstRun)
     {
       // Reschedule
       {
         std::scoped_lock lock(_ThreadLock);
 
-        for (const auto &&_item : _Users)
-        {
-          if (LS_FAILED(reschedule_events_for_user(_item.index)))
-            print_error_line("Failed to reschedule events for userId: ", _item.index);
-        }
+        reschedule_all_users(currentDay);
       }
     }
 
@@ -198,6 +305,16 @@ void async_tasks()
   }
 }
   
+void write_checkpoint()
+{
+  if (LS_FAILED(journal_checkpoint(_FileNameSnapshot)))
+    print_error_line("Failed to write checkpoint.");
+
+  // JSON remains the export format.
+  writeUsersPoolToFile();
+  writeEventsPoolToFile();
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 const char *_Index = "index";
@@ -220,212 +337,928 @@ const char *_FileNameEvents = "eventspool.json";
 
 //////////////////////////////////////////////////////////////////////////
 
+lsResult write_user_to_json(json_writer *pWriter, const size_t index, const user &usr)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(json_writer_begin_object(pWriter));
+
+  LS_ERROR_CHECK(json_writer_key(pWriter, _Index));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, index));
+  LS_ERROR_CHECK(json_writer_key(pWriter, _Username));
+  LS_ERROR_CHECK(json_writer_string(pWriter, arena_string_get(usr.username), arena_string_length(usr.username)));
+
+  LS_ERROR_CHECK(json_writer_key(pWriter, _AvailableTimePerDay));
+  LS_ERROR_CHECK(json_writer_begin_array(pWriter));
+
+  for (const time_span_t availableTime : usr.availableTimePerDay)
+    LS_ERROR_CHECK(json_writer_int(pWriter, availableTime));
+
+  LS_ERROR_CHECK(json_writer_end_array(pWriter));
+
+  LS_ERROR_CHECK(json_writer_key(pWriter, _CompletedTasks));
+  LS_ERROR_CHECK(json_writer_begin_array(pWriter));
+
+  for (const size_t eventId : usr.completedTasksForCurrentDay)
+    LS_ERROR_CHECK(json_writer_uint(pWriter, eventId));
+
+  LS_ERROR_CHECK(json_writer_end_array(pWriter));
+
+  LS_ERROR_CHECK(json_writer_end_object(pWriter));
+
+epilogue:
+  return result;
+}
+
+lsResult write_event_to_json(json_writer *pWriter, const size_t index, const event &evnt)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(json_writer_begin_object(pWriter));
+
+  LS_ERROR_CHECK(json_writer_key(pWriter, _Index));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, index));
+  LS_ERROR_CHECK(json_writer_key(pWriter, _Name));
+  LS_ERROR_CHECK(json_writer_string(pWriter, arena_string_get(evnt.name), arena_string_length(evnt.name)));
+  LS_ERROR_CHECK(json_writer_key(pWriter, _DurationTimeSpan));
+  LS_ERROR_CHECK(json_writer_int(pWriter, evnt.durationTimeSpan));
+
+  LS_ERROR_CHECK(json_writer_key(pWriter, _UserIds));
+  LS_ERROR_CHECK(json_writer_begin_array(pWriter));
+
+  for (const size_t userId : evnt.userIds)
+    LS_ERROR_CHECK(json_writer_uint(pWriter, userId));
+
+  LS_ERROR_CHECK(json_writer_end_array(pWriter));
+
+  LS_ERROR_CHECK(json_writer_key(pWriter, _Weight));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, evnt.weight));
+  LS_ERROR_CHECK(json_writer_key(pWriter, _WeightFactor));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, evnt.weightGrowthFactor));
+  LS_ERROR_CHECK(json_writer_key(pWriter, _PossibleExecutionDays));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, evnt.possibleExecutionDays));
+  LS_ERROR_CHECK(json_writer_key(pWriter, _RepetitionTimeSpan));
+  LS_ERROR_CHECK(json_writer_int(pWriter, evnt.repetitionTimeSpan));
+  LS_ERROR_CHECK(json_writer_key(pWriter, _LastCompletedTime));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, evnt.lastCompletedTime));
+  LS_ERROR_CHECK(json_writer_key(pWriter, _LastModifiedTime));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, evnt.lastModifiedTime));
+  LS_ERROR_CHECK(json_writer_key(pWriter, _CreationTime));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, evnt.creationTime));
+
+  LS_ERROR_CHECK(json_writer_end_object(pWriter));
+
+epilogue:
+  return result;
+}
+
+// Encodes the pool into an owned buffer & hands it to the writer thread, which replaces `filename` atomically.
+// The mutex is only held while one pool block is encoded, so the export is consistent per item, not across the whole pool.
+template <typename T, typename TWriteFunc>
+lsResult write_pool_to_json_file(const char *filename, pool<T> *pPool, TWriteFunc writeItem)
+{
+  lsResult result = lsR_Success;
+
+  constexpr size_t PoolBlockSize = sizeof(uint64_t) * CHAR_BIT;
+
+  json_writer writer;
+  uint8_t *pImage = nullptr;
+  size_t blockIndex = 0;
+
+  LS_ERROR_CHECK(json_writer_create(&writer, nullptr)); // Without a flush function the buffer grows & holds the whole document.
+  LS_ERROR_CHECK(json_writer_begin_array(&writer));
+
+  while (true)
+  {
+    // Scope Lock
+    {
+      std::scoped_lock lock(_ThreadLock);
+
+      if (blockIndex >= pPool->blockCount)
+        break;
+
+      for (uint64_t mask = pPool->pBlockEmptyMask[blockIndex]; mask != 0; mask &= mask - 1)
+      {
+        const size_t index = blockIndex * PoolBlockSize + lsLowestBit(mask);
+        LS_ERROR_CHECK(writeItem(&writer, index, *pool_get(pPool, index)));
+      }
+    }
+
+    blockIndex++;
+  }
+
+  LS_ERROR_CHECK(json_writer_end_array(&writer));
+
+  pImage = reinterpret_cast<uint8_t *>(writer.pBuffer);
+  writer.pBuffer = nullptr;
+
+  LS_ERROR_CHECK(writer_enqueue(filename, &pImage, writer.size));
+
+epilogue:
+  lsFreePtr(&pImage);
+  json_writer_destroy(&writer);
+
+  return result;
+}
+
 void writeUsersPoolToFile()
 {
-  std::string stringOut;
+  if (LS_FAILED(write_pool_to_json_file(_FileNameUsers, &_Users, write_user_to_json)))
+    print_error_line("Failed to write users pool to '", _FileNameUsers, "'.");
+}
+
+void writeEventsPoolToFile()
+{
+  if (LS_FAILED(write_pool_to_json_file(_FileNameEvents, &_Events, write_event_to_json)))
+    print_error_line("Failed to write events pool to '", _FileNameEvents, "'.");
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template <typename TList>
+lsResult read_json_int_list(json_reader *pReader, _Out_ TList *pList)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(json_reader_begin_array(pReader));
 
-  // Mutex Lock
+  while (true)
   {
-    std::scoped_lock lock(_ThreadLock);
-    int idx = 0;
-    crow::json::wvalue jsonOut;
+    bool hasElement;
+    int64_t value;
+
+    LS_ERROR_CHECK(json_reader_next_element(pReader, &hasElement));
+
+    if (!hasElement)
+      break;
 
-    for (const auto &&_item : _Users)
+    LS_ERROR_CHECK(json_reader_int(pReader, &value));
+    LS_ERROR_CHECK(list_add(pList, (time_span_t)value));
+  }
+
+epilogue:
+  return result;
+}
+
+template <typename TList>
+lsResult read_json_id_list(json_reader *pReader, _Out_ TList *pList)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(json_reader_begin_array(pReader));
+
+  while (true)
+  {
+    bool hasElement;
+    uint64_t value;
+
+    LS_ERROR_CHECK(json_reader_next_element(pReader, &hasElement));
+
+    if (!hasElement)
+      break;
+
+    LS_ERROR_CHECK(json_reader_uint(pReader, &value));
+    LS_ERROR_CHECK(list_add(pList, (size_t)value));
+  }
+
+epilogue:
+  return result;
+}
+
+lsResult read_user_from_json(json_reader *pReader, _Out_ size_t *pIndex, _Out_ user *pUser)
+{
+  lsResult result = lsR_Success;
+
+  bool hasIndex = false;
+  size_t nameLength = 0;
+
+  LS_ERROR_CHECK(json_reader_begin_object(pReader));
+
+  while (true)
+  {
+    bool hasMember;
+    json_reader_key key;
+
+    LS_ERROR_CHECK(json_reader_next_member(pReader, &hasMember, &key));
+
+    if (!hasMember)
+      break;
+
+    if (json_reader_key_equals(key, _Index))
+    {
+      uint64_t index;
+      LS_ERROR_CHECK(json_reader_uint(pReader, &index));
+
+      *pIndex = (size_t)index;
+      hasIndex = true;
+    }
+    else if (json_reader_key_equals(key, _Username))
+    {
+      char name[MaxNameLength + 1];
+
+      LS_ERROR_CHECK(json_reader_string(pReader, name, LS_ARRAYSIZE(name), &nameLength));
+      LS_ERROR_CHECK(arena_string_set(&pUser->username, name, nameLength));
+    }
+    else if (json_reader_key_equals(key, _AvailableTimePerDay))
+    {
+      LS_ERROR_CHECK(read_json_int_list(pReader, &pUser->availableTimePerDay));
+    }
+    else if (json_reader_key_equals(key, _CompletedTasks))
+    {
+      LS_ERROR_CHECK(read_json_id_list(pReader, &pUser->completedTasksForCurrentDay));
+    }
+    else
     {
-      crow::json::wvalue element;
+      LS_ERROR_CHECK(json_reader_skip(pReader));
+    }
+  }
+
+  LS_ERROR_IF(!hasIndex || nameLength == 0, lsR_ResourceInvalid);
+
+epilogue:
+  return result;
+}
+
+lsResult read_event_from_json(json_reader *pReader, _Out_ size_t *pIndex, _Out_ event *pEvent)
+{
+  lsResult result = lsR_Success;
+
+  bool hasIndex = false;
+  size_t nameLength = 0;
+
+  LS_ERROR_CHECK(json_reader_begin_object(pReader));
+
+  while (true)
+  {
+    bool hasMember;
+    json_reader_key key;
+    int64_t signedValue;
+    uint64_t unsignedValue;
+
+    LS_ERROR_CHECK(json_reader_next_member(pReader, &hasMember, &key));
 
-      element[_Index] = _item.index;
-      element[_Username] = _item.pItem->username;
+    if (!hasMember)
+      break;
 
-      for (size_t i = 0; i < _item.pItem->availableTimePerDay.count; i++)
-        element[_AvailableTimePerDay][(uint32_t)i] = _item.pItem->availableTimePerDay[i];
+    if (json_reader_key_equals(key, _Index))
+    {
+      LS_ERROR_CHECK(json_reader_uint(pReader, &unsignedValue));
+
+      *pIndex = (size_t)unsignedValue;
+      hasIndex = true;
+    }
+    else if (json_reader_key_equals(key, _Name))
+    {
+      char name[MaxNameLength + 1];
 
-      for (size_t i = 0; i < _item.pItem->completedTasksForCurrentDay.count; i++)
-        element[_CompletedTasks][(uint32_t)i] = _item.pItem->completedTasksForCurrentDay[i];
+      LS_ERROR_CHECK(json_reader_string(pReader, name, LS_ARRAYSIZE(name), &nameLength));
+      LS_ERROR_CHECK(arena_string_set(&pEvent->name, name, nameLength));
+    }
+    else if (json_reader_key_equals(key, _DurationTimeSpan))
+    {
+      LS_ERROR_CHECK(json_reader_int(pReader, &signedValue));
+      pEvent->durationTimeSpan = signedValue;
+    }
+    else if (json_reader_key_equals(key, _UserIds))
+    {
+      LS_ERROR_CHECK(read_json_id_list(pReader, &pEvent->userIds));
+    }
+    else if (json_reader_key_equals(key, _Weight))
+    {
+      LS_ERROR_CHECK(json_reader_uint(pReader, &pEvent->weight));
+    }
+    else if (json_reader_key_equals(key, _WeightFactor))
+    {
+      LS_ERROR_CHECK(json_reader_uint(pReader, &pEvent->weightGrowthFactor));
+    }
+    else if (json_reader_key_equals(key, _PossibleExecutionDays))
+    {
+      LS_ERROR_CHECK(json_reader_uint(pReader, &unsignedValue));
+      LS_ERROR_IF(unsignedValue > wF_All, lsR_ResourceInvalid);
 
-      jsonOut[idx] = std::move(element);
-      idx++;
+      pEvent->possibleExecutionDays = (weekday_flags)unsignedValue;
+    }
+    else if (json_reader_key_equals(key, _RepetitionTimeSpan))
+    {
+      LS_ERROR_CHECK(json_reader_int(pReader, &signedValue));
+      pEvent->repetitionTimeSpan = signedValue;
+    }
+    else if (json_reader_key_equals(key, _LastCompletedTime))
+    {
+      LS_ERROR_CHECK(json_reader_uint(pReader, &pEvent->lastCompletedTime));
+    }
+    else if (json_reader_key_equals(key, _LastModifiedTime))
+    {
+      LS_ERROR_CHECK(json_reader_uint(pReader, &pEvent->lastModifiedTime));
+    }
+    else if (json_reader_key_equals(key, _CreationTime))
+    {
+      LS_ERROR_CHECK(json_reader_uint(pReader, &pEvent->creationTime));
+    }
+    else
+    {
+      LS_ERROR_CHECK(json_reader_skip(pReader));
     }
-    
-    stringOut = jsonOut.dump();
   }
 
-  if (stringOut == "null")
-    print_error_line("Failed to write users pool to file. File content is 'null'.");
+  LS_ERROR_IF(!hasIndex || nameLength == 0, lsR_ResourceInvalid);
 
-  lsWriteFile(_FileNameUsers, stringOut.c_str(), stringOut.size());
-  if (LS_FAILED(lsWriteFile("userspool.json", stringOut.c_str(), stringOut.size())))
-    print_error_line("Failed to write users pool to file."); 
+epilogue:
+  return result;
 }
 
-void writeEventsPoolToFile()
+// Parses the mapped file in a single pass, straight into the pool. Leaves the pool empty on failure.
+template <typename T, typename TReadFunc>
+lsResult read_pool_from_json_file(const char *filename, pool<T> *pPool, TReadFunc readItem)
+{
+  lsResult result = lsR_Success;
+
+  mapped_file file;
+  json_reader reader;
+
+  LS_ERROR_CHECK(lsMapFile(filename, &file));
+  LS_ERROR_CHECK(json_reader_create(&reader, reinterpret_cast<const char *>(file.pData), file.size));
+  LS_ERROR_CHECK(json_reader_begin_array(&reader));
+
+  while (true)
+  {
+    bool hasElement;
+
+    LS_ERROR_CHECK(json_reader_next_element(&reader, &hasElement));
+
+    if (!hasElement)
+      break;
+
+    T item;
+    size_t index = 0;
+
+    LS_ERROR_CHECK(readItem(&reader, &index, &item));
+    LS_ERROR_CHECK(pool_insertAt(pPool, std::move(item), index));
+  }
+
+  LS_ERROR_CHECK(json_reader_end(&reader));
+
+epilogue:
+  lsUnmapFile(&file);
+
+  if (LS_FAILED(result))
+    pool_clear(pPool);
+
+  return result;
+}
+
+void deserializeUsersPool()
 {
-  std::string outString;
+  if (LS_FAILED(read_pool_from_json_file(_FileNameUsers, &_Users, read_user_from_json)))
+    print_error_line("Failed to read users pool from '", _FileNameUsers, "'.");
+}
+
+void deserialzieEventsPool()
+{
+  if (LS_FAILED(read_pool_from_json_file(_FileNameEvents, &_Events, read_event_from_json)))
+    print_error_line("Failed to read events pool from '", _FileNameEvents, "'.");
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// The small endpoints only read fields out of this set, so their bodies are decoded by one pass of `json_reader` instead of a `crow::json` tree & a lookup per key.
+// Unknown keys are skipped. Ids are also accepted as strings of digits, as the frontend keeps the session token as a string.
+constexpr size_t RequestMaxTagLength = 64;
+constexpr size_t RequestMaxPathLength = 32;
+
+struct request_fields
+{
+  uint32_t sessionId;
+  uint64_t taskId;
+  char query[MaxNameLength + 1];
+  char username[MaxNameLength + 1];
+  char etag[RequestMaxTagLength + 1];
+  bool hasSessionId = false;
+  bool hasTaskId = false;
+  bool hasQuery = false;
+  bool hasUsername = false;
+  bool hasEtag = false;
+};
+
+lsResult read_request_id(json_reader *pReader, _Out_ uint64_t *pValue)
+{
+  lsResult result = lsR_Success;
+
+  json_value_type type;
+  LS_ERROR_CHECK(json_reader_peek(pReader, &type));
 
-  // Mutex Lock
+  if (type == jvt_String)
   {
-    crow::json::wvalue jsonOut;
-    std::scoped_lock lock(_ThreadLock);
-    int idx = 0;
+    char digits[20 + 1]; // `UINT64_MAX` has 20.
+    size_t length;
+
+    LS_ERROR_CHECK(json_reader_string(pReader, digits, LS_ARRAYSIZE(digits), &length));
+    LS_ERROR_IF(length == 0 || length >= LS_ARRAYSIZE(digits) - 1, lsR_ResourceInvalid);
+
+    for (size_t i = 0; i < length; i++)
+      LS_ERROR_IF(digits[i] < '0' || digits[i] > '9', lsR_ResourceInvalid);
+
+    *pValue = lsParseUInt(digits);
+  }
+  else
+  {
+    LS_ERROR_CHECK(json_reader_uint(pReader, pValue));
+  }
+
+epilogue:
+  return result;
+}
+
+lsResult read_request_string(json_reader *pReader, _Out_ char *buffer, const size_t capacity, _Out_ bool *pHasValue)
+{
+  lsResult result = lsR_Success;
 
-    for (const auto &&_item : _Events)
+  size_t length;
+  LS_ERROR_CHECK(json_reader_string(pReader, buffer, capacity, &length));
+
+  *pHasValue = true;
+
+epilogue:
+  return result;
+}
+
+lsResult read_request_fields(json_reader *pReader, _Out_ request_fields *pFields) // Reads one object.
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pFields == nullptr, lsR_ArgumentNull);
+  *pFields = request_fields();
+
+  LS_ERROR_CHECK(json_reader_begin_object(pReader));
+
+  while (true)
+  {
+    bool hasMember;
+    json_reader_key key;
+
+    LS_ERROR_CHECK(json_reader_next_member(pReader, &hasMember, &key));
+
+    if (!hasMember)
+      break;
+
+    if (json_reader_key_equals(key, "sessionId"))
+    {
+      uint64_t sessionId;
+      LS_ERROR_CHECK(read_request_id(pReader, &sessionId));
+      LS_ERROR_IF(sessionId > UINT32_MAX, lsR_ArgumentOutOfBounds);
+
+      pFields->sessionId = (uint32_t)sessionId;
+      pFields->hasSessionId = true;
+    }
+    else if (json_reader_key_equals(key, "taskId"))
+    {
+      LS_ERROR_CHECK(read_request_id(pReader, &pFields->taskId));
+      pFields->hasTaskId = true;
+    }
+    else if (json_reader_key_equals(key, "query"))
+    {
+      LS_ERROR_CHECK(read_request_string(pReader, pFields->query, LS_ARRAYSIZE(pFields->query), &pFields->hasQuery));
+    }
+    else if (json_reader_key_equals(key, "username"))
     {
-      crow::json::wvalue element;
+      LS_ERROR_CHECK(read_request_string(pReader, pFields->username, LS_ARRAYSIZE(pFields->username), &pFields->hasUsername));
+    }
+    else if (json_reader_key_equals(key, "etag"))
+    {
+      LS_ERROR_CHECK(read_request_string(pReader, pFields->etag, LS_ARRAYSIZE(pFields->etag), &pFields->hasEtag));
+    }
+    else
+    {
+      LS_ERROR_CHECK(json_reader_skip(pReader));
+    }
+  }
+
+epilogue:
+  return result;
+}
+
+lsResult decode_request_fields(const std::string &body, _Out_ request_fields *pFields)
+{
+  lsResult result = lsR_Success;
+
+  json_reader reader;
+  LS_ERROR_CHECK(json_reader_create(&reader, body.data(), body.size()));
+  LS_ERROR_CHECK(read_request_fields(&reader, pFields));
+  LS_ERROR_CHECK(json_reader_end(&reader));
+
+epilogue:
+  return result;
+}
+
+// Only reads up to `sessionId`, for admitting the request before its handler decodes the whole body.
+lsResult decode_request_session_id(const std::string &body, _Out_ bool *pHasSessionId, _Out_ uint32_t *pSessionId)
+{
+  lsResult result = lsR_Success;
+
+  json_reader reader;
+
+  *pHasSessionId = false;
+
+  LS_ERROR_CHECK(json_reader_create(&reader, body.data(), body.size()));
+  LS_ERROR_CHECK(json_reader_begin_object(&reader));
+
+  while (true)
+  {
+    bool hasMember;
+    json_reader_key key;
+
+    LS_ERROR_CHECK(json_reader_next_member(&reader, &hasMember, &key));
+
+    if (!hasMember)
+      break;
+
+    if (json_reader_key_equals(key, "sessionId"))
+    {
+      uint64_t sessionId;
+      LS_ERROR_CHECK(read_request_id(&reader, &sessionId));
+      LS_ERROR_IF(sessionId > UINT32_MAX, lsR_ArgumentOutOfBounds);
+
+      *pSessionId = (uint32_t)sessionId;
+      *pHasSessionId = true;
+      break; // the remaining members are validated by the handler.
+    }
+
+    LS_ERROR_CHECK(json_reader_skip(&reader));
+  }
+
+epilogue:
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Conditional requests: responses carry a strong `ETag`, clients send it back to get a `304` without a body.
+// As every endpoint takes a POST, the tag is accepted in the `If-None-Match` header or as `"etag"` in the request body.
+constexpr size_t ETagLength = 2 + 16; // quoted 64 bit hex.
+
+void format_etag(const uint64_t value, _Out_ char (&etag)[ETagLength + 1])
+{
+  constexpr char HexDigits[] = "0123456789abcdef";
+
+  etag[0] = '"';
+
+  for (size_t i = 0; i < 16; i++)
+    etag[1 + i] = HexDigits[(value >> ((15 - i) * 4)) & 0xF];
+
+  etag[ETagLength - 1] = '"';
+  etag[ETagLength] = '\0';
+}
+
+bool etag_matches(const crow::request &req, const request_fields &fields, const char *etag)
+{
+  // The frontend echoes the header, which is weak if the response was compressed.
+  if (fields.hasEtag && strcmp(strncmp(fields.etag, "W/", 2) == 0 ? fields.etag + 2 : fields.etag, etag) == 0)
+    return true;
+
+  const std::string &ifNoneMatch = req.get_header_value("If-None-Match");
+  size_t start = 0;
+
+  // Comma separated list of tags, the weak prefix doesn't matter for `If-None-Match`.
+  while (start < ifNoneMatch.size())
+  {
+    size_t end = ifNoneMatch.find(',', start);
+
+    if (end == std::string::npos)
+      end = ifNoneMatch.size();
+
+    size_t first = start;
+    size_t last = end;
+
+    while (first < last && isspace((uint8_t)ifNoneMatch[first]))
+      first++;
 
-      element[_Index] = _item.index;
-      element[_Name] = _item.pItem->name;
-      element[_DurationTimeSpan] = _item.pItem->durationTimeSpan;
+    while (last > first && isspace((uint8_t)ifNoneMatch[last - 1]))
+      last--;
 
-      for (size_t i = 0; i < _item.pItem->userIds.count; i++)
-        element[_UserIds][(uint32_t)i] = _item.pItem->userIds[i];
+    if (last - first >= 2 && ifNoneMatch.compare(first, 2, "W/") == 0)
+      first += 2;
+
+    if ((last - first == 1 && ifNoneMatch[first] == '*') || ifNoneMatch.compare(first, last - first, etag) == 0)
+      return true;
+
+    start = end + 1;
+  }
+
+  return false;
+}
+
+void set_etag_header(crow::response *pResponse, const char *etag)
+{
+  pResponse->set_header("ETag", etag);
+  pResponse->set_header("Access-Control-Expose-Headers", "ETag"); // not readable cross-origin otherwise.
+}
+
+crow::response not_modified_response(const char *etag)
+{
+  crow::response response(crow::status::NOT_MODIFIED);
+  set_etag_header(&response, etag);
+
+  return response;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Versioned URLs (`?v=<etag>`, as referenced by the served HTML) never change their content, everything else is revalidated through its ETag.
+constexpr char StaticAssetImmutableCacheControl[] = "public, max-age=31536000, immutable";
+constexpr char StaticAssetRevalidateCacheControl[] = "no-cache";
+
+crow::response handle_static_asset(const crow::request &req, const char *path)
+{
+  const static_asset *pAsset = static_assets_find(path);
+
+  if (pAsset == nullptr)
+    return crow::response(crow::status::NOT_FOUND);
+
+  char version[ETagLength + 1];
+  format_etag(pAsset->etag, version);
+
+  const char *requestedVersion = req.url_params.get("v");
+  const bool isVersioned = requestedVersion != nullptr && strlen(requestedVersion) == ETagLength - 2 && strncmp(requestedVersion, version + 1, ETagLength - 2) == 0;
+  const char *cacheControl = isVersioned ? StaticAssetImmutableCacheControl : StaticAssetRevalidateCacheControl;
+
+  // Each representation has its own strong tag, so caches never mix up the compressed & the uncompressed body.
+  const bool isGzip = pAsset->pGzipBody != nullptr && response_encoding_negotiate(req.get_header_value("Accept-Encoding").c_str()) == re_Gzip;
+
+  char etag[ETagLength + 1];
+  format_etag(isGzip ? pAsset->gzipEtag : pAsset->etag, etag);
+
+  const request_fields noFields = {}; // only the `If-None-Match` header applies to GETs.
+
+  if (etag_matches(req, noFields, etag))
+  {
+    crow::response response = not_modified_response(etag);
+    response.set_header("Cache-Control", cacheControl);
+
+    if (pAsset->pGzipBody != nullptr)
+      response.set_header("Vary", "Accept-Encoding");
+
+    return response;
+  }
+
+  crow::response response;
+
+  if (isGzip)
+  {
+    response.body.assign(reinterpret_cast<const char *>(pAsset->pGzipBody), pAsset->gzipBodySize);
+    response.set_header("Content-Encoding", response_encoding_name(re_Gzip));
+  }
+  else
+  {
+    response.body.assign(reinterpret_cast<const char *>(pAsset->pBody), pAsset->bodySize);
+  }
+
+  if (pAsset->pGzipBody != nullptr)
+    response.set_header("Vary", "Accept-Encoding");
+
+  response.set_header("Content-Type", pAsset->contentType);
+  response.set_header("Cache-Control", cacheControl);
+  set_etag_header(&response, etag);
+
+  return response;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Responses are written with a per-thread `json_writer` without a flush function: its buffer grows to the largest response on that thread & is reused for every later one.
+// `crow::response` owns its body as a `std::string`, so one exactly sized copy per response remains, instead of a `wvalue` tree & its serialization.
+// Don't nest: handlers calling other handlers (like `/batch`) must finish with the writer before they do.
+constexpr size_t ResponseWriterInitialCapacity = 4 * 1024;
+
+struct response_writer
+{
+  json_writer writer;
+  bool isCreated = false;
+
+  ~response_writer()
+  {
+    json_writer_destroy(&writer);
+  }
+};
+
+static thread_local response_writer _ResponseWriter;
+
+json_writer *response_writer_begin() // `nullptr` if the buffer couldn't be allocated.
+{
+  if (!_ResponseWriter.isCreated)
+  {
+    if (LS_FAILED(json_writer_create(&_ResponseWriter.writer, nullptr, ResponseWriterInitialCapacity)))
+      return nullptr;
+
+    _ResponseWriter.isCreated = true;
+  }
+
+  json_writer_reset(&_ResponseWriter.writer);
+
+  return &_ResponseWriter.writer;
+}
+
+crow::response response_writer_finish(json_writer *pWriter)
+{
+  if (pWriter->depth != 0 || pWriter->afterKey)
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
+
+  crow::response response(crow::status::OK, std::string(pWriter->pBuffer, pWriter->size));
+  response.set_header("Content-Type", "application/json");
+
+  return response;
+}
+
+crow::response success_response()
+{
+  crow::response response(crow::status::OK, "{\"success\":true}");
+  response.set_header("Content-Type", "application/json");
+
+  return response;
+}
+
+crow::response session_id_response(const uint32_t sessionId)
+{
+  json_writer *pWriter = response_writer_begin();
+
+  if (pWriter == nullptr
+    || LS_FAILED(json_writer_begin_object(pWriter))
+    || LS_FAILED(json_writer_key(pWriter, "session_id"))
+    || LS_FAILED(json_writer_uint(pWriter, sessionId))
+    || LS_FAILED(json_writer_end_object(pWriter)))
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
+
+  return response_writer_finish(pWriter);
+}
+
+void response_compression_middleware::after_handle(crow::request &req, crow::response &res, context &)
+{
+  if (res.body.size() < ResponseCompressionMinBytes || !res.get_header_value("Content-Encoding").empty())
+    return;
+
+  res.set_header("Vary", "Accept-Encoding");
+
+  const response_encoding encoding = response_encoding_negotiate(req.get_header_value("Accept-Encoding").c_str());
+
+  if (encoding == re_Identity)
+    return;
+
+  std::string compressed;
+
+  if (LS_FAILED(response_compress(encoding, res.body.data(), res.body.size(), &compressed)))
+    return; // sent as it is.
+
+  res.body = std::move(compressed);
+  res.set_header("Content-Encoding", response_encoding_name(encoding));
+
+  // Strong tags are per representation & the handler tagged the uncompressed one. Both are semantically equivalent, which is what a weak tag states.
+  const std::string &etag = res.get_header_value("ETag");
+
+  if (!etag.empty() && etag.compare(0, 2, "W/") != 0)
+    res.set_header("ETag", "W/" + etag);
+}
+
+lsResult write_event_info(json_writer *pWriter, const event_info &info)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(json_writer_begin_object(pWriter));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "name"));
+  LS_ERROR_CHECK(json_writer_string(pWriter, info.name, info.nameLength));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "duration"));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, info.durationInMinutes));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "id"));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, info.id));
+  LS_ERROR_CHECK(json_writer_end_object(pWriter));
+
+epilogue:
+  return result;
+}
+
+lsResult write_user_info(json_writer *pWriter, const user_info &info)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(json_writer_begin_object(pWriter));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "name"));
+  LS_ERROR_CHECK(json_writer_string(pWriter, info.name, info.nameLength));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "id"));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, info.id));
+  LS_ERROR_CHECK(json_writer_end_object(pWriter));
+
+epilogue:
+  return result;
+}
 
-      element[_Weight] = _item.pItem->weight;
-      element[_WeightFactor] = _item.pItem->weightGrowthFactor;
-      element[_PossibleExecutionDays] = _item.pItem->possibleExecutionDays;
-      element[_RepetitionTimeSpan] = _item.pItem->repetitionTimeSpan;
-      element[_LastCompletedTime] = _item.pItem->lastCompletedTime;
-      element[_LastModifiedTime] = _item.pItem->lastModifiedTime;
-      element[_CreationTime] = _item.pItem->creationTime;
+//////////////////////////////////////////////////////////////////////////
 
-      jsonOut[idx] = std::move(element);
-      idx++;
-    }
+// Decodes the body & resolves the session for handlers that only read, so `/batch` can call them with fields it has already decoded & a session it has already resolved.
+crow::response handle_with_session(const crow::request &req, const session_handler handler)
+{
+  request_fields fields;
 
-    outString = jsonOut.dump();
-  }
+  if (LS_FAILED(decode_request_fields(req.body, &fields)) || !fields.hasSessionId)
+    return crow::response(crow::status::BAD_REQUEST);
 
-  if (outString == "null")
-    print_error_line("Failed to write events pool to file. File content is 'null'.");
+  size_t userId;
+  if (LS_FAILED(get_user_id_from_session_id(fields.sessionId, &userId)))
+    return crow::response(crow::status::FORBIDDEN);
 
-  lsWriteFile(_FileNameEvents, outString.c_str(), outString.size());
-  if (LS_FAILED(lsWriteFile("eventspool.json", outString.c_str(), outString.size())))
-    print_error_line("Failed to write events pool to file.");
+  return handler(req, fields, userId);
 }
-  
+
 //////////////////////////////////////////////////////////////////////////
 
-void deserializeUsersPool()
+constexpr const char *AdmissionExpensiveUrls[] = { "/task-search", "/user-search", "/registration" };
+
+admission_class get_admission_class(const char *url)
 {
-  char *fileContents = nullptr;
-  size_t fileSize;
+  for (const char *expensiveUrl : AdmissionExpensiveUrls)
+    if (strcmp(url, expensiveUrl) == 0)
+      return ac_Expensive;
 
-  if (LS_FAILED(lsReadFile(_FileNameUsers, &fileContents, &fileSize)))
-  {
-    print_error_line("Failed to read file", _FileNameUsers);
-    return;
-  }
+  return ac_Regular;
+}
 
-  const auto &jsonRoot = crow::json::load(fileContents);
+void get_client_address(const crow::request &req, _Out_ char (&address)[AdmissionMaxAddressLength + 1])
+{
+  admission_resolve_client_address(req.remote_ip_address.c_str(), req.get_header_value("X-Forwarded-For").c_str(), req.get_header_value("Forwarded").c_str(), address);
+}
 
-  for (const auto &_item : jsonRoot)
-  {
-    size_t index = _item[_Index].i();
-    user usr;
+crow::response too_many_requests_response(const size_t retryAfterSeconds)
+{
+  crow::response response(crow::status::TOO_MANY_REQUESTS);
+  response.set_header("Retry-After", std::to_string(retryAfterSeconds));
 
-    std::string username = _item[_Username].s();
-    if (username.length() == 0)
-      print_error_line("Filecontent of ", _FileNameUsers, " invalid: Lenght of username is 0.");
+  return response;
+}
 
-    lsCopyString(usr.username, username.c_str());
+// `/batch` itself isn't admitted: `handle_batch` admits its sub-requests one by one, so the envelope neither costs a token nor counts as in flight.
+void admission_middleware::before_handle(crow::request &req, crow::response &res, context &ctx)
+{
+  if (req.url == "/batch")
+    return;
 
-    for (const auto &_t : _item[_AvailableTimePerDay])
-      list_add(&usr.availableTimePerDay, _t.i());
+  const admission_class requestClass = get_admission_class(req.url.c_str());
 
-    if (_item.has(_CompletedTasks))
-      for (const auto &_i : _item[_CompletedTasks])
-        list_add(&usr.completedTasksForCurrentDay, (size_t)_i.i());
+  // Requests without a (decodable) session are only limited by their address.
+  bool hasSession = false;
+  uint32_t sessionId = 0;
 
-    pool_add(&_Users, &usr, &index);
-  }
+  if (!req.body.empty() && LS_FAILED(LS_SILENCE_ERROR(decode_request_session_id(req.body, &hasSession, &sessionId))))
+    hasSession = false;
 
-  goto epilogue;
-epilogue:
-  lsFreePtr(&fileContents);
-}
+  char clientAddress[AdmissionMaxAddressLength + 1];
+  get_client_address(req, clientAddress);
 
-void deserialzieEventsPool()
-{
-  char *fileContents = nullptr;
-  size_t fileSize;
+  size_t retryAfterSeconds;
+  const admission_verdict verdict = admission_begin(clientAddress, hasSession, sessionId, requestClass, &ctx.startTimeNs, &retryAfterSeconds);
 
-  if (LS_FAILED(lsReadFile(_FileNameEvents, &fileContents, &fileSize)))
+  if (verdict == av_Admitted)
   {
-    print_error_line("Failed to read file", _FileNameEvents);
+    ctx.isAdmitted = true;
     return;
   }
 
-  const auto &jsonRoot = crow::json::load(fileContents);
-
-  for (const auto &_item : jsonRoot)
-  {
-    size_t index = _item[_Index].i();
-    event evnt;
-
-    std::string name = _item[_Name].s();
-    if (name.length() == 0)
-      print_error_line("Filecontent of ", _FileNameEvents, " invalid: Lenght of event name is 0.");
-
-    lsCopyString(evnt.name, name.c_str());
-
-    evnt.durationTimeSpan = _item[_DurationTimeSpan].i();
-
-    if (_item.has(_UserIds))
-      for (const auto &_i : _item[_UserIds])
-        list_add(&evnt.userIds, (size_t)_i.i());
-    
-    evnt.weight = (uint64_t)_item[_Weight].i();
-    evnt.weightGrowthFactor = (uint64_t)_item[_WeightFactor];
-    evnt.possibleExecutionDays = (weekday_flags)_item[_PossibleExecutionDays].i();
-    evnt.repetitionTimeSpan = _item[_RepetitionTimeSpan].i();
-    evnt.lastCompletedTime = (time_point_t)_item[_LastCompletedTime].i();
-    evnt.lastModifiedTime = (time_point_t)_item[_LastModifiedTime].i();
-    evnt.creationTime = (time_point_t)_item[_CreationTime].i();
-
-    pool_add(&_Events, &evnt, &index);
-  }
+  res = too_many_requests_response(retryAfterSeconds);
+  res.end();
+}
 
-  goto epilogue;
-epilogue:
-  lsFreePtr(&fileContents);
+void admission_middleware::after_handle(crow::request &, crow::response &, context &ctx)
+{
+  if (ctx.isAdmitted)
+    admission_end(ctx.startTimeNs);
 }
+
 //////////////////////////////////////////////////////////////////////////
 
 crow::response handle_login(const crow::request &req)
 {
-  auto body = crow::json::load(req.body);
+  request_fields fields;
 
-  if (!body || !body.has("username"))
+  if (LS_FAILED(decode_request_fields(req.body, &fields)) || !fields.hasUsername)
     return crow::response(crow::status::BAD_REQUEST);
 
-  const std::string &username = body["username"].s();
-
   uint32_t sessionId;
   
-  if (LS_FAILED(assign_session_token(username.c_str(), &sessionId)))
+  if (LS_FAILED(assign_session_token(fields.username, &sessionId)))
     return crow::response(crow::status::UNAUTHORIZED);
 
-  crow::json::wvalue ret;
-  ret["session_id"] = sessionId;
-
-  return crow::response(crow::status::OK, ret);
+  return session_id_response(sessionId);
 }
 
 crow::response handle_logout(const crow::request &req)
 {
-  auto body = crow::json::load(req.body);
+  request_fields fields;
 
-  if (!body || !body.has("sessionId"))
+  if (LS_FAILED(decode_request_fields(req.body, &fields)) || !fields.hasSessionId)
     return crow::response(crow::status::BAD_REQUEST);
 
-  uint32_t sessionId = (uint32_t)body["sessionId"].i();;
-
-  if (LS_FAILED(invalidate_session_token(sessionId)))
+  if (LS_FAILED(invalidate_session_token(fields.sessionId)))
     return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
-  crow::json::wvalue ret;
-  ret["success"] = true;
+  push_close_session(fields.sessionId);
 
-  return crow::response(crow::status::OK, ret);
+  return success_response();
 }
 
 crow::response handle_user_registration(const crow::request &req)
@@ -439,13 +1272,14 @@ crow::response handle_user_registration(const crow::request &req)
 
   // Username
   const std::string &username = body["username"].s();
-  if (username.length() + 1 > LS_ARRAYSIZE(usr.username) || username.length() == 0)
+  if (username.length() > MaxNameLength || username.length() == 0)
     return crow::response(crow::status::BAD_REQUEST);
 
   if (!(user_name_exists(username.c_str())))
     return crow::response(crow::status::BAD_REQUEST);
 
-  lsCopyString(usr.username, username.c_str());
+  if (LS_FAILED(arena_string_set(&usr.username, username.c_str(), username.length())))
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
   // Available Time per Day
   for (const auto &_item : body["availableTime"])
@@ -457,43 +1291,36 @@ crow::response handle_user_registration(const crow::request &req)
     list_add(&usr.availableTimePerDay, time_span_from_minutes(_item.i()));
   }
 
-  if (LS_FAILED(add_new_user(usr)))
+  if (LS_FAILED(add_new_user(std::move(usr))))
     return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
   uint32_t sessionId;
   if (LS_FAILED(assign_session_token(username.c_str(), &sessionId)))
     return crow::response(crow::status::UNAUTHORIZED);
 
-  crow::json::wvalue ret;
-  ret["session_id"] = sessionId;
-
-  return crow::response(crow::status::OK, ret);
+  return session_id_response(sessionId);
 }
 
-crow::response handle_user_time_info(const crow::request &req)
+crow::response handle_user_time_info(const crow::request &, const request_fields &, const size_t userId)
 {
-  auto body = crow::json::load(req.body);
-
-  if (!body || !body.has("sessionId"))
-    return crow::response(crow::status::BAD_REQUEST);
-
-  uint32_t sessionId = (uint32_t)body["sessionId"].i();;
-  size_t userId;
-
-  if (LS_FAILED(get_user_id_from_session_id(sessionId, &userId)))
-    return crow::response(crow::status::FORBIDDEN);
-
   local_list<time_span_t, DaysPerWeek> availableTime;
 
   if (LS_FAILED(get_available_time(userId, &availableTime)))
     return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
-  crow::json::wvalue ret = crow::json::rvalue(crow::json::type::List);
+  json_writer *pWriter = response_writer_begin();
+
+  if (pWriter == nullptr || LS_FAILED(json_writer_begin_array(pWriter)))
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
   for (size_t i = 0; i < availableTime.count; i++)
-    ret[(uint32_t)i] = minutes_from_time_span(availableTime[i]);
+    if (LS_FAILED(json_writer_uint(pWriter, minutes_from_time_span(availableTime[i]))))
+      return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
-  return crow::response(crow::status::OK, ret);
+  if (LS_FAILED(json_writer_end_array(pWriter)))
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
+
+  return response_writer_finish(pWriter);
 }
 
 crow::response handle_user_edit(const crow::request &req)
@@ -518,10 +1345,7 @@ crow::response handle_user_edit(const crow::request &req)
   if (LS_FAILED(replace_available_time(userId, availableTime)))
     return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
-  crow::json::wvalue ret;
-  ret["success"] = true;
-
-  return crow::response(crow::status::OK, ret);
+  return success_response();
 }
 
 crow::response handle_task_creation_modification(const crow::request &req, const bool isCreation)
@@ -538,7 +1362,7 @@ crow::response handle_task_creation_modification(const crow::request &req, const
   const uint64_t weight = body["weight"].i();
   const uint64_t weightFactor = body["weightFactor"].i();
   local_list<bool, 7> executionDays;
-  local_list<size_t, MaxUsersPerEvent> userIds;
+  event evnt;
 
   size_t __unused;
   if (LS_FAILED(get_user_id_from_session_id(sessionId, &__unused)))
@@ -555,22 +1379,15 @@ crow::response handle_task_creation_modification(const crow::request &req, const
     if (i.i() < 0)
       return crow::response(crow::status::BAD_REQUEST);;
 
-    if (LS_FAILED(list_add(&userIds, (size_t)i.i())))
-      return crow::response(crow::status::INTERNAL_SERVER_ERROR);
-  }
-
-  event evnt;
-
-  for (const auto &_item : userIds)
-  {
-    if (LS_FAILED(list_add(&evnt.userIds, _item)))
+    if (LS_FAILED(list_add(&evnt.userIds, (size_t)i.i())))
       return crow::response(crow::status::INTERNAL_SERVER_ERROR);
   }
 
-  if (eventName.length() == 0 || eventName.length() > LS_ARRAYSIZE(evnt.name))
+  if (eventName.length() == 0 || eventName.length() > MaxNameLength)
     return crow::response(crow::status::BAD_REQUEST);
 
-  lsCopyString(evnt.name, eventName.c_str());
+  if (LS_FAILED(arena_string_set(&evnt.name, eventName.c_str(), eventName.length())))
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
   evnt.repetitionTimeSpan = time_span_from_days(repetitionInDays);
 
@@ -602,7 +1419,7 @@ crow::response handle_task_creation_modification(const crow::request &req, const
     evnt.lastCompletedTime = 0;
     evnt.lastModifiedTime = 0;
 
-    if (LS_FAILED(add_new_event(evnt)))
+    if (LS_FAILED(add_new_event(std::move(evnt))))
       return crow::response(crow::status::INTERNAL_SERVER_ERROR);
   }
   else
@@ -612,195 +1429,486 @@ crow::response handle_task_creation_modification(const crow::request &req, const
 
     size_t id = body["id"].i();
 
-    if (LS_FAILED(update_task(id, evnt)))
+    if (LS_FAILED(update_task(id, std::move(evnt))))
       return crow::response(crow::status::INTERNAL_SERVER_ERROR);
   }
 
-  crow::json::wvalue ret;
-  ret["success"] = true;
-
-  return crow::response(crow::status::OK, ret);
+  return success_response();
 }
 
-crow::response handle_user_schedule(const crow::request &req)
+crow::response handle_user_schedule(const crow::request &req, const request_fields &fields, const size_t userId)
 {
-  auto body = crow::json::load(req.body);
+  std::shared_ptr<const schedule_blob> schedule;
+
+  if (LS_FAILED(get_user_schedule_blob(userId, &schedule)))
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
+
+  char etag[ETagLength + 1];
+  format_etag(schedule->etag, etag);
 
-  if (!body || !body.has("sessionId"))
+  if (etag_matches(req, fields, etag))
+    return not_modified_response(etag);
+
+  crow::response response(crow::status::OK, schedule->json);
+  response.set_header("Content-Type", "application/json");
+  set_etag_header(&response, etag);
+
+  return response;
+}
+
+crow::response handle_event_search(const crow::request &, const request_fields &fields, const size_t userId)
+{
+  if (!fields.hasQuery) // an empty query lists all of the user's tasks.
     return crow::response(crow::status::BAD_REQUEST);
 
-  const uint32_t sessionId = (uint32_t)body["sessionId"].i();;
+  json_writer *pWriter = response_writer_begin();
+  lsResult writeResult = pWriter == nullptr ? lsR_MemoryAllocationFailure : json_writer_begin_array(pWriter);
 
-  size_t userId;
-  if (LS_FAILED(get_user_id_from_session_id(sessionId, &userId)))
-    return crow::response(crow::status::FORBIDDEN);
+  if (LS_FAILED(writeResult))
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
-  local_list<event_info, MaxEventsPerUserPerDay> currentTasks;
-  if (LS_FAILED(get_current_events_from_user_id(userId, &currentTasks)))
+  if (LS_FAILED(search_events_by_user_by_name(userId, fields.query, [&](const event_info &info) {
+    if (LS_SUCCESS(writeResult))
+      writeResult = write_event_info(pWriter, info);
+  })))
     return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
-  local_list<event_info, MaxEventsPerUserPerDay> tooLongTasks;
-  if (LS_FAILED(get_current_too_long_events_from_user_id(userId, &tooLongTasks)))
+  if (LS_FAILED(writeResult) || LS_FAILED(json_writer_end_array(pWriter)))
     return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
-  crow::json::wvalue ret = crow::json::rvalue(crow::json::type::List);
+  return response_writer_finish(pWriter);
+}
 
-  for (size_t i = 0; i < currentTasks.count; i++)
-  {
-    auto &item = ret["tasks"][(uint32_t)i]; // is this legal? or does the underlying memory move...
-    item["name"] = currentTasks[i].name;
-    item["duration"] = currentTasks[i].durationInMinutes;
-    item["id"] = currentTasks[i].id;
-    item["isCompleted"] = currentTasks[i].isCompleted;
-  }
+crow::response handle_user_search(const crow::request &, const request_fields &fields, const size_t)
+{
+  if (!fields.hasQuery || fields.query[0] == '\0') // empty queries would match every user.
+    return crow::response(crow::status::BAD_REQUEST);
 
-  for (size_t i = 0; i < tooLongTasks.count; i++)
-  {
-    auto &item = ret["long_tasks"][(uint32_t)i]; // is this legal? or does the underlying memory move...
-    item["name"] = tooLongTasks[i].name;
-    item["duration"] = tooLongTasks[i].durationInMinutes;
-    item["id"] = tooLongTasks[i].id;
-    item["isCompleted"] = tooLongTasks[i].isCompleted;
-  }
+  bool isTruncated = false;
+
+  json_writer *pWriter = response_writer_begin();
+  lsResult writeResult = pWriter == nullptr ? lsR_MemoryAllocationFailure : json_writer_begin_object(pWriter);
+
+  if (LS_FAILED(writeResult)
+    || LS_FAILED(json_writer_key(pWriter, "results"))
+    || LS_FAILED(json_writer_begin_array(pWriter)))
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
+
+  if (LS_FAILED(search_users_by_name(fields.query, [&](const user_info &info) {
+    if (LS_SUCCESS(writeResult))
+      writeResult = write_user_info(pWriter, info);
+  }, &isTruncated)))
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
+
+  if (LS_FAILED(writeResult)
+    || LS_FAILED(json_writer_end_array(pWriter))
+    || LS_FAILED(json_writer_key(pWriter, "truncated"))
+    || LS_FAILED(json_writer_bool(pWriter, isTruncated))
+    || LS_FAILED(json_writer_end_object(pWriter)))
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
-  return crow::response(crow::status::OK, ret);
+  return response_writer_finish(pWriter);
 }
 
-crow::response handle_event_search(const crow::request &req)
+crow::response handle_event_completed(const crow::request &req, const bool needsReschdule)
 {
-  auto body = crow::json::load(req.body);
+  request_fields fields;
 
-  if (!body || !body.has("sessionId") || !body.has("query"))
+  if (LS_FAILED(decode_request_fields(req.body, &fields)) || !fields.hasSessionId || !fields.hasTaskId)
     return crow::response(crow::status::BAD_REQUEST);
 
-  const std::string &query = body["query"].s();
-  const uint32_t sessionId = (uint32_t)body["sessionId"].i();;
+  const size_t eventId = fields.taskId;
 
-  size_t __unused;
-  if (LS_FAILED(get_user_id_from_session_id(sessionId, &__unused)))
+  if (LS_FAILED(set_event_last_completed_time(eventId, get_current_time())))
+    return crow::response(crow::status::BAD_REQUEST);
+
+  size_t userId;
+  if (LS_FAILED(get_user_id_from_session_id(fields.sessionId, &userId)))
     return crow::response(crow::status::FORBIDDEN);
 
-  local_list<event_info, MaxSearchResults> searchResults;
+  if (LS_FAILED(add_completed_task(eventId, userId)))
+    return crow::response(crow::status::BAD_REQUEST);
 
-  if (LS_FAILED(search_events_by_name(query.c_str(), &searchResults)))
-    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
+  if (needsReschdule)
+    _ExplicitlyRequestsRescheduleEpoch++;
 
-  crow::json::wvalue ret = crow::json::rvalue(crow::json::type::List);
+  return success_response();
+}
 
-  for (size_t i = 0; i < searchResults.count; i++)
-  {
-    auto &item = ret[(uint32_t)i]; // is this legal? or does the underlying memory move...
-    item["name"] = searchResults[i].name;
-    item["duration"] = searchResults[i].durationInMinutes;
-    item["id"] = searchResults[i].id;
-  }
+lsResult write_task_details(json_writer *pWriter, const event &evnt)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(json_writer_begin_object(pWriter));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "name"));
+  LS_ERROR_CHECK(json_writer_string(pWriter, arena_string_get(evnt.name), arena_string_length(evnt.name)));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "duration"));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, minutes_from_time_span(evnt.durationTimeSpan)));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "executionDays"));
+  LS_ERROR_CHECK(json_writer_begin_array(pWriter));
+
+  for (size_t i = 0; i < DaysPerWeek; i++)
+    LS_ERROR_CHECK(json_writer_bool(pWriter, !!(evnt.possibleExecutionDays & (1 << i))));
+
+  LS_ERROR_CHECK(json_writer_end_array(pWriter));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "repetition"));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, days_from_time_span(evnt.repetitionTimeSpan)));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "weight"));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, evnt.weight));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "weightFactor"));
+  LS_ERROR_CHECK(json_writer_uint(pWriter, evnt.weightGrowthFactor));
+  LS_ERROR_CHECK(json_writer_key(pWriter, "users"));
+  LS_ERROR_CHECK(json_writer_begin_array(pWriter)); // closed by the caller, after the participants.
 
-  return crow::response(crow::status::OK, ret);
+epilogue:
+  return result;
 }
 
-crow::response handle_user_search(const crow::request &req)
+// Writes the event & its participants straight from the pools, while they're locked once.
+lsResult render_task_details(const crow::request &req, const request_fields &fields, const size_t taskId, json_writer *pWriter, _Out_ char (&etag)[ETagLength + 1], _Out_ bool *pIsNotModified)
 {
-  auto body = crow::json::load(req.body);
+  lsResult result = lsR_Success;
+
+  lsResult writeResult = lsR_Success;
+
+  LS_ERROR_IF(pWriter == nullptr || pIsNotModified == nullptr, lsR_ArgumentNull);
+  *pIsNotModified = false;
+
+  LS_ERROR_CHECK(get_event_details(taskId,
+    [&](const event &evnt) {
+      format_etag(get_event_etag(evnt), etag);
+
+      if (etag_matches(req, fields, etag))
+      {
+        *pIsNotModified = true;
+        return false;
+      }
+
+      writeResult = write_task_details(pWriter, evnt);
+      return LS_SUCCESS(writeResult);
+    },
+    [&](const user_info &info) {
+      if (LS_SUCCESS(writeResult))
+        writeResult = write_user_info(pWriter, info);
+    }));
+
+  if (*pIsNotModified)
+    goto epilogue;
+
+  LS_ERROR_CHECK(writeResult);
+  LS_ERROR_CHECK(json_writer_end_array(pWriter));
+  LS_ERROR_CHECK(json_writer_end_object(pWriter));
 
-  if (!body || !body.has("sessionId") || !body.has("query"))
+epilogue:
+  return result;
+}
+
+crow::response handle_task_details(const crow::request &req, const request_fields &fields, const size_t)
+{
+  if (!fields.hasTaskId)
     return crow::response(crow::status::BAD_REQUEST);
 
-  const uint32_t sessionId = (uint32_t)body["sessionId"].i();;
+  const size_t taskId = fields.taskId;
 
-  size_t __unused;
-  if (LS_FAILED(get_user_id_from_session_id(sessionId, &__unused)))
-    return crow::response(crow::status::FORBIDDEN);
+  json_writer *pWriter = response_writer_begin();
+  char etag[ETagLength + 1];
+  bool isNotModified;
 
-  const std::string &query = body["query"].s();
+  const lsResult result = render_task_details(req, fields, taskId, pWriter, etag, &isNotModified);
 
-  local_list<user_info, MaxSearchResults> searchResults;
-  if (LS_FAILED(search_users_by_name(query.c_str(), &searchResults)))
+  if (result == lsR_ResourceNotFound)
+    return crow::response(crow::status::BAD_REQUEST);
+  else if (LS_FAILED(result))
     return crow::response(crow::status::INTERNAL_SERVER_ERROR);
 
-  crow::json::wvalue ret = crow::json::rvalue(crow::json::type::List);
+  if (isNotModified)
+    return not_modified_response(etag);
+
+  crow::response response = response_writer_finish(pWriter);
+
+  if (response.code == crow::status::OK)
+    set_etag_header(&response, etag);
+
+  return response;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// `/batch`: `{"sessionId":..., "requests":[{"path":"/task", "body":{"taskId":...}}, ...]}` runs read-only requests in one round trip.
+// Responds with `{"responses":[{"status":..., "etag":..., "body":...}, ...]}` in request order. Sub-requests don't repeat the session.
+// Conditional sub-requests echo their tag as `"etag"` in their body, the headers of the batch don't apply to them.
+constexpr size_t BatchMaxRequests = 32;
 
-  for (size_t i = 0; i < searchResults.count; i++)
+struct batch_route
+{
+  const char *path;
+  session_handler handler;
+};
+
+static const batch_route _BatchRoutes[] =
+{
+  { "/user-schedule", handle_user_schedule },
+  { "/user-time-info", handle_user_time_info },
+  { "/task", handle_task_details },
+  { "/task-search", handle_event_search },
+  { "/user-search", handle_user_search },
+};
+
+struct batch_request
+{
+  char path[RequestMaxPathLength + 1];
+  request_fields fields; // empty without a `"body"`.
+  bool hasPath = false;
+};
+
+lsResult read_batch_request(json_reader *pReader, _Out_ batch_request *pRequest)
+{
+  lsResult result = lsR_Success;
+
+  *pRequest = batch_request();
+
+  LS_ERROR_CHECK(json_reader_begin_object(pReader));
+
+  while (true)
   {
-    auto &item = ret[(uint32_t)i]; // is this legal? or does the underlying memory move...
-    item["name"] = searchResults[i].name;
-    item["id"] = searchResults[i].id;
+    bool hasMember;
+    json_reader_key key;
+
+    LS_ERROR_CHECK(json_reader_next_member(pReader, &hasMember, &key));
+
+    if (!hasMember)
+      break;
+
+    if (json_reader_key_equals(key, "path"))
+      LS_ERROR_CHECK(read_request_string(pReader, pRequest->path, LS_ARRAYSIZE(pRequest->path), &pRequest->hasPath));
+    else if (json_reader_key_equals(key, "body"))
+      LS_ERROR_CHECK(read_request_fields(pReader, &pRequest->fields));
+    else
+      LS_ERROR_CHECK(json_reader_skip(pReader));
   }
 
-  return crow::response(crow::status::OK, ret);
+epilogue:
+  return result;
 }
 
-crow::response handle_event_completed(const crow::request &req, const bool needsReschdule)
+// The session may follow the requests, so they're all decoded before any of them runs.
+lsResult decode_batch(const std::string &body, _Out_ uint32_t *pSessionId, _Out_ small_list<batch_request, 1> *pRequests)
 {
-  auto body = crow::json::load(req.body);
+  lsResult result = lsR_Success;
 
-  if (!body || !body.has("sessionId") || !body.has("taskId"))
-    return crow::response(crow::status::BAD_REQUEST);
+  json_reader reader;
+  bool hasSessionId = false;
+  bool hasRequests = false;
 
-  const size_t eventId = body["taskId"].i();
-  const uint32_t sessionId = (uint32_t)body["sessionId"].i();
+  LS_ERROR_CHECK(json_reader_create(&reader, body.data(), body.size()));
+  LS_ERROR_CHECK(json_reader_begin_object(&reader));
 
-  if (LS_FAILED(set_event_last_completed_time(eventId, get_current_time())))
-    return crow::response(crow::status::BAD_REQUEST);
+  while (true)
+  {
+    bool hasMember;
+    json_reader_key key;
 
-  size_t userId;
-  if (LS_FAILED(get_user_id_from_session_id(sessionId, &userId)))
-    return crow::response(crow::status::FORBIDDEN);
+    LS_ERROR_CHECK(json_reader_next_member(&reader, &hasMember, &key));
 
-  if (LS_FAILED(add_completed_task(eventId, userId)))
-    return crow::response(crow::status::BAD_REQUEST);
+    if (!hasMember)
+      break;
 
-  if (needsReschdule)
-    _ExplicitlyRequestsRescheduleEpoch++;
+    if (json_reader_key_equals(key, "sessionId"))
+    {
+      uint64_t sessionId;
+      LS_ERROR_CHECK(read_request_id(&reader, &sessionId));
+      LS_ERROR_IF(sessionId > UINT32_MAX, lsR_ArgumentOutOfBounds);
+
+      *pSessionId = (uint32_t)sessionId;
+      hasSessionId = true;
+    }
+    else if (json_reader_key_equals(key, "requests"))
+    {
+      LS_ERROR_CHECK(json_reader_begin_array(&reader));
+
+      while (true)
+      {
+        bool hasElement;
+        LS_ERROR_CHECK(json_reader_next_element(&reader, &hasElement));
+
+        if (!hasElement)
+          break;
+
+        LS_ERROR_IF(pRequests->count >= BatchMaxRequests, lsR_ResourceFull);
+
+        batch_request request;
+        LS_ERROR_CHECK(read_batch_request(&reader, &request));
+        LS_ERROR_CHECK(list_add(pRequests, request));
+      }
+
+      hasRequests = true;
+    }
+    else
+    {
+      LS_ERROR_CHECK(json_reader_skip(&reader));
+    }
+  }
 
-  crow::json::wvalue ret;
-  ret["success"] = true;
+  LS_ERROR_CHECK(json_reader_end(&reader));
+  LS_ERROR_IF(!hasSessionId || !hasRequests, lsR_InvalidParameter);
 
-  return crow::response(crow::status::OK, ret);
+epilogue:
+  return result;
 }
 
-crow::response handle_task_details(const crow::request &req)
+crow::response handle_batch_request(const batch_request &request, const size_t userId)
 {
-  auto body = crow::json::load(req.body);
+  static const crow::request EmptyRequest;
 
-  if (!body || !body.has("sessionId") || !body.has("taskId"))
+  if (!request.hasPath)
     return crow::response(crow::status::BAD_REQUEST);
 
-  const size_t taskId = body["taskId"].i();
-  const uint32_t sessionId = (uint32_t)body["sessionId"].i();;
+  for (const batch_route &route : _BatchRoutes)
+    if (strcmp(request.path, route.path) == 0)
+      return route.handler(EmptyRequest, request.fields, userId);
 
-  size_t __unused;
-  if (LS_FAILED(get_user_id_from_session_id(sessionId, &__unused)))
-    return crow::response(crow::status::FORBIDDEN);
+  return crow::response(crow::status::NOT_FOUND);
+}
 
-  event evnt;
-  if (LS_FAILED(get_event(taskId, &evnt)))
-    return crow::response(crow::status::BAD_REQUEST);
+// Rejected envelopes have no sub-requests to pay for them, so they pay like a regular request of their address instead.
+crow::response reject_batch(const char *clientAddress, const crow::status status)
+{
+  int64_t startTimeNs;
+  size_t retryAfterSeconds;
 
-  crow::json::wvalue ret;
+  if (admission_begin(clientAddress, false, 0, ac_Regular, &startTimeNs, &retryAfterSeconds) != av_Admitted)
+    return too_many_requests_response(retryAfterSeconds);
 
-  ret["name"] = evnt.name;
+  admission_end(startTimeNs);
 
-  ret["duration"] = minutes_from_time_span(evnt.durationTimeSpan);
+  return crow::response(status);
+}
 
-  for (size_t i = 0; i < DaysPerWeek; i++)
-    ret["executionDays"][(uint32_t)i] = !!(evnt.possibleExecutionDays & (1 << i));
+crow::response handle_batch(const crow::request &req)
+{
+  char clientAddress[AdmissionMaxAddressLength + 1];
+  get_client_address(req, clientAddress);
+
+  uint32_t sessionId;
+  small_list<batch_request, 1> requests;
+
+  if (LS_FAILED(decode_batch(req.body, &sessionId, &requests)))
+    return reject_batch(clientAddress, crow::status::BAD_REQUEST);
 
-  ret["repetition"] = days_from_time_span(evnt.repetitionTimeSpan);
-  ret["weight"] = evnt.weight;
-  ret["weightFactor"] = evnt.weightGrowthFactor;
+  size_t userId;
+  if (LS_FAILED(get_user_id_from_session_id(sessionId, &userId)))
+    return reject_batch(clientAddress, crow::status::FORBIDDEN);
 
-  ret["users"] = crow::json::rvalue(crow::json::type::List);
+  // The responses are JSON already, so they're spliced in rather than parsed again.
+  std::string ret = "{\"responses\":[";
 
-  for (size_t i = 0; i < evnt.userIds.count; i++)
+  for (size_t i = 0; i < requests.count; i++)
   {
-    user_info info;
+    // Sub-requests pay like the requests they stand for, so batching doesn't get around the limits or the overload shedding.
+    const admission_class requestClass = requests[i].hasPath ? get_admission_class(requests[i].path) : ac_Regular;
+    int64_t startTimeNs;
+    size_t retryAfterSeconds;
+    crow::response response;
 
-    if (LS_FAILED(get_user_info(evnt.userIds[i], &info)))
-      return crow::response(crow::status::INTERNAL_SERVER_ERROR);
+    if (admission_begin(clientAddress, true, sessionId, requestClass, &startTimeNs, &retryAfterSeconds) == av_Admitted)
+    {
+      response = handle_batch_request(requests[i], userId);
+      admission_end(startTimeNs);
+    }
+    else
+    {
+      response = too_many_requests_response(retryAfterSeconds);
+    }
+
+    const std::string &etag = response.get_header_value("ETag");
+    const bool hasBody = response.code >= 200 && response.code < 300 && !response.body.empty();
+
+    if (i > 0)
+      ret += ',';
+
+    ret += "{\"status\":";
+    ret += std::to_string(response.code);
+
+    if (!etag.empty())
+    {
+      ret += ",\"etag\":\"";
+
+      for (const char c : etag) // our own tags only contain quotes & hex digits.
+      {
+        if (c == '"')
+          ret += '\\';
+
+        ret += c;
+      }
+
+      ret += '"';
+    }
+
+    ret += ",\"body\":";
+    ret += hasBody ? response.body : "null";
+    ret += '}';
+  }
 
-    ret["users"][(uint32_t)i]["name"] = info.name;
-    ret["users"][(uint32_t)i]["id"] = info.id;
+  ret += "]}";
+
+  crow::response response(crow::status::OK, std::move(ret));
+  response.set_header("Content-Type", "application/json");
+
+  return response;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// `/schedule-updates`: a websocket that receives the user's schedule whenever it changes, starting with the current one.
+// The first message authenticates the connection with `{"sessionId":...}`, so the session doesn't end up in URLs or logs. Later messages are ignored.
+// The connection's userdata holds the push connection id + 1, `nullptr` while unauthenticated.
+
+void handle_schedule_updates_message(crow::websocket::connection &connection, const std::string &message, const bool isBinary)
+{
+  if (connection.userdata() != nullptr)
+    return;
+
+  request_fields fields;
+
+  if (isBinary || LS_FAILED(decode_request_fields(message, &fields)) || !fields.hasSessionId)
+  {
+    connection.close("bad request");
+    return;
+  }
+
+  const uint32_t sessionId = fields.sessionId;
+
+  size_t userId;
+  if (LS_FAILED(get_user_id_from_session_id(sessionId, &userId)))
+  {
+    connection.close("forbidden");
+    return;
+  }
+
+  push_target target;
+  target.send = [&connection](std::string &&update) { connection.send_text(std::move(update)); };
+  target.close = [&connection]() { connection.close("logged out"); };
+
+  size_t connectionId;
+  if (LS_FAILED(push_register(userId, sessionId, std::move(target), &connectionId)))
+  {
+    connection.close("unavailable");
+    return;
   }
 
-  return crow::response(crow::status::OK, ret);
+  connection.userdata(reinterpret_cast<void *>(connectionId + 1));
+
+  std::shared_ptr<const schedule_blob> schedule;
+
+  if (LS_SUCCESS(get_user_schedule_blob(userId, &schedule)))
+    push_initial_schedule(connectionId, schedule);
+}
+
+void handle_schedule_updates_close(crow::websocket::connection &connection)
+{
+  if (connection.userdata() == nullptr)
+    return;
+
+  push_unregister(reinterpret_cast<size_t>(connection.userdata()) - 1);
+  connection.userdata(nullptr);
 }
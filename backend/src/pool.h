@@ -98,6 +98,7 @@ struct pool
   size_t count = 0;
   size_t blockCount = 0;
   uint64_t *pBlockEmptyMask = nullptr;
+  uint64_t *pBlockDirtyMask = nullptr; // set for every slot that has been added, removed or marked with `pool_mark_dirty` since the last `pool_clear_dirty`.
   T **ppBlocks = nullptr;
 
   static constexpr size_t BlockSize = sizeof(uint64_t) * CHAR_BIT;
@@ -117,12 +118,14 @@ struct pool
     count(move.count),
     blockCount(move.blockCount),
     pBlockEmptyMask(move.pBlockEmptyMask),
+    pBlockDirtyMask(move.pBlockDirtyMask),
     ppBlocks(move.ppBlocks)
   {
     move.count = 0;
     move.blockCount = 0;
     move.ppBlocks = nullptr;
     move.pBlockEmptyMask = nullptr;
+    move.pBlockDirtyMask = nullptr;
   }
 
   pool &operator = (pool &&move)
@@ -132,12 +135,14 @@ struct pool
     count = move.count;
     blockCount = move.blockCount;
     pBlockEmptyMask = move.pBlockEmptyMask;
+    pBlockDirtyMask = move.pBlockDirtyMask;
     ppBlocks = move.ppBlocks;
 
     move.count = 0;
     move.blockCount = 0;
     move.ppBlocks = nullptr;
     move.pBlockEmptyMask = nullptr;
+    move.pBlockDirtyMask = nullptr;
 
     return *this;
   }
@@ -178,6 +183,7 @@ lsResult pool_reserve_blocks(pool<T, multiBlockAllocCount> *pPool, const size_t
   {
     const size_t newSize = ((blockCount + multiBlockAllocCount - 1) / multiBlockAllocCount) * multiBlockAllocCount;
     LS_ERROR_CHECK(lsRealloc(&pPool->pBlockEmptyMask, newSize));
+    LS_ERROR_CHECK(lsRealloc(&pPool->pBlockDirtyMask, newSize));
     LS_ERROR_CHECK(lsRealloc(&pPool->ppBlocks, newSize));
 
     while (pPool->blockCount < blockCount)
@@ -187,7 +193,10 @@ lsResult pool_reserve_blocks(pool<T, multiBlockAllocCount> *pPool, const size_t
       LS_ERROR_CHECK(lsAllocZero(&pPool->ppBlocks[pPool->blockCount], pool<T, multiBlockAllocCount>::BlockSize * multiBlockAllocCount));
 
       for (size_t i = pPool->blockCount; i < newBlockCount; i++)
+      {
         pPool->pBlockEmptyMask[i] = 0;
+        pPool->pBlockDirtyMask[i] = 0;
+      }
 
       if constexpr (multiBlockAllocCount > 1)
         for (size_t i = pPool->blockCount + 1; i < newBlockCount; i++)
@@ -250,11 +259,15 @@ lsResult pool_allocate(pool<T, multiBlockAllocCount> *pPool, T **ppItem, _Out_ s
     blockSubIndex = 0;
 
     LS_ERROR_CHECK(lsRealloc(&pPool->pBlockEmptyMask, newBlockCount));
+    LS_ERROR_CHECK(lsRealloc(&pPool->pBlockDirtyMask, newBlockCount));
     LS_ERROR_CHECK(lsRealloc(&pPool->ppBlocks, newBlockCount));
     LS_ERROR_CHECK(lsAllocZero(&pPool->ppBlocks[blockIndex], pool<T, multiBlockAllocCount>::BlockSize * multiBlockAllocCount));
 
     for (size_t i = blockIndex; i < newBlockCount; i++)
+    {
       pPool->pBlockEmptyMask[i] = 0;
+      pPool->pBlockDirtyMask[i] = 0;
+    }
 
     if constexpr (multiBlockAllocCount > 1)
       for (size_t i = blockIndex + 1; i < newBlockCount; i++)
@@ -265,6 +278,7 @@ lsResult pool_allocate(pool<T, multiBlockAllocCount> *pPool, T **ppItem, _Out_ s
 
   *ppItem = &pPool->ppBlocks[blockIndex][blockSubIndex];
   pPool->pBlockEmptyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
+  pPool->pBlockDirtyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
   *pIndex = blockIndex * pool<T, multiBlockAllocCount>::BlockSize + blockSubIndex;
   pPool->count++;
 
@@ -325,6 +339,7 @@ lsResult pool_insertAt(pool<T, multiBlockAllocCount> *pPool, const T *pItem, con
 
     pPool->ppBlocks[blockIndex][blockSubIndex] = *pItem;
     pPool->pBlockEmptyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
+    pPool->pBlockDirtyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
 
     if (!isOverride)
       pPool->count++;
@@ -362,6 +377,7 @@ lsResult pool_insertAt(pool<T, multiBlockAllocCount> *pPool, T &&item, const siz
       pPool->ppBlocks[blockIndex][blockSubIndex] = std::move(item);
 
     pPool->pBlockEmptyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
+    pPool->pBlockDirtyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
 
     if (!isOverride)
       pPool->count++;
@@ -371,6 +387,38 @@ epilogue:
   return result;
 }
 
+// Like `pool_insertAt`, but only for blocks reserved with `pool_reserve_blocks` beforehand & without updating `count`.
+// Multiple threads may insert concurrently, as long as no two threads insert into the same block. Call `pool_recount` once all of them are done.
+template <typename T, size_t multiBlockAllocCount>
+lsResult pool_insertAt_concurrent(pool<T, multiBlockAllocCount> *pPool, T &&item, const size_t index)
+{
+  lsResult result = lsR_Success;
+
+  const size_t blockIndex = index / pool<T, multiBlockAllocCount>::BlockSize;
+  const size_t blockSubIndex = index % pool<T, multiBlockAllocCount>::BlockSize;
+
+  LS_ERROR_IF(pPool == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(blockIndex >= pPool->blockCount, lsR_ArgumentOutOfBounds);
+  LS_ERROR_IF(pPool->pBlockEmptyMask[blockIndex] & ((uint64_t)1 << blockSubIndex), lsR_ResourceAlreadyExists);
+
+  new (&pPool->ppBlocks[blockIndex][blockSubIndex]) T(std::move(item));
+
+  pPool->pBlockEmptyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
+  pPool->pBlockDirtyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
+
+epilogue:
+  return result;
+}
+
+template <typename T, size_t multiBlockAllocCount>
+void pool_recount(pool<T, multiBlockAllocCount> *pPool)
+{
+  pPool->count = 0;
+
+  for (size_t i = 0; i < pPool->blockCount; i++)
+    pPool->count += std::popcount(pPool->pBlockEmptyMask[i]);
+}
+
 template <typename T, size_t multiBlockAllocCount>
 lsResult pool_insertIfNotContainedAndRetrieve(pool<T, multiBlockAllocCount> *pPool, const T *pItem, const size_t index, T **pOut, _Out_opt_ bool *pExisted = nullptr)
 {
@@ -390,6 +438,7 @@ lsResult pool_insertIfNotContainedAndRetrieve(pool<T, multiBlockAllocCount> *pPo
     {
       pPool->ppBlocks[blockIndex][blockSubIndex] = *pItem;
       pPool->pBlockEmptyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
+      pPool->pBlockDirtyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
       pPool->count++;
     }
 
@@ -547,6 +596,7 @@ lsResult pool_remove_safe(pool<T, multiBlockAllocCount> *pPool, const size_t ind
       pPool->ppBlocks[blockIndex][blockSubIndex].~T();
 
     pPool->pBlockEmptyMask[blockIndex] &= ~(uint64_t)((uint64_t)1 << blockSubIndex);
+    pPool->pBlockDirtyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
     pPool->count--;
   }
 
@@ -564,6 +614,7 @@ T pool_remove(pool<T, multiBlockAllocCount> &self, const size_t index)
   lsAssert((self.pBlockEmptyMask[blockIndex] & ((uint64_t)1 << blockSubIndex)) != 0);
 
   self.pBlockEmptyMask[blockIndex] &= ~(uint64_t)((uint64_t)1 << blockSubIndex);
+  self.pBlockDirtyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
   self.count--;
 
   return std::move(self.ppBlocks[blockIndex][blockSubIndex]);
@@ -580,6 +631,7 @@ auto pool_remove(TPoolNonConstIterator &it)
   lsAssert((it._pIterator->pPool->pBlockEmptyMask[blockIndex] & ((uint64_t)1 << blockSubIndex)) != 0);
 
   it._pIterator->pPool->pBlockEmptyMask[blockIndex] &= ~(uint64_t)((uint64_t)1 << blockSubIndex);
+  it._pIterator->pPool->pBlockDirtyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
   it._pIterator->pPool->count--;
   it._pIterator->iteratedItem--;
   it.pItem = nullptr;
@@ -598,7 +650,10 @@ void pool_clear(pool<T, multiBlockAllocCount> *pPool)
     _item.pItem->~T();
 
   for (size_t i = 0; i < pPool->blockCount; i++)
+  {
+    pPool->pBlockDirtyMask[i] |= pPool->pBlockEmptyMask[i];
     pPool->pBlockEmptyMask[i] = 0;
+  }
 
   pPool->count = 0;
 }
@@ -617,6 +672,7 @@ void pool_destroy(pool<T, multiBlockAllocCount> *pPool)
 
   lsFreePtr(&pPool->ppBlocks);
   lsFreePtr(&pPool->pBlockEmptyMask);
+  lsFreePtr(&pPool->pBlockDirtyMask);
 
   pPool->blockCount = 0;
   pPool->count = 0;
@@ -633,6 +689,25 @@ bool pool_has(const pool<T, multiBlockAllocCount> &p, const size_t index)
   return p.blockCount > blockIndex && ((p.pBlockEmptyMask[blockIndex] >> blockSubIndex) & 1);
 }
 
+template <typename T, size_t multiBlockAllocCount>
+void pool_mark_dirty(pool<T, multiBlockAllocCount> *pPool, const size_t index) // for items modified in place.
+{
+  const size_t blockIndex = index / pool<T, multiBlockAllocCount>::BlockSize;
+  const size_t blockSubIndex = index % pool<T, multiBlockAllocCount>::BlockSize;
+
+  lsAssert(pPool->blockCount > blockIndex);
+
+  pPool->pBlockDirtyMask[blockIndex] |= ((uint64_t)1 << blockSubIndex);
+}
+
+template <typename T, size_t multiBlockAllocCount>
+void pool_clear_dirty(pool<T, multiBlockAllocCount> *pPool, const size_t blockIndex)
+{
+  lsAssert(pPool->blockCount > blockIndex);
+
+  pPool->pBlockDirtyMask[blockIndex] = 0;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 template <typename T, size_t multiBlockAllocCount>
@@ -697,6 +772,8 @@ void pool_compact(pool<T, multiBlockAllocCount> &p, const std::function<void(T &
     new (&p.ppBlocks[writeBlockIdx][writeSubIdx]) T(std::move(p.ppBlocks[readBlockIdx][readSubIdx]));
     p.pBlockEmptyMask[writeBlockIdx] |= ((uint64_t)1 << writeSubIdx);
     p.pBlockEmptyMask[readBlockIdx] &= ~((uint64_t)1 << readSubIdx);
+    p.pBlockDirtyMask[writeBlockIdx] |= ((uint64_t)1 << writeSubIdx);
+    p.pBlockDirtyMask[readBlockIdx] |= ((uint64_t)1 << readSubIdx);
     lsAssert(writeBlockIdx * p.BlockSize + writeSubIdx == touched);
 
     if (func)
@@ -791,6 +868,8 @@ lsResult pool_compact(pool<T, multiBlockAllocCount> &p, const std::function<lsRe
     new (&p.ppBlocks[writeBlockIdx][writeSubIdx]) T(std::move(p.ppBlocks[readBlockIdx][readSubIdx]));
     p.pBlockEmptyMask[writeBlockIdx] |= ((uint64_t)1 << writeSubIdx);
     p.pBlockEmptyMask[readBlockIdx] &= ~((uint64_t)1 << readSubIdx);
+    p.pBlockDirtyMask[writeBlockIdx] |= ((uint64_t)1 << writeSubIdx);
+    p.pBlockDirtyMask[readBlockIdx] |= ((uint64_t)1 << readSubIdx);
     lsAssert(writeBlockIdx * p.BlockSize + writeSubIdx == touched);
 
     if (func)
@@ -0,0 +1,254 @@
+#include "push.h"
+
+#include "pool.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//////////////////////////////////////////////////////////////////////////
+
+struct push_connection
+{
+  size_t userId;
+  uint32_t sessionId;
+  push_target target;
+  std::shared_ptr<const schedule_blob> queue[PushQueueCapacity]; // ring buffer.
+  size_t queueStart = 0;
+  size_t queueCount = 0;
+  size_t droppedCount = 0;
+  uint64_t lastEtag = 0;
+  bool hasQueued = false; // `lastEtag` is valid.
+  bool isClosing = false;
+  bool isCloseRequested = false;
+};
+
+// Sends happen while holding `_PushLock`, so connections can't unregister in between. They only hand the message to the connection's io thread.
+static std::mutex _PushLock;
+static std::condition_variable _PushCondition;
+static std::thread *_pPushThread = nullptr;
+static bool _PushIsRunning = false;
+static bool _PushHasWork = false;
+static pool<push_connection> _PushConnections;
+
+//////////////////////////////////////////////////////////////////////////
+
+void push_enqueue(push_connection *pConnection, const std::shared_ptr<const schedule_blob> &blob) // Assumes `_PushLock`.
+{
+  if (pConnection->isClosing || (pConnection->hasQueued && pConnection->lastEtag == blob->etag))
+    return;
+
+  if (pConnection->queueCount == PushQueueCapacity)
+  {
+    // Superseded by the newer schedules behind it.
+    pConnection->queue[pConnection->queueStart].reset();
+    pConnection->queueStart = (pConnection->queueStart + 1) % PushQueueCapacity;
+    pConnection->queueCount--;
+    pConnection->droppedCount++;
+  }
+
+  pConnection->queue[(pConnection->queueStart + pConnection->queueCount) % PushQueueCapacity] = blob;
+  pConnection->queueCount++;
+  pConnection->lastEtag = blob->etag;
+  pConnection->hasQueued = true;
+
+  _PushHasWork = true;
+}
+
+void push_thread()
+{
+  constexpr char MessagePrefix[] = "{\"schedule\":";
+  constexpr char MessageSuffix[] = "}";
+
+  std::unique_lock lock(_PushLock);
+
+  while (true)
+  {
+    _PushCondition.wait(lock, [] { return _PushHasWork || !_PushIsRunning; });
+
+    if (!_PushIsRunning)
+      return;
+
+    _PushHasWork = false;
+
+    for (auto &&_item : _PushConnections)
+    {
+      push_connection *pConnection = _item.pItem;
+
+      if (pConnection->isClosing)
+      {
+        if (!pConnection->isCloseRequested)
+        {
+          pConnection->isCloseRequested = true;
+          pConnection->target.close();
+        }
+
+        continue;
+      }
+
+      while (pConnection->queueCount > 0)
+      {
+        const std::shared_ptr<const schedule_blob> blob = std::move(pConnection->queue[pConnection->queueStart]);
+        pConnection->queueStart = (pConnection->queueStart + 1) % PushQueueCapacity;
+        pConnection->queueCount--;
+
+        std::string message;
+        message.reserve(LS_ARRAYSIZE(MessagePrefix) - 1 + blob->json.size() + LS_ARRAYSIZE(MessageSuffix) - 1);
+        message.append(MessagePrefix);
+        message.append(blob->json);
+        message.append(MessageSuffix);
+
+        pConnection->target.send(std::move(message));
+      }
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult push_start()
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(_pPushThread != nullptr, lsR_ResourceStateInvalid);
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_PushLock);
+
+    _PushIsRunning = true;
+  }
+
+  _pPushThread = new std::thread(push_thread);
+
+epilogue:
+  return result;
+}
+
+void push_stop()
+{
+  if (_pPushThread == nullptr)
+    return;
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_PushLock);
+
+    _PushIsRunning = false;
+  }
+
+  _PushCondition.notify_all();
+
+  _pPushThread->join();
+  delete _pPushThread;
+  _pPushThread = nullptr;
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_PushLock);
+
+    pool_clear(&_PushConnections);
+  }
+}
+
+lsResult push_register(const size_t userId, const uint32_t sessionId, push_target &&target, _Out_ size_t *pConnectionId)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pConnectionId == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(!target.send || !target.close, lsR_InvalidParameter);
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_PushLock);
+
+    LS_ERROR_IF(!_PushIsRunning, lsR_ResourceStateInvalid);
+
+    push_connection connection;
+    connection.userId = userId;
+    connection.sessionId = sessionId;
+    connection.target = std::move(target);
+
+    LS_ERROR_CHECK(pool_add(&_PushConnections, std::move(connection), pConnectionId));
+  }
+
+epilogue:
+  return result;
+}
+
+void push_unregister(const size_t connectionId)
+{
+  std::scoped_lock lock(_PushLock);
+
+  push_connection connection;
+
+  if (LS_SUCCESS(pool_remove_safe(&_PushConnections, connectionId, &connection)) && connection.droppedCount > 0)
+    print_log_line("Push: dropped ", connection.droppedCount, " schedule update(s) for user ", connection.userId, " that didn't keep up.");
+}
+
+void push_initial_schedule(const size_t connectionId, const std::shared_ptr<const schedule_blob> &blob)
+{
+  // Scope Lock
+  {
+    std::scoped_lock lock(_PushLock);
+
+    if (!pool_has(_PushConnections, connectionId))
+      return;
+
+    push_connection *pConnection = pool_get(&_PushConnections, connectionId);
+
+    // Anything queued since registering is at least as recent.
+    if (pConnection->hasQueued)
+      return;
+
+    push_enqueue(pConnection, blob);
+  }
+
+  _PushCondition.notify_one();
+}
+
+void push_schedule(const size_t userId, const std::shared_ptr<const schedule_blob> &blob)
+{
+  bool hasQueued = false;
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_PushLock);
+
+    for (auto &&_item : _PushConnections)
+    {
+      if (_item.pItem->userId == userId)
+      {
+        push_enqueue(_item.pItem, blob);
+        hasQueued = true;
+      }
+    }
+  }
+
+  if (hasQueued)
+    _PushCondition.notify_one();
+}
+
+void push_close_session(const uint32_t sessionId)
+{
+  bool hasClosed = false;
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_PushLock);
+
+    for (auto &&_item : _PushConnections)
+    {
+      if (_item.pItem->sessionId == sessionId && !_item.pItem->isClosing)
+      {
+        _item.pItem->isClosing = true;
+        hasClosed = true;
+      }
+    }
+
+    _PushHasWork |= hasClosed;
+  }
+
+  if (hasClosed)
+    _PushCondition.notify_one();
+}
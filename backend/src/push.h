@@ -0,0 +1,32 @@
+#pragma once
+
+#include "core.h"
+#include "schedd.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////
+
+// Delivers schedule updates to the live connections (websockets) of a user on a dedicated thread, so the code changing a schedule never waits on a client.
+// Every connection has a bounded queue: a client that falls behind loses its oldest updates. Each update holds the whole schedule, so the newest one always suffices.
+
+constexpr size_t PushQueueCapacity = 4;
+
+// Called on the push thread, only while the connection is registered.
+struct push_target
+{
+  std::function<void(std::string &&message)> send;
+  std::function<void()> close;
+};
+
+lsResult push_start();
+void push_stop();
+
+lsResult push_register(const size_t userId, const uint32_t sessionId, push_target &&target, _Out_ size_t *pConnectionId);
+void push_unregister(const size_t connectionId); // `target` isn't called anymore once this returns.
+void push_initial_schedule(const size_t connectionId, const std::shared_ptr<const schedule_blob> &blob); // Dropped if an update has already been queued after registering.
+
+void push_schedule(const size_t userId, const std::shared_ptr<const schedule_blob> &blob); // Queues the schedule on all connections of the user, unless it's unchanged.
+void push_close_session(const uint32_t sessionId);
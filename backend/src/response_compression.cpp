@@ -0,0 +1,193 @@
+#include "response_compression.h"
+
+#ifdef SCHEDD_ZLIB
+#include <zlib.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+#ifdef SCHEDD_ZLIB
+constexpr int32_t ResponseCompressionWindowBits = 15;
+constexpr int32_t ResponseCompressionGzipWindowBits = ResponseCompressionWindowBits + 16; // zlib writes a gzip header & trailer instead of its own.
+constexpr int32_t ResponseCompressionMemLevel = 8;
+
+static_assert(ResponseCompressionLevel == Z_BEST_SPEED && ResponseCompressionMaxLevel == Z_BEST_COMPRESSION);
+
+struct response_deflate_state
+{
+  z_stream stream = {};
+  int32_t level = 0;
+  bool isInitialized = false;
+
+  ~response_deflate_state()
+  {
+    if (isInitialized)
+      deflateEnd(&stream);
+  }
+};
+
+static thread_local response_deflate_state _ResponseDeflateStates[2]; // index: `encoding - re_Gzip`.
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+static bool _MatchesTokenCaseInsensitive(const char *token, const size_t length, const char *name)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    const char c = (token[i] >= 'A' && token[i] <= 'Z') ? (char)(token[i] - 'A' + 'a') : token[i];
+
+    if (name[i] == '\0' || name[i] != c)
+      return false;
+  }
+
+  return name[length] == '\0';
+}
+
+// Parses the parameters of one entry up to the next `,`, only `q` is of interest.
+static bool _IsExcluded(const char *params, const size_t length)
+{
+  for (size_t i = 0; i + 1 < length; i++)
+  {
+    if ((params[i] != 'q' && params[i] != 'Q') || params[i + 1] != '=' || (i > 0 && params[i - 1] != ';' && params[i - 1] != ' ' && params[i - 1] != '\t'))
+      continue;
+
+    size_t j = i + 2;
+
+    if (j >= length || params[j] != '0')
+      return false;
+
+    j++;
+
+    if (j < length && params[j] == '.')
+      j++;
+
+    while (j < length && params[j] == '0')
+      j++;
+
+    return j == length || params[j] == ' ' || params[j] == '\t' || params[j] == ';';
+  }
+
+  return false;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+response_encoding response_encoding_negotiate(const char *acceptEncoding)
+{
+#ifdef SCHEDD_ZLIB
+  enum { Unlisted, Accepted, Excluded } gzip = Unlisted, deflate = Unlisted, wildcard = Unlisted;
+
+  if (acceptEncoding == nullptr)
+    return re_Identity;
+
+  const char *entry = acceptEncoding;
+
+  while (*entry != '\0')
+  {
+    while (*entry == ' ' || *entry == '\t' || *entry == ',')
+      entry++;
+
+    size_t nameLength = 0;
+
+    while (entry[nameLength] != '\0' && entry[nameLength] != ',' && entry[nameLength] != ';' && entry[nameLength] != ' ' && entry[nameLength] != '\t')
+      nameLength++;
+
+    size_t entryLength = nameLength;
+
+    while (entry[entryLength] != '\0' && entry[entryLength] != ',')
+      entryLength++;
+
+    const auto state = _IsExcluded(entry + nameLength, entryLength - nameLength) ? Excluded : Accepted;
+
+    if (_MatchesTokenCaseInsensitive(entry, nameLength, "gzip") || _MatchesTokenCaseInsensitive(entry, nameLength, "x-gzip"))
+      gzip = state;
+    else if (_MatchesTokenCaseInsensitive(entry, nameLength, "deflate"))
+      deflate = state;
+    else if (nameLength == 1 && entry[0] == '*')
+      wildcard = state;
+
+    entry += entryLength;
+  }
+
+  if (gzip == Accepted || (gzip == Unlisted && wildcard == Accepted))
+    return re_Gzip;
+
+  if (deflate == Accepted || (deflate == Unlisted && wildcard == Accepted))
+    return re_Deflate;
+#else
+  (void)acceptEncoding;
+#endif
+
+  return re_Identity;
+}
+
+const char *response_encoding_name(const response_encoding encoding)
+{
+  switch (encoding)
+  {
+  case re_Gzip: return "gzip";
+  case re_Deflate: return "deflate";
+  default: return "identity";
+  }
+}
+
+lsResult response_compress(const response_encoding encoding, const char *pData, const size_t size, _Out_ std::string *pCompressed, const int32_t level)
+{
+  lsResult result = lsR_Success;
+
+#ifdef SCHEDD_ZLIB
+  response_deflate_state *pState = nullptr;
+  size_t bound;
+  int32_t status;
+
+  LS_ERROR_IF(pData == nullptr || pCompressed == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(encoding != re_Gzip && encoding != re_Deflate, lsR_InvalidParameter);
+  LS_ERROR_IF(size > (uInt)-1, lsR_ArgumentOutOfBounds);
+  LS_ERROR_IF(level < Z_BEST_SPEED || level > Z_BEST_COMPRESSION, lsR_InvalidParameter);
+
+  pState = &_ResponseDeflateStates[encoding - re_Gzip];
+
+  if (!pState->isInitialized)
+  {
+    LS_ERROR_IF(deflateInit2(&pState->stream, level, Z_DEFLATED, encoding == re_Gzip ? ResponseCompressionGzipWindowBits : ResponseCompressionWindowBits, ResponseCompressionMemLevel, Z_DEFAULT_STRATEGY) != Z_OK, lsR_InternalError);
+    pState->level = level;
+    pState->isInitialized = true;
+  }
+  else
+  {
+    LS_ERROR_IF(deflateReset(&pState->stream) != Z_OK, lsR_InternalError);
+
+    if (pState->level != level) // nothing has been compressed since the reset, so this doesn't flush anything.
+    {
+      LS_ERROR_IF(deflateParams(&pState->stream, level, Z_DEFAULT_STRATEGY) != Z_OK, lsR_InternalError);
+      pState->level = level;
+    }
+  }
+
+  bound = deflateBound(&pState->stream, (uLong)size);
+  pCompressed->resize(bound);
+
+  pState->stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(pData));
+  pState->stream.avail_in = (uInt)size;
+  pState->stream.next_out = reinterpret_cast<Bytef *>(pCompressed->data());
+  pState->stream.avail_out = (uInt)bound;
+
+  status = deflate(&pState->stream, Z_FINISH);
+  LS_ERROR_IF(status != Z_STREAM_END, lsR_InternalError);
+  LS_SILENT_ERROR_IF(pState->stream.total_out >= size, lsR_ResourceInsufficient); // not worth logging, the body is sent as it is.
+
+  pCompressed->resize(pState->stream.total_out);
+#else
+  (void)encoding;
+  (void)pData;
+  (void)size;
+  (void)pCompressed;
+  (void)level;
+
+  LS_ERROR_SET(lsR_NotSupported);
+#endif
+
+epilogue:
+  return result;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "core.h"
+
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////
+
+// Compresses response bodies in the encoding the client accepts. Small bodies aren't worth it: they already fit in a packet & would pay the header overhead for nothing.
+// Every thread keeps its deflate state per encoding & resets it between responses, so the window & hash tables are allocated once instead of for every response.
+
+constexpr size_t ResponseCompressionMinBytes = 1024; // bodies below this are sent as they are.
+constexpr int32_t ResponseCompressionLevel = 1; // zlib's fastest, JSON compresses almost as well as on the default level at a third to half the CPU time (see `bench_response_compression`).
+constexpr int32_t ResponseCompressionMaxLevel = 9; // for bodies that are compressed once & sent many times.
+
+enum response_encoding
+{
+  re_Identity,
+  re_Gzip,
+  re_Deflate, // zlib wrapped, as HTTP's `deflate` is specified.
+};
+
+response_encoding response_encoding_negotiate(const char *acceptEncoding); // Picks from an `Accept-Encoding` header, preferring gzip. Encodings with `q=0` are excluded.
+const char *response_encoding_name(const response_encoding encoding); // the `Content-Encoding` token.
+
+lsResult response_compress(const response_encoding encoding, const char *pData, const size_t size, _Out_ std::string *pCompressed, const int32_t level = ResponseCompressionLevel); // `lsR_ResourceInsufficient` if the result wouldn't be smaller.
@@ -1,6 +1,8 @@
 #include "schedd.h"
+#include "journal.h"
+#include "json_writer.h"
+#include "push.h"
 
-#include <mutex>
 #include <time.h>
 
 std::atomic<size_t> _UserDataEpoch = 0;
@@ -10,8 +12,15 @@ std::atomic<size_t> _ExplicitlyRequestsRescheduleEpoch = 0;
 pool<user> _Users;
 pool<event> _Events;
 
-static std::mutex _ThreadLock;
+std::mutex _ThreadLock;
 static pool<user_id_info> _SessionIdToUserId;
+static pool<small_list<size_t>> _EventIdsByUser; // index: userId, values: ids of the events the user participates in.
+
+// Assume mutex lock.
+static size_t _ScheduleDay = ScheduleDayNone;
+static time_point_t _ScheduleComputedTime = 0;
+static size_t _ScheduleUserDataEpoch = 0; // the data epochs the schedules were computed for.
+static size_t _ScheduleEventDataEpoch = 0;
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -40,42 +49,97 @@ struct time_info
   time_point_t time;
 };
 
-uint64_t get_score_for_event(const event evnt);
+uint64_t get_score_for_event(const event &evnt);
 time_info get_current_day_and_time();
 
+lsResult add_event_id_for_user(const size_t userId, const size_t eventId); // Assumes mutex lock
+void remove_event_id_for_user(const size_t userId, const size_t eventId); // Assumes mutex lock
+
+bool has_schedule_blob(const size_t userId); // Assumes mutex lock
+void update_schedule_blob(const size_t userId); // Assumes mutex lock
+void clear_schedule_blobs(); // Assumes mutex lock
+
+//////////////////////////////////////////////////////////////////////////
+
+enum search_scope : uint8_t
+{
+  ss_Events,
+  ss_EventsOfUser,
+  ss_Users,
+};
+
+constexpr size_t SearchCacheShardCount = 8;
+constexpr size_t SearchCacheEntriesPerShard = 16;
+constexpr size_t SearchCacheMaxQueryLength = 64;
+constexpr size_t SearchCacheMaxResults = MaxSearchResults; // larger result sets aren't cached, so cached ones are complete & prefixes can be refined.
+
+struct search_cache_entry
+{
+  char query[SearchCacheMaxQueryLength];
+  size_t queryLength;
+  search_scope scope;
+  size_t userId;
+  size_t epoch; // the entry is stale once the data epoch of its scope moved on.
+  uint64_t lastUsed;
+  local_list<size_t, SearchCacheMaxResults> ids;
+};
+
+// Sharded by scope & user, so all queries of one user (and their prefixes) end up in the same shard.
+struct search_cache_shard
+{
+  std::mutex lock;
+  uint64_t lastUsed = 0;
+  local_list<search_cache_entry, SearchCacheEntriesPerShard> entries;
+};
+
+static search_cache_shard _SearchCache[SearchCacheShardCount];
+
+bool search_cache_find(const search_scope scope, const size_t userId, const char *query, const size_t queryLength, const size_t epoch, _Out_ small_list<size_t, SearchCacheMaxResults> *pIds, _Out_ bool *pIsExactMatch);
+void search_cache_store(const search_scope scope, const size_t userId, const char *query, const size_t queryLength, const size_t epoch, const small_list<size_t, SearchCacheMaxResults> &ids);
+
 //////////////////////////////////////////////////////////////////////////
 
+template <size_t InternalCount>
+bool event_ids_equal(const small_list<size_t, InternalCount> &a, const small_list<size_t, InternalCount> &b)
+{
+  if (a.count != b.count)
+    return false;
+
+  for (size_t i = 0; i < a.count; i++)
+    if (a[i] != b[i])
+      return false;
+
+  return true;
+}
+
 lsResult reschedule_events_for_user(const size_t userId) // Assumes mutex lock
 {
   lsResult result = lsR_Success;
 
-  small_list<sortable_event, 128> userEvents;
+  small_list<sortable_event, 32> userEvents;
   const time_info time = get_current_day_and_time();
   weekday_flags today = get_hours_since_midnight() > 2 ? (weekday_flags)(1 << time.dayIndex) : (weekday_flags)(1 << lsMin(time.dayIndex - 1, 6)); // TODO: CHECK IF CORRECT! // adjusting weekday to refelct the 2am mark for rescheduling (new day only after 2am)
+  time_span_t freeTime = 0; // needs to be initialized before `LS_ERROR_IF`.
+  small_list<size_t, InlineEventsPerUserPerDay> previousTasks;
+  small_list<size_t, InlineEventsPerUserPerDay> previousTooLongTasks;
 
-  for (const auto &&_evnt : _Events)
+  user *pUser = pool_get(&_Users, userId);
+  LS_ERROR_IF(pUser == nullptr, lsR_ResourceNotFound);
+
+  if (pool_has(_EventIdsByUser, userId))
   {
-    // Is Event executable on current weekday?
-    if (_evnt.pItem->possibleExecutionDays & today)
+    for (const size_t eventId : *pool_get(&_EventIdsByUser, userId))
     {
-      // Is event due today?
-      if (_evnt.pItem->lastCompletedTime + _evnt.pItem->repetitionTimeSpan - time_span_from_days(1) <= time.time || _evnt.pItem->lastCompletedTime == 0)
-      {
-        // Is User Participating in Event?
-        bool foundUserId = false;
-        for (const auto &uId : _evnt.pItem->userIds)
-        {
-          if (userId == uId)
-          {
-            foundUserId = true;
-            break;
-          }
-        }
+      const event *pEvent = pool_get(&_Events, eventId);
 
-        if (foundUserId)
+      // Is Event executable on current weekday?
+      if (pEvent->possibleExecutionDays & today)
+      {
+        // Is event due today?
+        if (pEvent->lastCompletedTime + pEvent->repetitionTimeSpan - time_span_from_days(1) <= time.time || pEvent->lastCompletedTime == 0)
         {
-          const auto score = get_score_for_event(*_evnt.pItem);
-          LS_DEBUG_ERROR_ASSERT(list_add(&userEvents, sortable_event(_evnt.index, score)));
+          const auto score = get_score_for_event(*pEvent);
+          LS_ERROR_CHECK(list_add(&userEvents, sortable_event(eventId, score)));
         }
       }
     }
@@ -84,19 +148,14 @@ lsResult reschedule_events_for_user(const size_t userId) // Assumes mutex lock
   list_sort_descending(userEvents);
 
   // Pick.
-  time_span_t freeTime = 0; // needs to be initialized before `LS_ERROR_IF`.
-
   // TODO: Make scheduling smarter
-  
-  user *pUser = pool_get(&_Users, userId);
-  LS_ERROR_IF(pUser == nullptr, lsR_ResourceNotFound);
 
-  list_clear(&pUser->tasksForCurrentDay);
-  list_clear(&pUser->tooLongTasksForCurrentDay);
+  previousTasks = std::move(pUser->tasksForCurrentDay);
+  previousTooLongTasks = std::move(pUser->tooLongTasksForCurrentDay);
 
   freeTime = pUser->availableTimePerDay[time.dayIndex];
 
-  if (freeTime >= 0 && pUser->tasksForCurrentDay.capacity() > 0)
+  if (freeTime >= 0)
   {
     for (const auto &_sortable_event : userEvents)
     {
@@ -106,25 +165,91 @@ lsResult reschedule_events_for_user(const size_t userId) // Assumes mutex lock
       if (pEvent->durationTimeSpan > freeTime)
       {
         // TODO: maybe don't add all tasks like this, but have a better check for urgency!
-        LS_DEBUG_ERROR_ASSERT(list_add(&pUser->tooLongTasksForCurrentDay, _sortable_event.event_id));
+        LS_ERROR_CHECK(list_add(&pUser->tooLongTasksForCurrentDay, _sortable_event.event_id));
         continue;
       }
 
-      LS_DEBUG_ERROR_ASSERT(list_add(&pUser->tasksForCurrentDay, _sortable_event.event_id));
+      LS_ERROR_CHECK(list_add(&pUser->tasksForCurrentDay, _sortable_event.event_id));
       freeTime -= pEvent->durationTimeSpan;
      
       lsAssert(freeTime >= 0);
 
-      if (freeTime <= 0 || pUser->tasksForCurrentDay.count == pUser->tasksForCurrentDay.capacity())
+      if (freeTime <= 0)
         break;
     }
   }
 
 epilogue:
+  // Only changed schedules need to be written to the snapshot & rendered again.
+  if (pUser != nullptr)
+  {
+    const bool hasChanged = !event_ids_equal(previousTasks, pUser->tasksForCurrentDay) || !event_ids_equal(previousTooLongTasks, pUser->tooLongTasksForCurrentDay);
+
+    if (hasChanged)
+      pool_mark_dirty(&_Users, userId);
+
+    if (hasChanged || !has_schedule_blob(userId))
+      update_schedule_blob(userId);
+  }
+
   return result;
 }
 
-uint64_t get_score_for_event(const event evnt)
+void reschedule_all_users(const size_t day) // Assumes mutex lock
+{
+  bool isComplete = true;
+
+  for (const auto &&_item : _Users)
+  {
+    if (LS_FAILED(reschedule_events_for_user(_item.index)))
+    {
+      print_error_line("Failed to reschedule events for userId: ", _item.index);
+      isComplete = false;
+    }
+  }
+
+  // Data changes bump the epochs while holding the mutex, so these match the data the schedules were computed from.
+  _ScheduleDay = isComplete ? day : ScheduleDayNone;
+  _ScheduleComputedTime = get_current_time();
+  _ScheduleUserDataEpoch = _UserDataEpoch;
+  _ScheduleEventDataEpoch = _EventDataEpoch;
+}
+
+void get_schedule_day(_Out_ size_t *pDay, _Out_ time_point_t *pComputedTime) // Assumes mutex lock
+{
+  const bool isCurrent = _UserDataEpoch == _ScheduleUserDataEpoch && _EventDataEpoch == _ScheduleEventDataEpoch;
+
+  *pDay = isCurrent ? _ScheduleDay : ScheduleDayNone;
+  *pComputedTime = isCurrent ? _ScheduleComputedTime : 0;
+}
+
+void restore_schedule_day(const size_t day, const time_point_t computedTime) // Assumes mutex lock
+{
+  _ScheduleDay = day;
+  _ScheduleComputedTime = computedTime;
+  _ScheduleUserDataEpoch = _UserDataEpoch;
+  _ScheduleEventDataEpoch = _EventDataEpoch;
+}
+
+bool schedules_are_current(const size_t day)
+{
+  size_t scheduleDay;
+  time_point_t computedTime;
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_ThreadLock);
+
+    get_schedule_day(&scheduleDay, &computedTime);
+  }
+
+  // The day of the year repeats, so the schedules must also be less than a day old.
+  const time_point_t now = get_current_time();
+
+  return scheduleDay != ScheduleDayNone && scheduleDay == day && computedTime <= now && (time_span_t)(now - computedTime) < time_span_from_days(1);
+}
+
+uint64_t get_score_for_event(const event &evnt)
 {
   // pretend it won't be executed today...
 
@@ -160,12 +285,324 @@ uint64_t get_score_for_event(const event evnt)
   return evnt.weight + dueTimePeriodCount * evnt.weightGrowthFactor;
 }
 
+lsResult add_event_id_for_user(const size_t userId, const size_t eventId) // Assumes mutex lock
+{
+  lsResult result = lsR_Success;
+
+  // Event participants aren't validated on creation, so ids of users that don't exist (yet) are ignored here and picked up by `add_new_user`.
+  if (!pool_has(_Users, userId))
+    goto epilogue;
+
+  if (!pool_has(_EventIdsByUser, userId))
+    LS_ERROR_CHECK(pool_insertAt(&_EventIdsByUser, small_list<size_t>(), userId));
+
+  {
+    small_list<size_t> *pEventIds = pool_get(&_EventIdsByUser, userId);
+
+    if (list_contains(pEventIds, eventId) == nullptr)
+      LS_ERROR_CHECK(list_add(pEventIds, eventId));
+  }
+
+epilogue:
+  return result;
+}
+
+void remove_event_id_for_user(const size_t userId, const size_t eventId) // Assumes mutex lock
+{
+  if (!pool_has(_EventIdsByUser, userId))
+    return;
+
+  list_remove_element(*pool_get(&_EventIdsByUser, userId), eventId);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+inline search_cache_shard &search_cache_get_shard(const search_scope scope, const size_t userId)
+{
+  return _SearchCache[(hash((uint64_t)userId) + scope) % SearchCacheShardCount];
+}
+
+bool search_cache_find(const search_scope scope, const size_t userId, const char *query, const size_t queryLength, const size_t epoch, _Out_ small_list<size_t, SearchCacheMaxResults> *pIds, _Out_ bool *pIsExactMatch)
+{
+  search_cache_shard &shard = search_cache_get_shard(scope, userId);
+  std::scoped_lock lock(shard.lock);
+
+  search_cache_entry *pBestPrefix = nullptr;
+
+  for (auto &_entry : shard.entries)
+  {
+    if (_entry.scope != scope || _entry.userId != userId || _entry.epoch != epoch || _entry.queryLength > queryLength)
+      continue;
+
+    if (memcmp(_entry.query, query, _entry.queryLength) != 0)
+      continue;
+
+    if (_entry.queryLength == queryLength)
+    {
+      _entry.lastUsed = ++shard.lastUsed;
+      *pIsExactMatch = true;
+
+      for (const size_t id : _entry.ids)
+        list_add(pIds, id); // can't fail, `pIds` stores `SearchCacheMaxResults` ids inline.
+
+      return true;
+    }
+
+    // Every match of `query` also contains the cached prefix, so the result set of the prefix can be narrowed down instead of scanning again.
+    if (pBestPrefix == nullptr || pBestPrefix->queryLength < _entry.queryLength)
+      pBestPrefix = &_entry;
+  }
+
+  if (pBestPrefix == nullptr)
+    return false;
+
+  pBestPrefix->lastUsed = ++shard.lastUsed;
+  *pIsExactMatch = false;
+
+  for (const size_t id : pBestPrefix->ids)
+    list_add(pIds, id); // can't fail, `pIds` stores `SearchCacheMaxResults` ids inline.
+
+  return true;
+}
+
+void search_cache_store(const search_scope scope, const size_t userId, const char *query, const size_t queryLength, const size_t epoch, const small_list<size_t, SearchCacheMaxResults> &ids)
+{
+  if (queryLength >= SearchCacheMaxQueryLength || ids.count > SearchCacheMaxResults)
+    return;
+
+  search_cache_shard &shard = search_cache_get_shard(scope, userId);
+  std::scoped_lock lock(shard.lock);
+
+  search_cache_entry *pEntry = nullptr;
+
+  for (auto &_entry : shard.entries)
+  {
+    if (_entry.scope == scope && _entry.userId == userId && _entry.queryLength == queryLength && memcmp(_entry.query, query, queryLength) == 0)
+    {
+      pEntry = &_entry;
+      break;
+    }
+  }
+
+  if (pEntry == nullptr)
+  {
+    if (shard.entries.count < shard.entries.capacity())
+    {
+      if (LS_FAILED(list_add(&shard.entries, search_cache_entry())))
+        return;
+
+      pEntry = &shard.entries[shard.entries.count - 1];
+    }
+    else
+    {
+      // Evict the least recently used entry.
+      pEntry = &shard.entries[0];
+
+      for (auto &_entry : shard.entries)
+        if (_entry.lastUsed < pEntry->lastUsed)
+          pEntry = &_entry;
+    }
+  }
+
+  memcpy(pEntry->query, query, queryLength);
+  pEntry->query[queryLength] = '\0';
+  pEntry->queryLength = queryLength;
+  pEntry->scope = scope;
+  pEntry->userId = userId;
+  pEntry->epoch = epoch;
+  pEntry->lastUsed = ++shard.lastUsed;
+  list_clear(&pEntry->ids);
+
+  for (const size_t id : ids)
+    list_add(&pEntry->ids, id); // can't fail, `ids.count` has been checked.
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+inline event_info event_info_from_event(const size_t eventId, const event &evnt)
+{
+  event_info info;
+  info.id = eventId;
+  info.durationInMinutes = minutes_from_time_span(evnt.durationTimeSpan);
+  info.name = arena_string_get(evnt.name);
+  info.nameLength = arena_string_length(evnt.name);
+  info.isCompleted = false;
+
+  return info;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+uint64_t get_event_etag(const event &evnt)
+{
+  const uint64_t fields[] = { (uint64_t)evnt.durationTimeSpan, evnt.weight, evnt.weightGrowthFactor, (uint64_t)evnt.possibleExecutionDays, (uint64_t)evnt.repetitionTimeSpan, evnt.userIds.count };
+
+  uint64_t hash = etag_hash(arena_string_get(evnt.name), arena_string_length(evnt.name));
+  hash = etag_hash(fields, sizeof(fields), hash);
+
+  // User names can't change, so the ids cover the participants.
+  for (const size_t userId : evnt.userIds)
+    hash = etag_hash(&userId, sizeof(userId), hash);
+
+  return hash;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// `/user-schedule` responses, rendered once whenever the schedule or the completions of a user change.
+// Readers only take `_ScheduleBlobLock` & share the immutable buffer. Blobs are stored & dropped while holding `_ThreadLock` as well, so they never outlive the data they were rendered from.
+constexpr size_t ScheduleBlobBufferSize = 1024;
+
+static std::mutex _ScheduleBlobLock;
+static pool<std::shared_ptr<const schedule_blob>> _ScheduleBlobs; // index: userId.
+
+lsResult write_schedule_tasks(json_writer *pWriter, const char *key, const user &usr, const small_list<size_t, InlineEventsPerUserPerDay> &eventIds) // Assumes mutex lock
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(json_writer_key(pWriter, key));
+  LS_ERROR_CHECK(json_writer_begin_array(pWriter));
+
+  for (const size_t eventId : eventIds)
+  {
+    const event *pEvent = pool_get(&_Events, eventId);
+    LS_ERROR_IF(pEvent == nullptr, lsR_ResourceNotFound);
+
+    const event_info info = event_info_from_event(eventId, *pEvent);
+
+    LS_ERROR_CHECK(json_writer_begin_object(pWriter));
+    LS_ERROR_CHECK(json_writer_key(pWriter, "name"));
+    LS_ERROR_CHECK(json_writer_string(pWriter, info.name, info.nameLength));
+    LS_ERROR_CHECK(json_writer_key(pWriter, "duration"));
+    LS_ERROR_CHECK(json_writer_uint(pWriter, info.durationInMinutes));
+    LS_ERROR_CHECK(json_writer_key(pWriter, "id"));
+    LS_ERROR_CHECK(json_writer_uint(pWriter, info.id));
+    LS_ERROR_CHECK(json_writer_key(pWriter, "isCompleted"));
+    LS_ERROR_CHECK(json_writer_bool(pWriter, list_contains(usr.completedTasksForCurrentDay, eventId) != nullptr));
+    LS_ERROR_CHECK(json_writer_end_object(pWriter));
+  }
+
+  LS_ERROR_CHECK(json_writer_end_array(pWriter));
+
+epilogue:
+  return result;
+}
+
+lsResult render_schedule_blob(const size_t userId, _Out_ std::shared_ptr<const schedule_blob> *pBlob) // Assumes mutex lock
+{
+  lsResult result = lsR_Success;
+
+  std::string blob;
+  json_writer writer;
+
+  const user *pUser = pool_get(&_Users, userId);
+  LS_ERROR_IF(pUser == nullptr, lsR_ResourceNotFound);
+
+  LS_ERROR_CHECK(json_writer_create(&writer, [&blob](const char *pData, const size_t size) { blob.append(pData, size); return lsR_Success; }, ScheduleBlobBufferSize));
+
+  LS_ERROR_CHECK(json_writer_begin_object(&writer));
+  LS_ERROR_CHECK(write_schedule_tasks(&writer, "tasks", *pUser, pUser->tasksForCurrentDay));
+  LS_ERROR_CHECK(write_schedule_tasks(&writer, "long_tasks", *pUser, pUser->tooLongTasksForCurrentDay));
+  LS_ERROR_CHECK(json_writer_end_object(&writer));
+  LS_ERROR_CHECK(json_writer_flush(&writer));
+
+  {
+    const uint64_t etag = etag_hash(blob.data(), blob.size());
+    *pBlob = std::make_shared<const schedule_blob>(schedule_blob{ std::move(blob), etag });
+  }
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_ScheduleBlobLock);
+
+    LS_ERROR_CHECK(pool_insertAt(&_ScheduleBlobs, std::shared_ptr<const schedule_blob>(*pBlob), userId, true));
+  }
+
+epilogue:
+  json_writer_destroy(&writer);
+  return result;
+}
+
+bool has_schedule_blob(const size_t userId) // Assumes mutex lock
+{
+  std::scoped_lock lock(_ScheduleBlobLock);
+
+  return pool_has(_ScheduleBlobs, userId);
+}
+
+void update_schedule_blob(const size_t userId) // Assumes mutex lock
+{
+  std::shared_ptr<const schedule_blob> blob;
+
+  if (LS_SUCCESS(render_schedule_blob(userId, &blob)))
+  {
+    push_schedule(userId, blob);
+    return;
+  }
+
+  // Rendered again on the next request.
+  std::scoped_lock lock(_ScheduleBlobLock);
+
+  if (pool_has(_ScheduleBlobs, userId))
+    pool_remove_safe(&_ScheduleBlobs, userId);
+}
+
+void clear_schedule_blobs() // Assumes mutex lock
+{
+  std::scoped_lock lock(_ScheduleBlobLock);
+
+  pool_clear(&_ScheduleBlobs);
+}
+
+lsResult get_user_schedule_blob(const size_t userId, _Out_ std::shared_ptr<const schedule_blob> *pBlob)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pBlob == nullptr, lsR_ArgumentNull);
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_ScheduleBlobLock);
+
+    if (pool_has(_ScheduleBlobs, userId))
+    {
+      *pBlob = *pool_get(&_ScheduleBlobs, userId);
+      goto epilogue;
+    }
+  }
+
+  // Not rendered yet since the start, or dropped by a change.
+  // Scope Lock
+  {
+    std::scoped_lock lock(_ThreadLock);
+
+    LS_ERROR_CHECK(render_schedule_blob(userId, pBlob));
+  }
+
+epilogue:
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+inline user_info user_info_from_user(const size_t userId, const user &usr)
+{
+  user_info info;
+  info.id = userId;
+  info.name = arena_string_get(usr.username);
+  info.nameLength = arena_string_length(usr.username);
+
+  return info;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 lsResult assign_session_token(const char *username, _Out_ uint32_t *pOutSessionId)
 {
   lsResult result = lsR_Success;
 
+  const size_t usernameLength = strlen(username);
+
   // Scope Lock.
   {
     std::scoped_lock lock(_ThreadLock);
@@ -176,7 +613,7 @@ lsResult assign_session_token(const char *username, _Out_ uint32_t *pOutSessionI
     // iterate pool checking for username
     for (const auto &&_user : _Users)
     {
-      if (strncmp(_user.pItem->username, username, LS_ARRAYSIZE(_user.pItem->username)) == 0) // if name matches.
+      if (arena_string_equals(_user.pItem->username, username, usernameLength)) // if name matches.
       {
         userId = _user.index;
         userFound = true;
@@ -223,24 +660,35 @@ epilogue:
   return result;
 }
 
-lsResult add_new_user(const user usr)
+lsResult add_new_user(user &&usr)
 {
   lsResult result = lsR_Success;
 
+  uint64_t journalSequence = 0;
+
   // Scope Lock
   {
     std::scoped_lock lock(_ThreadLock);
 
-    size_t _unused;
-    LS_DEBUG_ERROR_ASSERT(pool_add(&_Users, usr, &_unused));
+    size_t userId;
+    LS_ERROR_CHECK(pool_add(&_Users, std::move(usr), &userId));
+    _UserDataEpoch++; // while locked, so the epoch never lags behind the data (see `reschedule_all_users`).
+
+    LS_ERROR_CHECK(journal_put_user(userId, *pool_get(&_Users, userId), &journalSequence));
+
+    // Pick up events that already list the new user id.
+    for (const auto &&_evnt : _Events)
+      if (list_contains(&_evnt.pItem->userIds, userId) != nullptr)
+        LS_ERROR_CHECK(add_event_id_for_user(userId, _evnt.index));
   }
 
-  _UserDataEpoch++;
+  LS_ERROR_CHECK(journal_wait(journalSequence));
 
+epilogue:
   return result;
 }
 
-lsResult get_user_info(const size_t userId, _Out_ user_info *pOutInfo)
+lsResult get_user_info(const size_t userId, const user_info_visitor &visitor)
 {
   lsResult result = lsR_Success;
 
@@ -251,8 +699,7 @@ lsResult get_user_info(const size_t userId, _Out_ user_info *pOutInfo)
     user *pUser = pool_get(&_Users, userId);
     LS_ERROR_IF(pUser == nullptr, lsR_ResourceNotFound);
 
-    pOutInfo->id = userId;
-    strncpy(pOutInfo->name, pUser->username, LS_ARRAYSIZE(pOutInfo->name));
+    visitor(user_info_from_user(userId, *pUser));
   }
 
 epilogue:
@@ -305,6 +752,8 @@ lsResult replace_available_time(const size_t userId, const local_list<time_span_
 {
   lsResult result = lsR_Success;
 
+  uint64_t journalSequence = 0;
+
   // Scope Lock
   {
     std::scoped_lock lock(_ThreadLock);
@@ -313,33 +762,45 @@ lsResult replace_available_time(const size_t userId, const local_list<time_span_
     LS_ERROR_IF(pUser == nullptr, lsR_ResourceNotFound);
 
     pUser->availableTimePerDay = availableTime;
+    pool_mark_dirty(&_Users, userId);
+    _UserDataEpoch++;
+
+    LS_ERROR_CHECK(journal_put_user(userId, *pUser, &journalSequence));
   }
 
-  _UserDataEpoch++;
+  LS_ERROR_CHECK(journal_wait(journalSequence));
 
 epilogue:
   return result;
 }
 
-lsResult add_new_event(event evnt)
+lsResult add_new_event(event &&evnt)
 {
   lsResult result = lsR_Success;
 
+  uint64_t journalSequence = 0;
+
   // Scope Lock
   {
     std::scoped_lock lock(_ThreadLock);
 
-    size_t _unused;
-    LS_ERROR_CHECK(pool_add(&_Events, evnt, &_unused));
+    size_t eventId;
+    LS_ERROR_CHECK(pool_add(&_Events, std::move(evnt), &eventId));
+    _EventDataEpoch++;
+
+    LS_ERROR_CHECK(journal_put_event(eventId, *pool_get(&_Events, eventId), &journalSequence));
+
+    for (const size_t userId : pool_get(&_Events, eventId)->userIds)
+      LS_ERROR_CHECK(add_event_id_for_user(userId, eventId));
   }
 
-  _EventDataEpoch++;
+  LS_ERROR_CHECK(journal_wait(journalSequence));
 
 epilogue:
   return result;
 }
 
-lsResult get_current_events_from_user_id(const size_t userId, _Out_ local_list<event_info, MaxEventsPerUserPerDay> *pOutCurrentEvents)
+lsResult get_completed_events_for_current_day(const size_t userId, const event_info_visitor &visitor)
 {
   lsResult result = lsR_Success;
 
@@ -350,27 +811,15 @@ lsResult get_current_events_from_user_id(const size_t userId, _Out_ local_list<e
     const user *pUser = pool_get(&_Users, userId);
     LS_ERROR_IF(pUser == nullptr, lsR_ResourceNotFound);
 
-    for (const size_t eventId : pUser->tasksForCurrentDay)
+    for (const size_t eventId : pUser->completedTasksForCurrentDay)
     {
-      event *pEvent = pool_get(&_Events, eventId);
+      const event *pEvent = pool_get(&_Events, eventId);
       LS_ERROR_IF(pEvent == nullptr, lsR_ResourceNotFound);
 
-      event_info info;
-      info.id = eventId;
-      strncpy(info.name, pEvent->name, LS_ARRAYSIZE(info.name));
-      info.durationInMinutes = minutes_from_time_span(pEvent->durationTimeSpan);
-      info.isCompleted = false;
+      event_info info = event_info_from_event(eventId, *pEvent);
+      info.isCompleted = true;
 
-      for (const size_t completedEventId : pUser->completedTasksForCurrentDay)
-      {
-        if (completedEventId == eventId)
-        {
-          info.isCompleted = true;
-          break;
-        }
-      }
-
-      LS_ERROR_CHECK(list_add(pOutCurrentEvents, info));
+      visitor(info);
     }
   }
 
@@ -378,211 +827,281 @@ epilogue:
   return result;
 }
 
-lsResult get_current_too_long_events_from_user_id(const size_t userId, _Out_ local_list<event_info, MaxEventsPerUserPerDay> *pOutCurrentEvents)
+lsResult update_task(const size_t id, event &&evnt) // creation time etc. of `evnt` will be updated to the old values.
 {
   lsResult result = lsR_Success;
 
+  uint64_t journalSequence = 0;
+  small_list<size_t, InlineUsersPerEvent> removedUserIds;
+
   // Scope Lock
   {
     std::scoped_lock lock(_ThreadLock);
 
-    const user *pUser = pool_get(&_Users, userId);
-    LS_ERROR_IF(pUser == nullptr, lsR_ResourceNotFound);
-
-    for (const size_t eventId : pUser->tooLongTasksForCurrentDay)
-    {
-      event *pEvent = pool_get(&_Events, eventId);
-      LS_ERROR_IF(pEvent == nullptr, lsR_ResourceNotFound);
+    event *pStoredEvent = nullptr;
+    LS_ERROR_CHECK(pool_get_safe(&_Events, id, &pStoredEvent));
 
-      event_info info;
-      info.id = eventId;
-      strncpy(info.name, pEvent->name, LS_ARRAYSIZE(info.name));
-      info.durationInMinutes = minutes_from_time_span(pEvent->durationTimeSpan);
-      info.isCompleted = false;
+    evnt.creationTime = pStoredEvent->creationTime;
+    evnt.lastCompletedTime = pStoredEvent->lastCompletedTime;
+    evnt.lastModifiedTime = get_current_time();
 
-      for (const size_t completedEventId : pUser->completedTasksForCurrentDay)
+    for (const size_t userId : pStoredEvent->userIds)
+    {
+      if (list_contains(&evnt.userIds, userId) == nullptr)
       {
-        if (completedEventId == eventId)
-        {
-          info.isCompleted = true;
-          break;
-        }
+        remove_event_id_for_user(userId, id);
+        LS_ERROR_CHECK(list_add(&removedUserIds, userId));
       }
-
-      LS_ERROR_CHECK(list_add(pOutCurrentEvents, info));
     }
-  }
-
-epilogue:
-  return result;
-}
 
-lsResult get_completed_events_for_current_day(const size_t userId, _Out_ local_list<event_info, MaxEventsPerUserPerDay> *pOutCompletedTasks)
-{
-  lsResult result = lsR_Success;
+    for (const size_t userId : evnt.userIds)
+      LS_ERROR_CHECK(add_event_id_for_user(userId, id));
 
-  // Scope Lock
-  {
-    std::scoped_lock lock(_ThreadLock);
+    *pStoredEvent = std::move(evnt);
+    pool_mark_dirty(&_Events, id);
+    _EventDataEpoch++;
 
-    user *pUser = pool_get(&_Users, userId);
-    LS_ERROR_IF(pUser == nullptr, lsR_ResourceNotFound);
+    // Only participants, former or current, can list the event in their schedule.
+    for (const size_t userId : pStoredEvent->userIds)
+      update_schedule_blob(userId);
 
-    for (const size_t eventId : pUser->completedTasksForCurrentDay)
-    {
-      event *pEvent = pool_get(&_Events, eventId);
-      LS_ERROR_IF(pEvent == nullptr, lsR_ResourceNotFound);
+    for (const size_t userId : removedUserIds)
+      update_schedule_blob(userId);
 
-      event_info info;
-      info.id = eventId;
-      info.durationInMinutes = minutes_from_time_span(pEvent->durationTimeSpan);
-      strncpy(info.name, pEvent->name, LS_ARRAYSIZE(info.name));
-
-      LS_ERROR_CHECK(list_add(pOutCompletedTasks, info));
-    }
+    LS_ERROR_CHECK(journal_put_event(id, *pStoredEvent, &journalSequence));
   }
 
+  LS_ERROR_CHECK(journal_wait(journalSequence));
+
 epilogue:
   return result;
 }
 
-lsResult update_task(const size_t id, event &evnt) // evnt is intentionally non-const as it's creation time etc. will be updated to the old values.
+lsResult set_event_last_completed_time(const size_t eventId, const time_point_t time)
 {
   lsResult result = lsR_Success;
 
+  uint64_t journalSequence = 0;
+
   // Scope Lock
   {
     std::scoped_lock lock(_ThreadLock);
 
-    event *pStoredEvent = nullptr;
-    LS_ERROR_CHECK(pool_get_safe(&_Events, id, &pStoredEvent));
+    event *pEvent = nullptr;
+    LS_ERROR_CHECK(pool_get_safe(&_Events, eventId, &pEvent));
 
-    evnt.creationTime = pStoredEvent->creationTime;
-    evnt.lastCompletedTime = pStoredEvent->lastCompletedTime;
-    evnt.lastModifiedTime = get_current_time();
+    pEvent->lastCompletedTime = time;
+    pool_mark_dirty(&_Events, eventId);
 
-    *pStoredEvent = evnt;
+    LS_ERROR_CHECK(journal_put_event(eventId, *pEvent, &journalSequence));
   }
 
-  _EventDataEpoch++;
+  // Persisted by the journal. Not bumping `_EventDataEpoch`, as completions don't require a reschedule.
+  LS_ERROR_CHECK(journal_wait(journalSequence));
 
 epilogue:
   return result;
 }
 
-lsResult set_event_last_completed_time(const size_t eventId, const time_point_t time)
+lsResult add_completed_task(const size_t eventId, const size_t userId)
 {
   lsResult result = lsR_Success;
 
+  uint64_t journalSequence = 0;
+
   // Scope Lock
   {
     std::scoped_lock lock(_ThreadLock);
 
-    event *pEvent = nullptr;
-    LS_ERROR_CHECK(pool_get_safe(&_Events, eventId, &pEvent));
+    user *pUser = nullptr;
+    LS_ERROR_CHECK(pool_get_safe(&_Users, userId, &pUser));
+    LS_ERROR_CHECK(list_add(&pUser->completedTasksForCurrentDay, eventId));
+    pool_mark_dirty(&_Users, userId);
+    update_schedule_blob(userId);
 
-    pEvent->lastCompletedTime = time;
+    LS_ERROR_CHECK(journal_put_user(userId, *pUser, &journalSequence));
   }
 
-  // TODO: consider adding a variable to communicate that the events should be written to file but not rescheduled
-  //_EventDataEpoch++;
+  LS_ERROR_CHECK(journal_wait(journalSequence));
 
 epilogue:
   return result;
 }
 
-lsResult add_completed_task(const size_t eventId, const size_t userId)
+lsResult search_events_by_name(const char *searchTerm, const event_info_visitor &visitor)
 {
   lsResult result = lsR_Success;
 
+  const size_t searchTermLength = strlen(searchTerm);
+  const size_t epoch = _EventDataEpoch;
+  small_list<size_t, SearchCacheMaxResults> eventIds;
+  bool isExactMatch = false;
+
+  const bool isCached = search_cache_find(ss_Events, 0, searchTerm, searchTermLength, epoch, &eventIds, &isExactMatch);
+
   // Scope Lock
   {
     std::scoped_lock lock(_ThreadLock);
 
-    user *pUser = nullptr;
-    LS_ERROR_CHECK(pool_get_safe(&_Users, userId, &pUser));
-    LS_ERROR_CHECK(list_add(&pUser->completedTasksForCurrentDay, eventId));
+    if (!isCached)
+    {
+      for (const auto &&_evnt : _Events)
+      {
+        if (strstr(arena_string_get(_evnt.pItem->name), searchTerm) != nullptr)
+        {
+          LS_ERROR_CHECK(list_add(&eventIds, _evnt.index));
+        }
+      }
+    }
+
+    size_t matchCount = 0;
+
+    for (const size_t eventId : eventIds)
+    {
+      if (!pool_has(_Events, eventId))
+        continue;
+
+      const event *pEvent = pool_get(&_Events, eventId);
+
+      if (!isExactMatch && isCached && strstr(arena_string_get(pEvent->name), searchTerm) == nullptr)
+        continue;
+
+      eventIds[matchCount++] = eventId;
+
+      visitor(event_info_from_event(eventId, *pEvent));
+    }
+
+    eventIds.count = matchCount;
   }
 
+  if (!isExactMatch)
+    search_cache_store(ss_Events, 0, searchTerm, searchTermLength, epoch, eventIds);
+
+  goto epilogue;
 epilogue:
   return result;
 }
 
-lsResult search_events_by_name(const char *searchTerm, _Out_ local_list<event_info, MaxSearchResults> *pOutSearchResults)
+lsResult search_events_by_user_by_name(const size_t userId, const char *searchTerm, const event_info_visitor &visitor)
 {
   lsResult result = lsR_Success;
 
+  const size_t searchTermLength = strlen(searchTerm);
+  const size_t epoch = _EventDataEpoch + _UserDataEpoch; // new users pick up events that already list them.
+  small_list<size_t, SearchCacheMaxResults> eventIds;
+  bool isExactMatch = false;
+
+  const bool isCached = search_cache_find(ss_EventsOfUser, userId, searchTerm, searchTermLength, epoch, &eventIds, &isExactMatch);
+
   // Scope Lock
   {
     std::scoped_lock lock(_ThreadLock);
 
-    for (const auto &&_evnt : _Events)
+    if (!isCached && pool_has(_EventIdsByUser, userId))
     {
-      if (strstr(_evnt.pItem->name, searchTerm) != nullptr)
+      for (const size_t eventId : *pool_get(&_EventIdsByUser, userId))
       {
-        event_info info;
-        info.id = _evnt.index;
-        strncpy(info.name, _evnt.pItem->name, LS_ARRAYSIZE(info.name));
-        info.durationInMinutes = minutes_from_time_span(_evnt.pItem->durationTimeSpan);
+        if (strstr(arena_string_get(pool_get(&_Events, eventId)->name), searchTerm) != nullptr)
+        {
+          LS_ERROR_CHECK(list_add(&eventIds, eventId));
+        }
+      }
+    }
 
-        LS_DEBUG_ERROR_ASSERT(list_add(pOutSearchResults, info));
+    size_t matchCount = 0;
 
-        if (pOutSearchResults->count == pOutSearchResults->capacity())
-          break;
-      }
+    for (const size_t eventId : eventIds)
+    {
+      if (!pool_has(_Events, eventId))
+        continue;
+
+      const event *pEvent = pool_get(&_Events, eventId);
+
+      if (!isExactMatch && isCached && strstr(arena_string_get(pEvent->name), searchTerm) == nullptr)
+        continue;
+
+      eventIds[matchCount++] = eventId;
+
+      visitor(event_info_from_event(eventId, *pEvent));
     }
+
+    eventIds.count = matchCount;
   }
 
+  if (!isExactMatch)
+    search_cache_store(ss_EventsOfUser, userId, searchTerm, searchTermLength, epoch, eventIds);
+
   goto epilogue;
 epilogue:
   return result;
 }
 
-lsResult search_events_by_user_by_name(const size_t userId, const char *searchTerm, _Out_ local_list<event_info, MaxSearchResults> *pOutSearchResults)
+lsResult search_users_by_name(const char *searchTerm, const user_info_visitor &visitor, _Out_ bool *pIsTruncated)
 {
   lsResult result = lsR_Success;
 
+  const size_t searchTermLength = strlen(searchTerm);
+  const size_t epoch = _UserDataEpoch;
+  small_list<size_t, SearchCacheMaxResults> userIds;
+  bool isExactMatch = false;
+
+  *pIsTruncated = false;
+
+  const bool isCached = search_cache_find(ss_Users, 0, searchTerm, searchTermLength, epoch, &userIds, &isExactMatch);
+
   // Scope Lock
   {
     std::scoped_lock lock(_ThreadLock);
 
-    for (const auto &&_evnt : _Events)
+    if (!isCached)
     {
-      bool userIdFound = false;
-
-      for (const auto &_id : _evnt.pItem->userIds)
+      for (const auto &&_user : _Users)
       {
-        if (_id == userId)
+        if (strstr(arena_string_get(_user.pItem->username), searchTerm) != nullptr)
         {
-          userIdFound = true;
-          break;
+          LS_ERROR_CHECK(list_add(&userIds, _user.index));
+
+          if (userIds.count > MaxSearchResults)
+            break; // the one extra match only tells that there are more.
         }
       }
+    }
+
+    size_t matchCount = 0;
 
-      if (!userIdFound)
+    for (const size_t userId : userIds)
+    {
+      if (!pool_has(_Users, userId))
         continue;
 
-      if (strstr(_evnt.pItem->name, searchTerm) != nullptr)
-      {
-        event_info info;
-        info.id = _evnt.index;
-        strncpy(info.name, _evnt.pItem->name, LS_ARRAYSIZE(info.name));
-        info.durationInMinutes = minutes_from_time_span(_evnt.pItem->durationTimeSpan);
+      const user *pUser = pool_get(&_Users, userId);
 
-        LS_DEBUG_ERROR_ASSERT(list_add(pOutSearchResults, info));
+      if (!isExactMatch && isCached && strstr(arena_string_get(pUser->username), searchTerm) == nullptr)
+        continue;
 
-        if (pOutSearchResults->count == pOutSearchResults->capacity())
-          break;
+      if (matchCount == MaxSearchResults)
+      {
+        *pIsTruncated = true;
+        break;
       }
+
+      userIds[matchCount++] = userId;
+
+      visitor(user_info_from_user(userId, *pUser));
     }
+
+    userIds.count = matchCount;
   }
 
+  if (!isExactMatch && !*pIsTruncated)
+    search_cache_store(ss_Users, 0, searchTerm, searchTermLength, epoch, userIds);
+
   goto epilogue;
 epilogue:
   return result;
 }
 
-lsResult search_users_by_name(const char *searchTerm, _Out_ local_list<user_info, MaxSearchResults> *pOutSearchResults)
+lsResult get_all_event_ids_for_user(const size_t userId, _Out_ small_list<size_t> *pOutEventIds)
 {
   lsResult result = lsR_Success;
 
@@ -590,28 +1109,18 @@ lsResult search_users_by_name(const char *searchTerm, _Out_ local_list<user_info
   {
     std::scoped_lock lock(_ThreadLock);
 
-    for (const auto &&_user : _Users)
-    {
-      if (strstr(_user.pItem->username, searchTerm))
-      {
-        user_info info;
-        info.id = _user.index;
-        strncpy(info.name, _user.pItem->username, LS_ARRAYSIZE(info.name));
-
-        LS_DEBUG_ERROR_ASSERT(list_add(pOutSearchResults, info));
+    if (!pool_has(_EventIdsByUser, userId))
+      goto epilogue;
 
-        if (pOutSearchResults->count == pOutSearchResults->capacity())
-          break;
-      }
-    }
+    for (const size_t eventId : *pool_get(&_EventIdsByUser, userId))
+      LS_ERROR_CHECK(list_add(pOutEventIds, eventId));
   }
 
-  goto epilogue;
 epilogue:
   return result;
 }
 
-lsResult get_all_event_ids_for_user(const size_t userId, _Out_ local_list<size_t, MaxSearchResults> *pOutEventIds)
+lsResult get_event_details(const size_t id, const event_details_visitor &eventVisitor, const user_info_visitor &userVisitor)
 {
   lsResult result = lsR_Success;
 
@@ -619,18 +1128,18 @@ lsResult get_all_event_ids_for_user(const size_t userId, _Out_ local_list<size_t
   {
     std::scoped_lock lock(_ThreadLock);
 
-    for (const auto &&_evnt : _Events)
-    {
-      for (const auto &_id : _evnt.pItem->userIds)
-      {
-        if (_id != userId)
-          continue;
+    LS_ERROR_IF(!pool_has(_Events, id), lsR_ResourceNotFound); // `pool_get` doesn't check.
 
-        LS_DEBUG_ERROR_ASSERT(list_add(pOutEventIds, _evnt.index));
+    const event *pEvent = pool_get(&_Events, id);
 
-        if (pOutEventIds->count == pOutEventIds->capacity())
-          goto epilogue;
-      }
+    if (!eventVisitor(*pEvent))
+      goto epilogue;
+
+    for (const size_t userId : pEvent->userIds)
+    {
+      LS_ERROR_IF(!pool_has(_Users, userId), lsR_ResourceInvalid);
+
+      userVisitor(user_info_from_user(userId, *pool_get(&_Users, userId)));
     }
   }
 
@@ -638,7 +1147,7 @@ epilogue:
   return result;
 }
 
-lsResult get_event(const size_t id, _Out_ event *pEvent)
+lsResult rebuild_event_ids_by_user()
 {
   lsResult result = lsR_Success;
 
@@ -646,10 +1155,11 @@ lsResult get_event(const size_t id, _Out_ event *pEvent)
   {
     std::scoped_lock lock(_ThreadLock);
 
-    const event *pStoredEvent = pool_get(&_Events, id);
-    LS_ERROR_IF(pStoredEvent == nullptr, lsR_ResourceNotFound);
+    pool_clear(&_EventIdsByUser);
 
-    *pEvent = *pStoredEvent;
+    for (const auto &&_evnt : _Events)
+      for (const size_t userId : _evnt.pItem->userIds)
+        LS_ERROR_CHECK(add_event_id_for_user(userId, _evnt.index));
   }
 
 epilogue:
@@ -658,12 +1168,14 @@ epilogue:
 
 bool user_name_exists(const char *username)
 {
+  const size_t usernameLength = strlen(username);
+
   // Scope Lock
   {
     std::scoped_lock lock(_ThreadLock);
 
     for (const auto &&_user : _Users)
-      if ((strncmp(_user.pItem->username, username, LS_ARRAYSIZE(_user.pItem->username)) == 0))
+      if ((arena_string_equals(_user.pItem->username, username, usernameLength)))
         return false;
   }
   return true;
@@ -671,13 +1183,26 @@ bool user_name_exists(const char *username)
 
 void clearCompletedTasks()
 {
+  uint64_t journalSequence = 0;
+
   // Scope Lock
   {
     std::scoped_lock lock(_ThreadLock);
 
     for (const auto &&_user : _Users)
+    {
       list_clear(&_user.pItem->completedTasksForCurrentDay);
+      pool_mark_dirty(&_Users, _user.index);
+    }
+
+    clear_schedule_blobs(); // the following reschedule renders them again.
+
+    if (LS_FAILED(journal_clear_completed_tasks(&journalSequence)))
+      print_error_line("Failed to journal clearing the completed tasks.");
   }
+
+  if (LS_FAILED(journal_wait(journalSequence)))
+    print_error_line("Failed to write the journal.");
 }
 
 //////////////////////////////////////////////////////////////////////////
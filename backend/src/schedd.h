@@ -5,8 +5,15 @@
 #include "local_list.h"
 #include "pool.h"
 #include "small_list.h"
+#include "string_arena.h"
 
 #include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+extern std::mutex _ThreadLock; // Guards `_Users`, `_Events` and all other scheduling state.
 
 extern std::atomic<size_t> _UserDataEpoch;
 extern std::atomic<size_t> _EventDataEpoch;
@@ -15,13 +22,22 @@ extern std::atomic<size_t> _ExplicitlyRequestsRescheduleEpoch;
 lsResult reschedule_events_for_user(const size_t userId); // Assumes mutex lock
 
 constexpr size_t DaysPerWeek = 7;
-constexpr size_t MaxUsersPerEvent = 16;
-constexpr size_t MaxEventsPerUserPerDay = 32;
-constexpr size_t MaxSearchResults = 32;
+constexpr size_t InlineUsersPerEvent = 4; // lists spill to the heap beyond this.
+constexpr size_t InlineEventsPerUserPerDay = 8; // lists spill to the heap beyond this.
+constexpr size_t MaxNameLength = 255; // for event and user names.
 
 typedef uint64_t time_point_t;
 typedef int64_t time_span_t;
 
+// Schedules are computed for one day & stay current until the user or event data changes.
+// The snapshot persists them along with that day, so a restart on the same day doesn't need to reschedule everyone.
+constexpr size_t ScheduleDayNone = (size_t)-1;
+
+void reschedule_all_users(const size_t day); // Assumes mutex lock
+void get_schedule_day(_Out_ size_t *pDay, _Out_ time_point_t *pComputedTime); // Assumes mutex lock. `ScheduleDayNone` if the data changed since the schedules were computed.
+void restore_schedule_day(const size_t day, const time_point_t computedTime); // Assumes mutex lock. For schedules loaded alongside the data they were computed from.
+bool schedules_are_current(const size_t day);
+
 enum weekday_flags : uint8_t
 {
   wF_None = 0,
@@ -37,9 +53,9 @@ enum weekday_flags : uint8_t
 
 struct event
 {
-  char name[256];
+  arena_string name;
   time_span_t durationTimeSpan;
-  local_list<size_t, MaxUsersPerEvent> userIds;
+  small_list<size_t, InlineUsersPerEvent> userIds;
   uint64_t weight, weightGrowthFactor;
   weekday_flags possibleExecutionDays; // 1 bit for each day + 1 extra
   time_span_t repetitionTimeSpan; // if 0: don't repeat!
@@ -54,53 +70,85 @@ struct user_id_info
 
 struct user
 {
-  char username[256];
+  arena_string username;
   local_list<time_span_t, DaysPerWeek> availableTimePerDay;
-  local_list<size_t, MaxEventsPerUserPerDay> tasksForCurrentDay; // index of the event
-  local_list<size_t, MaxEventsPerUserPerDay> completedTasksForCurrentDay; // index of the event
-  local_list<size_t, MaxEventsPerUserPerDay> tooLongTasksForCurrentDay; // index of the event - tasks that take too long but are urgently due.
+  small_list<size_t, InlineEventsPerUserPerDay> tasksForCurrentDay; // index of the event
+  small_list<size_t, InlineEventsPerUserPerDay> completedTasksForCurrentDay; // index of the event
+  small_list<size_t, InlineEventsPerUserPerDay> tooLongTasksForCurrentDay; // index of the event - tasks that take too long but are urgently due.
 };
 
 extern pool<user> _Users;
 extern pool<event> _Events;
 
+lsResult rebuild_event_ids_by_user(); // Call once after `_Users` and `_Events` have been deserialized.
+
 lsResult assign_session_token(const char *username, _Out_ uint32_t *pOutSessionId);
 lsResult invalidate_session_token(const uint32_t sessionId);
-lsResult add_new_user(const user usr);
-lsResult add_new_event(event evnt);
+lsResult add_new_user(user &&usr);
+lsResult add_new_event(event &&evnt);
 lsResult get_user_id_from_session_id(const uint32_t sessionId, _Out_ size_t *pUserId);
 lsResult get_available_time(const size_t userId, _Out_ local_list<time_span_t, DaysPerWeek> *pOutAvailableTime);
 lsResult replace_available_time(const size_t userId, const local_list<time_span_t, DaysPerWeek> availableTime);
 
+// Views into the pools: `name` is only valid for the duration of the visitor call.
 struct event_info
 {
   size_t id;
   size_t durationInMinutes;
-  char name[256];
+  const char *name;
+  size_t nameLength;
   bool isCompleted;
 };
 
 struct user_info
 {
   size_t id;
-  char name[256];
+  const char *name;
+  size_t nameLength;
+};
+
+// Visitors are called while the mutex is locked, so they must not call back into any of these functions.
+typedef std::function<void(const event_info &info)> event_info_visitor;
+typedef std::function<void(const user_info &info)> user_info_visitor;
+typedef std::function<bool(const event &evnt)> event_details_visitor; // Returns whether the participants are needed.
+
+lsResult get_user_info(const size_t userId, const user_info_visitor &visitor);
+lsResult get_completed_events_for_current_day(const size_t userId, const event_info_visitor &visitor);
+
+// The rendered `/user-schedule` response, immutable.
+struct schedule_blob
+{
+  std::string json;
+  uint64_t etag; // hash of `json`, strong validator for conditional requests.
 };
 
-lsResult get_user_info(const size_t userId, _Out_ user_info *pOutInfo);
-lsResult get_current_events_from_user_id(const size_t userId, _Out_ local_list<event_info, MaxEventsPerUserPerDay> *pOutCurrentEvents);
-lsResult get_current_too_long_events_from_user_id(const size_t userId, _Out_ local_list<event_info, MaxEventsPerUserPerDay> *pOutCurrentEvents);
-lsResult get_completed_events_for_current_day(const size_t userId, _Out_ local_list<event_info, MaxEventsPerUserPerDay> *pOutCompletedTasks);
+// FNV-1a, chained through `hash` to cover multiple fields.
+inline uint64_t etag_hash(const void *pData, const size_t size, uint64_t hash = 0xCBF29CE484222325)
+{
+  const uint8_t *pBytes = reinterpret_cast<const uint8_t *>(pData);
+
+  for (size_t i = 0; i < size; i++)
+    hash = (hash ^ pBytes[i]) * 0x100000001B3;
+
+  return hash;
+}
+
+lsResult get_user_schedule_blob(const size_t userId, _Out_ std::shared_ptr<const schedule_blob> *pBlob);
+
+// The user search visits at most `MaxSearchResults` matches & reports in `pIsTruncated` whether there are more. Event searches visit every match.
+constexpr size_t MaxSearchResults = 32;
 
-lsResult search_events_by_name(const char *searchTerm, _Out_ local_list<event_info, MaxSearchResults> *pOutSearchResults);
-lsResult search_events_by_user_by_name(const size_t userId, const char *searchTerm, _Out_ local_list<event_info, MaxSearchResults> *pOutSearchResults);
-lsResult search_users_by_name(const char *searchTerm, _Out_ local_list<user_info, MaxSearchResults> *pOutSearchResults);
+lsResult search_events_by_name(const char *searchTerm, const event_info_visitor &visitor);
+lsResult search_events_by_user_by_name(const size_t userId, const char *searchTerm, const event_info_visitor &visitor); // Scans only the user's events, an empty `searchTerm` visits all of them.
+lsResult search_users_by_name(const char *searchTerm, const user_info_visitor &visitor, _Out_ bool *pIsTruncated);
 
-lsResult get_all_event_ids_for_user(const size_t userId, _Out_ local_list<size_t, MaxSearchResults> *pOutEventIds);
+lsResult get_all_event_ids_for_user(const size_t userId, _Out_ small_list<size_t> *pOutEventIds);
 
-lsResult update_task(const size_t id, event &evnt);
+lsResult update_task(const size_t id, event &&evnt);
 lsResult set_event_last_completed_time(const size_t eventId, const time_point_t time);
 lsResult add_completed_task(const size_t eventId, const size_t userId);
-lsResult get_event(const size_t taskId, _Out_ event *pEvent);
+lsResult get_event_details(const size_t taskId, const event_details_visitor &eventVisitor, const user_info_visitor &userVisitor); // Visits the event & then its participants, all within one lock.
+uint64_t get_event_etag(const event &evnt); // Changes with every field of the event that `/task` responds with.
 
 bool user_name_exists(const char *username);
 void clearCompletedTasks();
@@ -14,22 +14,20 @@ struct small_list_const_iterator;
 template <typename T, size_t internal_count>
 struct small_list_const_reverse_iterator;
 
+struct small_list_end {}; // What the forward iterators compare against, they know where their range ends.
+
 template <typename T, size_t internal_count>
 struct small_list_iterator
 {
-  small_list<T, internal_count> *pList = nullptr;
-  bool inInternal = true;
-  size_t subIndex = 0;
-  size_t position = 0;
+  T *pCurrent = nullptr;
+  T *pSegmentEnd = nullptr; // end of the internal values, or of the extra values once `pCurrent` moved there.
+  T *pExtra = nullptr; // `nullptr` unless the list spilled & `pCurrent` is still in the internal values, so unspilled lists iterate as a plain pointer range.
+  T *pExtraEnd = nullptr;
 
-  small_list_iterator(small_list<T, internal_count> *pList);
+  small_list_iterator(small_list<T, internal_count> *pList, const size_t startIndex = 0);
   T &operator *();
   const T &operator *() const;
-  bool operator != (const size_t maxCount) const;
-  bool operator != (const small_list_iterator<T, internal_count> &it) const;
-  bool operator != (const small_list_reverse_iterator<T, internal_count> &it) const;
-  bool operator != (const small_list_const_iterator<T, internal_count> &it) const;
-  bool operator != (const small_list_const_reverse_iterator<T, internal_count> &it) const;
+  bool operator != (const small_list_end &) const;
   small_list_iterator<T, internal_count> &operator++();
 };
 
@@ -45,9 +43,7 @@ struct small_list_reverse_iterator
   T &operator *();
   const T &operator *() const;
   bool operator != (const size_t startIndex) const;
-  bool operator != (const small_list_iterator<T, internal_count> &it) const;
   bool operator != (const small_list_reverse_iterator<T, internal_count> &it) const;
-  bool operator != (const small_list_const_iterator<T, internal_count> &it) const;
   bool operator != (const small_list_const_reverse_iterator<T, internal_count> &it) const;
   small_list_reverse_iterator<T, internal_count> &operator++();
 };
@@ -55,18 +51,14 @@ struct small_list_reverse_iterator
 template <typename T, size_t internal_count>
 struct small_list_const_iterator
 {
-  const small_list<T, internal_count> *pList = nullptr;
-  bool inInternal = true;
-  size_t subIndex = 0;
-  size_t position = 0;
+  const T *pCurrent = nullptr;
+  const T *pSegmentEnd = nullptr; // end of the internal values, or of the extra values once `pCurrent` moved there.
+  const T *pExtra = nullptr; // `nullptr` unless the list spilled & `pCurrent` is still in the internal values, so unspilled lists iterate as a plain pointer range.
+  const T *pExtraEnd = nullptr;
 
-  small_list_const_iterator(const small_list<T, internal_count> *pList);
+  small_list_const_iterator(const small_list<T, internal_count> *pList, const size_t startIndex = 0);
   const T &operator *() const;
-  bool operator != (const size_t maxCount) const;
-  bool operator != (const small_list_iterator<T, internal_count> &it) const;
-  bool operator != (const small_list_reverse_iterator<T, internal_count> &it) const;
-  bool operator != (const small_list_const_iterator<T, internal_count> &it) const;
-  bool operator != (const small_list_const_reverse_iterator<T, internal_count> &it) const;
+  bool operator != (const small_list_end &) const;
   small_list_const_iterator<T, internal_count> &operator++();
 };
 
@@ -81,9 +73,7 @@ struct small_list_const_reverse_iterator
   small_list_const_reverse_iterator(const small_list<T, internal_count> *pList);
   const T &operator *() const;
   bool operator != (const size_t startIndex) const;
-  bool operator != (const small_list_iterator<T, internal_count> &it) const;
   bool operator != (const small_list_reverse_iterator<T, internal_count> &it) const;
-  bool operator != (const small_list_const_iterator<T, internal_count> &it) const;
   bool operator != (const small_list_const_reverse_iterator<T, internal_count> &it) const;
   small_list_const_reverse_iterator<T, internal_count> &operator++();
 };
@@ -108,7 +98,7 @@ struct small_list
 
   inline small_list_iterator<T, internal_count> begin() { return small_list_iterator<T, internal_count>(this); };
   inline small_list_const_iterator<T, internal_count> begin() const { return small_list_const_iterator<T, internal_count>(this); };
-  inline size_t end() const { return count; };
+  inline small_list_end end() const { return {}; };
 
   ~small_list();
 
@@ -128,18 +118,8 @@ struct small_list
 
     inline IterateFromWrapper(small_list<T, internal_count> *pList, size_t startIdx) : pList(pList), startIdx(startIdx) {}
 
-    inline small_list_iterator<T, internal_count> begin()
-    {
-      small_list_iterator<T, internal_count> it = small_list_iterator<T, internal_count>(pList);
-
-      it.inInternal = startIdx < internal_count;
-      it.position = startIdx;
-      it.subIndex = it.inInternal ? startIdx : startIdx - internal_count;
-
-      return it;
-    };
-
-    inline size_t end() { return pList->count; };
+    inline small_list_iterator<T, internal_count> begin() { return small_list_iterator<T, internal_count>(pList, startIdx); };
+    inline small_list_end end() { return {}; };
   };
 
   inline IterateFromWrapper IterateFrom(const size_t idx) { return IterateFromWrapper(this, idx); };
@@ -151,18 +131,8 @@ struct small_list
 
     inline ConstIterateFromWrapper(const small_list<T, internal_count> *pList, size_t startIdx) : pList(pList), startIdx(startIdx) {}
 
-    inline small_list_const_iterator<T, internal_count> begin()
-    {
-      small_list_const_iterator<T, internal_count> it = small_list_const_iterator<T, internal_count>(pList);
-
-      it.inInternal = startIdx < internal_count;
-      it.position = startIdx;
-      it.subIndex = it.inInternal ? startIdx : startIdx - internal_count;
-
-      return it;
-    };
-
-    inline size_t end() { return pList->count; };
+    inline small_list_const_iterator<T, internal_count> begin() { return small_list_const_iterator<T, internal_count>(pList, startIdx); };
+    inline small_list_end end() { return {}; };
   };
 
   inline ConstIterateFromWrapper IterateFrom(const size_t idx) const { return ConstIterateFromWrapper(this, idx); };
@@ -810,9 +780,18 @@ void list_destroy(small_list<T, internal_count> *pList)
 template <typename T, size_t internal_count, typename U>
 T *list_contains(small_list<T, internal_count> &list, const U &cmp)
 {
-  for (auto &_i : list)
-    if (_i == cmp)
-      return &_i;
+  const size_t internalCount = lsMin(list.count, internal_count);
+
+  for (size_t i = 0; i < internalCount; i++)
+    if (list.values[i] == cmp)
+      return &list.values[i];
+
+  if (list.count <= internal_count) [[likely]]
+    return nullptr;
+
+  for (size_t i = 0; i < list.count - internal_count; i++)
+    if (list.pExtra[i] == cmp)
+      return &list.pExtra[i];
 
   return nullptr;
 }
@@ -820,9 +799,18 @@ T *list_contains(small_list<T, internal_count> &list, const U &cmp)
 template <typename T, size_t internal_count, typename U>
 const T *list_contains(const small_list<T, internal_count> &list, const U &cmp)
 {
-  for (auto &_i : list)
-    if (_i == cmp)
-      return &_i;
+  const size_t internalCount = lsMin(list.count, internal_count);
+
+  for (size_t i = 0; i < internalCount; i++)
+    if (list.values[i] == cmp)
+      return &list.values[i];
+
+  if (list.count <= internal_count) [[likely]]
+    return nullptr;
+
+  for (size_t i = 0; i < list.count - internal_count; i++)
+    if (list.pExtra[i] == cmp)
+      return &list.pExtra[i];
 
   return nullptr;
 }
@@ -1640,68 +1628,53 @@ inline T list_remove_insert(small_list<T, internal_count> &l, const size_t remov
 //////////////////////////////////////////////////////////////////////////
 
 template<typename T, size_t internal_count>
-inline small_list_iterator<T, internal_count>::small_list_iterator(small_list<T, internal_count> *pList) :
-  pList(pList)
-{ }
-
-template<typename T, size_t internal_count>
-inline T &small_list_iterator<T, internal_count>::operator*()
-{
-  if (inInternal)
-    return pList->values[subIndex];
-  else
-    return pList->pExtra[subIndex];
-}
-
-template<typename T, size_t internal_count>
-inline const T &small_list_iterator<T, internal_count>::operator*() const
+inline small_list_iterator<T, internal_count>::small_list_iterator(small_list<T, internal_count> *pList, const size_t startIndex)
 {
-  if (inInternal)
-    return pList->values[subIndex];
+  if (pList->count <= internal_count) [[likely]]
+  {
+    pCurrent = pList->values + lsMin(startIndex, pList->count);
+    pSegmentEnd = pList->values + pList->count;
+  }
+  else if (startIndex < internal_count)
+  {
+    pCurrent = pList->values + startIndex;
+    pSegmentEnd = pList->values + internal_count;
+    pExtra = pList->pExtra;
+    pExtraEnd = pList->pExtra + (pList->count - internal_count);
+  }
   else
-    return pList->pExtra[subIndex];
-}
-
-template<typename T, size_t internal_count>
-inline bool small_list_iterator<T, internal_count>::operator!=(const size_t maxCount) const
-{
-  return position < maxCount;
-}
-
-template<typename T, size_t internal_count>
-inline bool small_list_iterator<T, internal_count>::operator!=(const small_list_iterator<T, internal_count> &it) const
-{
-  return position < it.position;
+  {
+    pSegmentEnd = pList->pExtra + (pList->count - internal_count);
+    pCurrent = pList->pExtra + (lsMin(startIndex, pList->count) - internal_count);
+  }
 }
 
 template<typename T, size_t internal_count>
-inline bool small_list_iterator<T, internal_count>::operator!=(const small_list_reverse_iterator<T, internal_count> &it) const
+inline T &small_list_iterator<T, internal_count>::operator*()
 {
-  return (int64_t)position < it.position;
+  return *pCurrent;
 }
 
 template<typename T, size_t internal_count>
-inline bool small_list_iterator<T, internal_count>::operator!=(const small_list_const_iterator<T, internal_count> &it) const
+inline const T &small_list_iterator<T, internal_count>::operator*() const
 {
-  return position < it.position;
+  return *pCurrent;
 }
 
 template<typename T, size_t internal_count>
-inline bool small_list_iterator<T, internal_count>::operator!=(const small_list_const_reverse_iterator<T, internal_count> &it) const
+inline bool small_list_iterator<T, internal_count>::operator!=(const small_list_end &) const
 {
-  return (int64_t)position < it.position;
+  return pCurrent != pSegmentEnd;
 }
 
 template<typename T, size_t internal_count>
 inline small_list_iterator<T, internal_count> &small_list_iterator<T, internal_count>::operator++()
 {
-  position++;
-  subIndex++;
-
-  if (inInternal && subIndex == internal_count)
+  if (++pCurrent == pSegmentEnd && pExtra != nullptr)
   {
-    inInternal = false;
-    subIndex = 0;
+    pCurrent = pExtra;
+    pSegmentEnd = pExtraEnd;
+    pExtra = nullptr;
   }
 
   return *this;
@@ -1740,24 +1713,12 @@ inline bool small_list_reverse_iterator<T, internal_count>::operator!=(const siz
   return position >= (int64_t)startIndex;
 }
 
-template<typename T, size_t internal_count>
-inline bool small_list_reverse_iterator<T, internal_count>::operator!=(const small_list_iterator<T, internal_count> &it) const
-{
-  return position >= (int64_t)it.position;
-}
-
 template<typename T, size_t internal_count>
 inline bool small_list_reverse_iterator<T, internal_count>::operator!=(const small_list_reverse_iterator<T, internal_count> &it) const
 {
   return position >= it.position;
 }
 
-template<typename T, size_t internal_count>
-inline bool small_list_reverse_iterator<T, internal_count>::operator!=(const small_list_const_iterator<T, internal_count> &it) const
-{
-  return position >= (int64_t)it.position;
-}
-
 template<typename T, size_t internal_count>
 inline bool small_list_reverse_iterator<T, internal_count>::operator!=(const small_list_const_reverse_iterator<T, internal_count> &it) const
 {
@@ -1780,59 +1741,47 @@ inline small_list_reverse_iterator<T, internal_count> &small_list_reverse_iterat
 }
 
 template<typename T, size_t internal_count>
-inline small_list_const_iterator<T, internal_count>::small_list_const_iterator(const small_list<T, internal_count> *pList) :
-  pList(pList)
-{ }
-
-template<typename T, size_t internal_count>
-inline const T &small_list_const_iterator<T, internal_count>::operator*() const
+inline small_list_const_iterator<T, internal_count>::small_list_const_iterator(const small_list<T, internal_count> *pList, const size_t startIndex)
 {
-  if (inInternal)
-    return pList->values[subIndex];
+  if (pList->count <= internal_count) [[likely]]
+  {
+    pCurrent = pList->values + lsMin(startIndex, pList->count);
+    pSegmentEnd = pList->values + pList->count;
+  }
+  else if (startIndex < internal_count)
+  {
+    pCurrent = pList->values + startIndex;
+    pSegmentEnd = pList->values + internal_count;
+    pExtra = pList->pExtra;
+    pExtraEnd = pList->pExtra + (pList->count - internal_count);
+  }
   else
-    return pList->pExtra[subIndex];
-}
-
-template<typename T, size_t internal_count>
-inline bool small_list_const_iterator<T, internal_count>::operator!=(const size_t maxCount) const
-{
-  return position < maxCount;
-}
-
-template<typename T, size_t internal_count>
-inline bool small_list_const_iterator<T, internal_count>::operator!=(const small_list_iterator<T, internal_count> &it) const
-{
-  return position < it.position;
-}
-
-template<typename T, size_t internal_count>
-inline bool small_list_const_iterator<T, internal_count>::operator!=(const small_list_reverse_iterator<T, internal_count> &it) const
-{
-  return (int64_t)position < it.position;
+  {
+    pSegmentEnd = pList->pExtra + (pList->count - internal_count);
+    pCurrent = pList->pExtra + (lsMin(startIndex, pList->count) - internal_count);
+  }
 }
 
 template<typename T, size_t internal_count>
-inline bool small_list_const_iterator<T, internal_count>::operator!=(const small_list_const_iterator<T, internal_count> &it) const
+inline const T &small_list_const_iterator<T, internal_count>::operator*() const
 {
-  return position < it.position;
+  return *pCurrent;
 }
 
 template<typename T, size_t internal_count>
-inline bool small_list_const_iterator<T, internal_count>::operator!=(const small_list_const_reverse_iterator<T, internal_count> &it) const
+inline bool small_list_const_iterator<T, internal_count>::operator!=(const small_list_end &) const
 {
-  return (int64_t)position < it.position;
+  return pCurrent != pSegmentEnd;
 }
 
 template<typename T, size_t internal_count>
 inline small_list_const_iterator<T, internal_count> &small_list_const_iterator<T, internal_count>::operator++()
 {
-  position++;
-  subIndex++;
-
-  if (inInternal && subIndex == internal_count)
+  if (++pCurrent == pSegmentEnd && pExtra != nullptr)
   {
-    inInternal = false;
-    subIndex = 0;
+    pCurrent = pExtra;
+    pSegmentEnd = pExtraEnd;
+    pExtra = nullptr;
   }
 
   return *this;
@@ -1862,24 +1811,12 @@ inline bool small_list_const_reverse_iterator<T, internal_count>::operator!=(con
   return position >= (int64_t)startIndex;
 }
 
-template<typename T, size_t internal_count>
-inline bool small_list_const_reverse_iterator<T, internal_count>::operator!=(const small_list_iterator<T, internal_count> &it) const
-{
-  return position >= (int64_t)it.position;
-}
-
 template<typename T, size_t internal_count>
 inline bool small_list_const_reverse_iterator<T, internal_count>::operator!=(const small_list_reverse_iterator<T, internal_count> &it) const
 {
   return position >= it.position;
 }
 
-template<typename T, size_t internal_count>
-inline bool small_list_const_reverse_iterator<T, internal_count>::operator!=(const small_list_const_iterator<T, internal_count> &it) const
-{
-  return position >= (int64_t)it.position;
-}
-
 template<typename T, size_t internal_count>
 inline bool small_list_const_reverse_iterator<T, internal_count>::operator!=(const small_list_const_reverse_iterator<T, internal_count> &it) const
 {
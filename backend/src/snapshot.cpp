@@ -0,0 +1,929 @@
+#include "snapshot.h"
+
+#include "schedd.h"
+#include "writer.h"
+#include "io.h"
+
+#include <stddef.h>
+#include <atomic>
+#include <thread>
+
+#ifdef SCHEDD_ZLIB
+#include <zlib.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+static_assert(sizeof(snapshot_user_record::availableTimePerDay) == DaysPerWeek * sizeof(time_span_t));
+
+constexpr size_t SnapshotPoolBlockSize = sizeof(uint64_t) * CHAR_BIT; // items per `pool<T>` block.
+constexpr size_t SnapshotHeaderChecksumOffset = offsetof(snapshot_header, version);
+constexpr char SnapshotSegmentPrefixes[spt_Count] = { 'u', 'e' };
+constexpr size_t SnapshotMaxLoadThreads = 16;
+constexpr size_t SnapshotMaxSegmentBytes = (size_t)1 << 30; // bounds the decoded size of compressed segments.
+
+#ifdef SCHEDD_ZLIB
+constexpr int32_t SnapshotCompressionLevel = Z_BEST_SPEED; // checkpoints are written while serving, the ratio barely improves on higher levels.
+#endif
+
+// Assume mutex lock.
+static small_list<snapshot_segment_entry> _SnapshotSegments[spt_Count]; // of the snapshot on disk, index: block.
+static uint64_t _SnapshotGeneration = 0;
+static bool _SnapshotIsPending = false;
+
+struct snapshot_pending_segment
+{
+  snapshot_pool_type type;
+  size_t blockIndex;
+  bool hasFile; // false if the block became empty.
+};
+
+// The snapshot between `snapshot_build` & its commit. Owned by the checkpointing thread until it's handed to the writer.
+static const char *_SnapshotFilename = nullptr;
+static uint64_t _SnapshotPendingJournalSequence = 0;
+static uint64_t _SnapshotPendingGeneration = 0;
+static size_t _SnapshotPendingScheduleDay = ScheduleDayNone;
+static time_point_t _SnapshotPendingScheduleComputedTime = 0;
+static small_list<snapshot_segment_entry> _SnapshotPendingSegments[spt_Count];
+static small_list<snapshot_pending_segment> _SnapshotPendingChanges;
+static small_list<writer_file, 1> _SnapshotPendingFiles; // in the order of the segments with `hasFile`.
+
+//////////////////////////////////////////////////////////////////////////
+
+uint64_t snapshot_checksum(const uint8_t *pData, const size_t size)
+{
+  constexpr uint64_t Multiplier = 0x9E3779B97F4A7C15;
+
+  uint64_t hash = 0xCBF29CE484222325 ^ size;
+  size_t i = 0;
+
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+  {
+    uint64_t word;
+    memcpy(&word, pData + i, sizeof(word));
+
+    hash = (hash ^ word) * Multiplier;
+    hash ^= hash >> 29;
+  }
+
+  uint64_t tail = 0;
+  memcpy(&tail, pData + i, size - i);
+
+  hash = (hash ^ tail) * Multiplier;
+  hash ^= hash >> 32;
+
+  return hash;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+inline bool snapshot_range_valid(const uint64_t offset, const uint64_t count, const uint64_t capacity)
+{
+  return offset <= capacity && count <= capacity - offset;
+}
+
+void snapshot_record_from_user(const user &usr, _Out_ snapshot_user_record *pRecord)
+{
+  lsZeroMemory(pRecord);
+
+  pRecord->availableTimePerDayCount = usr.availableTimePerDay.count;
+
+  for (size_t i = 0; i < usr.availableTimePerDay.count; i++)
+    pRecord->availableTimePerDay[i] = usr.availableTimePerDay[i];
+}
+
+void snapshot_record_from_event(const event &evnt, _Out_ snapshot_event_record *pRecord)
+{
+  lsZeroMemory(pRecord);
+
+  pRecord->durationTimeSpan = evnt.durationTimeSpan;
+  pRecord->weight = evnt.weight;
+  pRecord->weightGrowthFactor = evnt.weightGrowthFactor;
+  pRecord->possibleExecutionDays = evnt.possibleExecutionDays;
+  pRecord->repetitionTimeSpan = evnt.repetitionTimeSpan;
+  pRecord->creationTime = evnt.creationTime;
+  pRecord->lastCompletedTime = evnt.lastCompletedTime;
+  pRecord->lastModifiedTime = evnt.lastModifiedTime;
+}
+
+bool snapshot_record_valid(const snapshot_user_record &record, const uint64_t stringBytes, const uint64_t idCount)
+{
+  return record.nameLength > 0 && record.nameLength <= MaxNameLength && snapshot_range_valid(record.nameOffset, record.nameLength, stringBytes)
+    && snapshot_range_valid(record.completedTasksOffset, record.completedTaskCount, idCount)
+    && record.availableTimePerDayCount <= DaysPerWeek;
+}
+
+bool snapshot_record_valid(const snapshot_event_record &record, const uint64_t stringBytes, const uint64_t idCount)
+{
+  return record.nameLength > 0 && record.nameLength <= MaxNameLength && snapshot_range_valid(record.nameOffset, record.nameLength, stringBytes)
+    && snapshot_range_valid(record.userIdsOffset, record.userIdCount, idCount)
+    && record.possibleExecutionDays <= wF_All;
+}
+
+lsResult snapshot_user_from_record(const snapshot_user_record &record, const char *pStrings, const uint64_t *pIds, _Out_ user *pUser)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(arena_string_set(&pUser->username, pStrings + record.nameOffset, record.nameLength));
+
+  for (size_t i = 0; i < record.availableTimePerDayCount; i++)
+    LS_ERROR_CHECK(list_add(&pUser->availableTimePerDay, record.availableTimePerDay[i]));
+
+  for (size_t i = 0; i < record.completedTaskCount; i++)
+    LS_ERROR_CHECK(list_add(&pUser->completedTasksForCurrentDay, (size_t)pIds[record.completedTasksOffset + i]));
+
+epilogue:
+  return result;
+}
+
+lsResult snapshot_event_from_record(const snapshot_event_record &record, const char *pStrings, const uint64_t *pIds, _Out_ event *pEvent)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(arena_string_set(&pEvent->name, pStrings + record.nameOffset, record.nameLength));
+
+  for (size_t i = 0; i < record.userIdCount; i++)
+    LS_ERROR_CHECK(list_add(&pEvent->userIds, (size_t)pIds[record.userIdsOffset + i]));
+
+  pEvent->durationTimeSpan = record.durationTimeSpan;
+  pEvent->weight = record.weight;
+  pEvent->weightGrowthFactor = record.weightGrowthFactor;
+  pEvent->possibleExecutionDays = (weekday_flags)record.possibleExecutionDays;
+  pEvent->repetitionTimeSpan = record.repetitionTimeSpan;
+  pEvent->creationTime = record.creationTime;
+  pEvent->lastCompletedTime = record.lastCompletedTime;
+  pEvent->lastModifiedTime = record.lastModifiedTime;
+
+epilogue:
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+
+struct snapshot_segment_builder
+{
+  char *pStrings = nullptr;
+  uint64_t *pIds = nullptr;
+  snapshot_user_schedule *pSchedules = nullptr; // user segments only.
+  size_t stringOffset = 0;
+  size_t idOffset = 0;
+};
+
+inline void snapshot_add_string(snapshot_segment_builder &builder, const arena_string &string, _Out_ uint64_t *pOffset, _Out_ uint64_t *pLength)
+{
+  const size_t length = arena_string_length(string);
+
+  memcpy(builder.pStrings + builder.stringOffset, arena_string_get(string), length);
+
+  *pOffset = builder.stringOffset;
+  *pLength = length;
+  builder.stringOffset += length;
+}
+
+template <typename TList>
+inline void snapshot_add_ids(snapshot_segment_builder &builder, const TList &list, _Out_ uint64_t *pOffset, _Out_ uint64_t *pCount)
+{
+  *pOffset = builder.idOffset;
+  *pCount = list.count;
+
+  for (const size_t id : list)
+    builder.pIds[builder.idOffset++] = id;
+}
+
+inline void snapshot_add_encoded_size(const user &usr, _In_Out_ size_t *pStringBytes, _In_Out_ size_t *pIdCount)
+{
+  *pStringBytes += arena_string_length(usr.username);
+  *pIdCount += usr.completedTasksForCurrentDay.count + usr.tasksForCurrentDay.count + usr.tooLongTasksForCurrentDay.count;
+}
+
+inline void snapshot_add_encoded_size(const event &evnt, _In_Out_ size_t *pStringBytes, _In_Out_ size_t *pIdCount)
+{
+  *pStringBytes += arena_string_length(evnt.name);
+  *pIdCount += evnt.userIds.count;
+}
+
+inline void snapshot_encode_record(snapshot_segment_builder &builder, const user &usr, _Out_ snapshot_user_record *pRecord)
+{
+  snapshot_record_from_user(usr, pRecord);
+  snapshot_add_string(builder, usr.username, &pRecord->nameOffset, &pRecord->nameLength);
+  snapshot_add_ids(builder, usr.completedTasksForCurrentDay, &pRecord->completedTasksOffset, &pRecord->completedTaskCount);
+}
+
+inline void snapshot_encode_record(snapshot_segment_builder &builder, const event &evnt, _Out_ snapshot_event_record *pRecord)
+{
+  snapshot_record_from_event(evnt, pRecord);
+  snapshot_add_string(builder, evnt.name, &pRecord->nameOffset, &pRecord->nameLength);
+  snapshot_add_ids(builder, evnt.userIds, &pRecord->userIdsOffset, &pRecord->userIdCount);
+}
+
+inline void snapshot_encode_schedule(snapshot_segment_builder &builder, const user &usr, const size_t subIndex)
+{
+  snapshot_user_schedule &schedule = builder.pSchedules[subIndex];
+
+  snapshot_add_ids(builder, usr.tasksForCurrentDay, &schedule.tasksOffset, &schedule.taskCount);
+  snapshot_add_ids(builder, usr.tooLongTasksForCurrentDay, &schedule.tooLongTasksOffset, &schedule.tooLongTaskCount);
+}
+
+inline void snapshot_encode_schedule(snapshot_segment_builder &, const event &, const size_t) {}
+
+inline lsResult snapshot_decode_record(const snapshot_user_record &record, const char *pStrings, const uint64_t *pIds, _Out_ user *pUser)
+{
+  return snapshot_user_from_record(record, pStrings, pIds, pUser);
+}
+
+inline lsResult snapshot_decode_record(const snapshot_event_record &record, const char *pStrings, const uint64_t *pIds, _Out_ event *pEvent)
+{
+  return snapshot_event_from_record(record, pStrings, pIds, pEvent);
+}
+
+inline lsResult snapshot_decode_schedule(const snapshot_user_schedule *pSchedules, const size_t subIndex, const uint64_t *pIds, const uint64_t idCount, _Out_ user *pUser)
+{
+  lsResult result = lsR_Success;
+
+  const snapshot_user_schedule &schedule = pSchedules[subIndex];
+
+  LS_ERROR_IF(!snapshot_range_valid(schedule.tasksOffset, schedule.taskCount, idCount) || !snapshot_range_valid(schedule.tooLongTasksOffset, schedule.tooLongTaskCount, idCount), lsR_ResourceInvalid);
+
+  for (size_t i = 0; i < schedule.taskCount; i++)
+    LS_ERROR_CHECK(list_add(&pUser->tasksForCurrentDay, (size_t)pIds[schedule.tasksOffset + i]));
+
+  for (size_t i = 0; i < schedule.tooLongTaskCount; i++)
+    LS_ERROR_CHECK(list_add(&pUser->tooLongTasksForCurrentDay, (size_t)pIds[schedule.tooLongTasksOffset + i]));
+
+epilogue:
+  return result;
+}
+
+inline lsResult snapshot_decode_schedule(const snapshot_user_schedule *, const size_t, const uint64_t *, const uint64_t, _Out_ event *)
+{
+  return lsR_Success;
+}
+
+template <typename TRecord>
+inline size_t snapshot_get_segment_schedules_offset()
+{
+  return sizeof(snapshot_segment_header) + SnapshotPoolBlockSize * sizeof(TRecord);
+}
+
+template <typename TRecord>
+inline size_t snapshot_get_segment_ids_offset()
+{
+  constexpr size_t SchedulesSize = std::is_same_v<TRecord, snapshot_user_record> ? SnapshotPoolBlockSize * sizeof(snapshot_user_schedule) : 0;
+
+  return snapshot_get_segment_schedules_offset<TRecord>() + SchedulesSize;
+}
+
+lsResult snapshot_get_segment_filename(const char *filename, const snapshot_pool_type type, const size_t blockIndex, const uint64_t generation, _Out_ char (&segmentFilename)[WriterMaxFilenameLength])
+{
+  lsResult result = lsR_Success;
+
+  const char prefix[] = { '.', SnapshotSegmentPrefixes[type], '\0' };
+
+  LS_ERROR_IF(!sformat_to(segmentFilename, LS_ARRAYSIZE(segmentFilename), filename, prefix, blockIndex, ".", generation), lsR_ArgumentOutOfBounds);
+
+epilogue:
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Timestamps of neighbouring events are close to each other, the differences deflate far better than the absolute values. Wraps around, so it's lossless for any value.
+void snapshot_delta_encode_times(snapshot_event_record *pRecords, const uint64_t occupancyMask, const bool decode)
+{
+  uint64_t previous[3] = { 0, 0, 0 };
+
+  for (uint64_t mask = occupancyMask; mask != 0; mask &= mask - 1)
+  {
+    snapshot_event_record &record = pRecords[lsLowestBit(mask)];
+    uint64_t *times[] = { &record.creationTime, &record.lastCompletedTime, &record.lastModifiedTime };
+
+    for (size_t i = 0; i < LS_ARRAYSIZE(times); i++)
+    {
+      if (decode)
+      {
+        *times[i] += previous[i];
+        previous[i] = *times[i];
+      }
+      else
+      {
+        const uint64_t value = *times[i];
+        *times[i] -= previous[i];
+        previous[i] = value;
+      }
+    }
+  }
+}
+
+void snapshot_delta_encode_segment(uint8_t *pData, const bool decode)
+{
+  const snapshot_segment_header *pHeader = reinterpret_cast<const snapshot_segment_header *>(pData);
+
+  if (pHeader->poolType == spt_Events)
+    snapshot_delta_encode_times(reinterpret_cast<snapshot_event_record *>(pData + sizeof(snapshot_segment_header)), pHeader->occupancyMask, decode);
+}
+
+// Replaces `pFile->pData` with the compressed segment, if that's smaller. Called outside of the lock, the file is owned by the pending snapshot.
+lsResult snapshot_compress_segment(_In_Out_ writer_file *pFile)
+{
+  lsResult result = lsR_Success;
+
+#ifdef SCHEDD_ZLIB
+  uint8_t *pCompressed = nullptr;
+  const size_t bodySize = pFile->size - sizeof(snapshot_segment_header);
+  uLongf compressedBodySize = compressBound((uLong)bodySize);
+
+  LS_ERROR_CHECK(lsAlloc(&pCompressed, sizeof(snapshot_segment_header) + compressedBodySize));
+
+  snapshot_delta_encode_segment(pFile->pData, false);
+
+  if (compress2(pCompressed + sizeof(snapshot_segment_header), &compressedBodySize, pFile->pData + sizeof(snapshot_segment_header), (uLong)bodySize, SnapshotCompressionLevel) != Z_OK || compressedBodySize >= bodySize)
+  {
+    snapshot_delta_encode_segment(pFile->pData, true);
+    goto epilogue; // stays raw.
+  }
+
+  memcpy(pCompressed, pFile->pData, sizeof(snapshot_segment_header));
+  reinterpret_cast<snapshot_segment_header *>(pCompressed)->encoding = sse_Deflate;
+
+  std::swap(pFile->pData, pCompressed);
+  pFile->size = sizeof(snapshot_segment_header) + compressedBodySize;
+
+epilogue:
+  lsFreePtr(&pCompressed);
+#else
+  (void)pFile;
+#endif
+
+  return result;
+}
+
+// Inflates a compressed segment into `ppDecoded`, sized as if it had been stored raw. Expects the header to be validated.
+lsResult snapshot_decompress_segment(const uint8_t *pData, const size_t size, const size_t decodedSize, _Out_ uint8_t **ppDecoded)
+{
+  lsResult result = lsR_Success;
+
+#ifdef SCHEDD_ZLIB
+  uLongf decodedBodySize = (uLongf)(decodedSize - sizeof(snapshot_segment_header));
+
+  LS_ERROR_CHECK(lsAlloc(ppDecoded, decodedSize));
+  memcpy(*ppDecoded, pData, sizeof(snapshot_segment_header));
+
+  LS_ERROR_IF(uncompress(*ppDecoded + sizeof(snapshot_segment_header), &decodedBodySize, pData + sizeof(snapshot_segment_header), (uLong)(size - sizeof(snapshot_segment_header))) != Z_OK, lsR_ResourceInvalid);
+  LS_ERROR_IF(decodedBodySize != decodedSize - sizeof(snapshot_segment_header), lsR_ResourceInvalid);
+
+  snapshot_delta_encode_segment(*ppDecoded, true);
+
+epilogue:
+  if (LS_FAILED(result))
+    lsFreePtr(ppDecoded);
+#else
+  (void)pData;
+  (void)size;
+  (void)decodedSize;
+  (void)ppDecoded;
+
+  LS_ERROR_SET(lsR_NotSupported);
+
+epilogue:
+#endif
+
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template <typename T, typename TRecord>
+lsResult snapshot_encode_segment(const pool<T> &pool, const snapshot_pool_type type, const size_t blockIndex, const uint64_t generation, _Out_ writer_file *pFile) // Assumes mutex lock
+{
+  lsResult result = lsR_Success;
+
+  const uint64_t occupancyMask = pool.pBlockEmptyMask[blockIndex];
+  const T *pBlock = pool.ppBlocks[blockIndex];
+  const size_t idsOffset = snapshot_get_segment_ids_offset<TRecord>();
+
+  snapshot_segment_builder builder;
+  size_t stringBytes = 0;
+  size_t idCount = 0;
+
+  for (uint64_t mask = occupancyMask; mask != 0; mask &= mask - 1)
+    snapshot_add_encoded_size(pBlock[lsLowestBit(mask)], &stringBytes, &idCount);
+
+  LS_ERROR_CHECK(snapshot_get_segment_filename(_SnapshotFilename, type, blockIndex, generation, pFile->filename));
+
+  pFile->size = idsOffset + idCount * sizeof(uint64_t) + stringBytes;
+  LS_ERROR_CHECK(lsAllocZero(&pFile->pData, pFile->size));
+
+  // Header.
+  {
+    snapshot_segment_header *pHeader = reinterpret_cast<snapshot_segment_header *>(pFile->pData);
+
+    pHeader->magic = SnapshotSegmentMagic;
+    pHeader->version = SnapshotVersion;
+    pHeader->poolType = type;
+    pHeader->encoding = sse_Raw; // compressed in `snapshot_write`, outside of the lock.
+    pHeader->blockIndex = blockIndex;
+    pHeader->generation = generation;
+    pHeader->occupancyMask = occupancyMask;
+    pHeader->idCount = idCount;
+    pHeader->stringBytes = stringBytes;
+  }
+
+  builder.pIds = reinterpret_cast<uint64_t *>(pFile->pData + idsOffset);
+  builder.pStrings = reinterpret_cast<char *>(pFile->pData + idsOffset + idCount * sizeof(uint64_t));
+
+  if constexpr (std::is_same_v<T, user>)
+    builder.pSchedules = reinterpret_cast<snapshot_user_schedule *>(pFile->pData + snapshot_get_segment_schedules_offset<TRecord>());
+
+  // Records, empty slots stay zeroed.
+  {
+    TRecord *pRecords = reinterpret_cast<TRecord *>(pFile->pData + sizeof(snapshot_segment_header));
+
+    for (uint64_t mask = occupancyMask; mask != 0; mask &= mask - 1)
+    {
+      const size_t subIndex = lsLowestBit(mask);
+      snapshot_encode_record(builder, pBlock[subIndex], &pRecords[subIndex]);
+      snapshot_encode_schedule(builder, pBlock[subIndex], subIndex);
+    }
+  }
+
+  lsAssert(builder.stringOffset == stringBytes);
+  lsAssert(builder.idOffset == idCount);
+
+epilogue:
+  if (LS_FAILED(result))
+    lsFreePtr(&pFile->pData);
+
+  return result;
+}
+
+template <typename T, typename TRecord>
+lsResult snapshot_build_pool(const pool<T> &pool, const snapshot_pool_type type) // Assumes mutex lock
+{
+  lsResult result = lsR_Success;
+
+  const small_list<snapshot_segment_entry> &segments = _SnapshotSegments[type];
+
+  for (size_t blockIndex = 0; blockIndex < pool.blockCount; blockIndex++)
+  {
+    snapshot_segment_entry entry;
+    lsZeroMemory(&entry);
+
+    if (blockIndex < segments.count)
+      entry = segments[blockIndex];
+
+    const bool isOccupied = pool.pBlockEmptyMask[blockIndex] != 0;
+
+    // Clean blocks keep their segment file. Blocks without a dirty slot can still mismatch their segment, if a previous load or write didn't cover them.
+    if (pool.pBlockDirtyMask[blockIndex] != 0 || isOccupied != (entry.generation != 0))
+    {
+      snapshot_pending_segment change;
+      change.type = type;
+      change.blockIndex = blockIndex;
+      change.hasFile = isOccupied;
+
+      lsZeroMemory(&entry);
+
+      if (isOccupied)
+      {
+        LS_ERROR_CHECK(list_add(&_SnapshotPendingFiles, writer_file()));
+
+        writer_file &file = _SnapshotPendingFiles[_SnapshotPendingFiles.count - 1];
+        LS_ERROR_CHECK((snapshot_encode_segment<T, TRecord>(pool, type, blockIndex, _SnapshotPendingGeneration, &file)));
+
+        entry.generation = _SnapshotPendingGeneration; // size & checksum are set in `snapshot_write`, once it's compressed.
+      }
+
+      LS_ERROR_CHECK(list_add(&_SnapshotPendingChanges, change));
+    }
+
+    LS_ERROR_CHECK(list_add(&_SnapshotPendingSegments[type], entry));
+  }
+
+epilogue:
+  return result;
+}
+
+void snapshot_reset_pending()
+{
+  for (writer_file &file : _SnapshotPendingFiles)
+    lsFreePtr(&file.pData);
+
+  list_clear(&_SnapshotPendingFiles);
+  list_clear(&_SnapshotPendingChanges);
+
+  for (small_list<snapshot_segment_entry> &segments : _SnapshotPendingSegments)
+    list_clear(&segments);
+}
+
+void snapshot_set_block_dirty(const snapshot_pool_type type, const size_t blockIndex, const uint64_t dirtyMask) // Assumes mutex lock
+{
+  if (type == spt_Users)
+    _Users.pBlockDirtyMask[blockIndex] = dirtyMask;
+  else
+    _Events.pBlockDirtyMask[blockIndex] = dirtyMask;
+}
+
+lsResult snapshot_build(const char *filename, const uint64_t journalSequence)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(filename == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(_SnapshotIsPending, lsR_ResourceBusy);
+
+  _SnapshotFilename = filename;
+  _SnapshotPendingJournalSequence = journalSequence;
+  _SnapshotPendingGeneration = _SnapshotGeneration + 1;
+  get_schedule_day(&_SnapshotPendingScheduleDay, &_SnapshotPendingScheduleComputedTime);
+
+  snapshot_reset_pending();
+
+  LS_ERROR_CHECK((snapshot_build_pool<user, snapshot_user_record>(_Users, spt_Users)));
+  LS_ERROR_CHECK((snapshot_build_pool<event, snapshot_event_record>(_Events, spt_Events)));
+
+  // The changed blocks are now owned by the pending snapshot, `snapshot_commit` marks them dirty again if it can't be written.
+  for (const snapshot_pending_segment &change : _SnapshotPendingChanges)
+    snapshot_set_block_dirty(change.type, change.blockIndex, 0);
+
+  _SnapshotIsPending = true;
+
+epilogue:
+  if (LS_FAILED(result))
+    snapshot_reset_pending();
+
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+struct snapshot_obsolete_segment
+{
+  snapshot_pool_type type;
+  size_t blockIndex;
+  uint64_t generation;
+};
+
+void snapshot_commit(const lsResult writeResult) // Called on the writer thread.
+{
+  small_list<snapshot_obsolete_segment> obsoleteSegments;
+  const char *filename = _SnapshotFilename;
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_ThreadLock);
+
+    if (LS_SUCCESS(writeResult))
+    {
+      for (const snapshot_pending_segment &change : _SnapshotPendingChanges)
+      {
+        const small_list<snapshot_segment_entry> &segments = _SnapshotSegments[change.type];
+
+        if (change.blockIndex >= segments.count || segments[change.blockIndex].generation == 0)
+          continue;
+
+        snapshot_obsolete_segment obsolete;
+        obsolete.type = change.type;
+        obsolete.blockIndex = change.blockIndex;
+        obsolete.generation = segments[change.blockIndex].generation;
+
+        if (LS_FAILED(list_add(&obsoleteSegments, obsolete)))
+          break; // only leaves stale files behind.
+      }
+
+      for (size_t i = 0; i < spt_Count; i++)
+        std::swap(_SnapshotSegments[i], _SnapshotPendingSegments[i]);
+
+      _SnapshotGeneration = _SnapshotPendingGeneration;
+    }
+    else
+    {
+      for (const snapshot_pending_segment &change : _SnapshotPendingChanges)
+        snapshot_set_block_dirty(change.type, change.blockIndex, lsMaxValue<uint64_t>());
+    }
+
+    snapshot_reset_pending();
+    _SnapshotIsPending = false;
+  }
+
+  for (const snapshot_obsolete_segment &obsolete : obsoleteSegments)
+  {
+    char segmentFilename[WriterMaxFilenameLength];
+
+    if (LS_SUCCESS(snapshot_get_segment_filename(filename, obsolete.type, obsolete.blockIndex, obsolete.generation, segmentFilename)))
+      remove(segmentFilename);
+  }
+}
+
+lsResult snapshot_write(std::function<void(const lsResult writeResult)> &&callback)
+{
+  lsResult result = lsR_Success;
+
+  writer_file manifest;
+
+  LS_ERROR_IF(!_SnapshotIsPending, lsR_ResourceStateInvalid);
+
+  // Segment compression & checksums.
+  {
+    size_t fileIndex = 0;
+    size_t rawBytes = 0;
+    size_t storedBytes = 0;
+    const int64_t startTimeNs = lsGetCurrentTimeNs();
+
+    for (const snapshot_pending_segment &change : _SnapshotPendingChanges)
+    {
+      if (!change.hasFile)
+        continue;
+
+      writer_file &file = _SnapshotPendingFiles[fileIndex++];
+      snapshot_segment_entry &entry = _SnapshotPendingSegments[change.type][change.blockIndex];
+
+      rawBytes += file.size;
+      LS_ERROR_CHECK(snapshot_compress_segment(&file));
+      storedBytes += file.size;
+
+      entry.size = file.size;
+      entry.checksum = snapshot_checksum(file.pData, file.size);
+    }
+
+    if (fileIndex > 0)
+      print_log_line("Snapshot: encoded ", fileIndex, " segments, ", rawBytes, " bytes -> ", storedBytes, " bytes (", storedBytes * 100 / rawBytes, "%) in ", (lsGetCurrentTimeNs() - startTimeNs) / 1000, " us.");
+  }
+
+  // Manifest, written last.
+  {
+    const size_t entryCount = _SnapshotPendingSegments[spt_Users].count + _SnapshotPendingSegments[spt_Events].count;
+
+    LS_ERROR_IF(!lsCopyString(manifest.filename, LS_ARRAYSIZE(manifest.filename), _SnapshotFilename, lsStringLength(_SnapshotFilename) + 1), lsR_ArgumentOutOfBounds);
+
+    manifest.size = sizeof(snapshot_header) + entryCount * sizeof(snapshot_segment_entry);
+    LS_ERROR_CHECK(lsAllocZero(&manifest.pData, manifest.size));
+
+    snapshot_header *pHeader = reinterpret_cast<snapshot_header *>(manifest.pData);
+    snapshot_segment_entry *pEntries = reinterpret_cast<snapshot_segment_entry *>(manifest.pData + sizeof(snapshot_header));
+
+    pHeader->magic = SnapshotMagic;
+    pHeader->version = SnapshotVersion;
+    pHeader->poolCount = spt_Count;
+    pHeader->fileSize = manifest.size;
+    pHeader->journalSequence = _SnapshotPendingJournalSequence;
+    pHeader->generation = _SnapshotPendingGeneration;
+    pHeader->scheduleDay = _SnapshotPendingScheduleDay;
+    pHeader->scheduleComputedTime = _SnapshotPendingScheduleComputedTime;
+
+    for (size_t i = 0; i < spt_Count; i++)
+    {
+      pHeader->blockCounts[i] = _SnapshotPendingSegments[i].count;
+
+      for (const snapshot_segment_entry &entry : _SnapshotPendingSegments[i])
+        *(pEntries++) = entry;
+    }
+
+    pHeader->headerChecksum = snapshot_checksum(manifest.pData + SnapshotHeaderChecksumOffset, manifest.size - SnapshotHeaderChecksumOffset);
+
+    LS_ERROR_CHECK(list_add(&_SnapshotPendingFiles, manifest));
+    manifest.pData = nullptr;
+  }
+
+  LS_ERROR_CHECK(writer_enqueue_files(_SnapshotFilename, std::move(_SnapshotPendingFiles), [callback = std::move(callback)](const lsResult writeResult) {
+    snapshot_commit(writeResult);
+
+    if (callback)
+      callback(writeResult);
+  }));
+
+epilogue:
+  lsFreePtr(&manifest.pData);
+
+  if (LS_FAILED(result) && _SnapshotIsPending)
+    snapshot_commit(result);
+
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template <typename T, typename TRecord>
+lsResult snapshot_load_segment(pool<T> *pPool, const char *filename, const snapshot_pool_type type, const size_t blockIndex, const snapshot_segment_entry &entry) // Only touches `blockIndex`, so segments can be loaded concurrently.
+{
+  lsResult result = lsR_Success;
+
+  const size_t idsOffset = snapshot_get_segment_ids_offset<TRecord>();
+
+  mapped_file file;
+  char segmentFilename[WriterMaxFilenameLength];
+  const snapshot_segment_header *pHeader = nullptr;
+  uint8_t *pDecoded = nullptr;
+  const uint8_t *pData = nullptr;
+  size_t size = 0;
+
+  LS_ERROR_CHECK(snapshot_get_segment_filename(filename, type, blockIndex, entry.generation, segmentFilename));
+  LS_ERROR_CHECK(lsMapFile(segmentFilename, &file));
+
+  LS_ERROR_IF(file.size != entry.size || file.size < sizeof(snapshot_segment_header), lsR_ResourceInvalid);
+  LS_ERROR_IF(snapshot_checksum(file.pData, file.size) != entry.checksum, lsR_ResourceInvalid);
+
+  pHeader = reinterpret_cast<const snapshot_segment_header *>(file.pData);
+
+  LS_ERROR_IF(pHeader->magic != SnapshotSegmentMagic || pHeader->version != SnapshotVersion, lsR_ResourceInvalid);
+  LS_ERROR_IF(pHeader->poolType != type || pHeader->blockIndex != blockIndex || pHeader->generation != entry.generation, lsR_ResourceInvalid);
+
+  if (pHeader->encoding == sse_Deflate)
+  {
+    LS_ERROR_IF(pHeader->idCount > SnapshotMaxSegmentBytes / sizeof(uint64_t) || pHeader->stringBytes > SnapshotMaxSegmentBytes, lsR_ResourceInvalid);
+
+    size = idsOffset + pHeader->idCount * sizeof(uint64_t) + pHeader->stringBytes;
+    LS_ERROR_CHECK(snapshot_decompress_segment(file.pData, file.size, size, &pDecoded));
+
+    pData = pDecoded;
+  }
+  else
+  {
+    LS_ERROR_IF(pHeader->encoding != sse_Raw, lsR_ResourceIncompatible);
+
+    pData = file.pData;
+    size = file.size;
+  }
+
+  LS_ERROR_IF(size < idsOffset, lsR_ResourceInvalid);
+  LS_ERROR_IF(pHeader->idCount > (size - idsOffset) / sizeof(uint64_t) || size - idsOffset - pHeader->idCount * sizeof(uint64_t) != pHeader->stringBytes, lsR_ResourceInvalid);
+
+  {
+    const TRecord *pRecords = reinterpret_cast<const TRecord *>(pData + sizeof(snapshot_segment_header));
+    const snapshot_user_schedule *pSchedules = reinterpret_cast<const snapshot_user_schedule *>(pData + snapshot_get_segment_schedules_offset<TRecord>()); // user segments only.
+    const uint64_t *pIds = reinterpret_cast<const uint64_t *>(pData + idsOffset);
+    const char *pStrings = reinterpret_cast<const char *>(pIds + pHeader->idCount);
+
+    for (uint64_t mask = pHeader->occupancyMask; mask != 0; mask &= mask - 1)
+    {
+      const size_t subIndex = lsLowestBit(mask);
+      T item;
+
+      LS_ERROR_IF(!snapshot_record_valid(pRecords[subIndex], pHeader->stringBytes, pHeader->idCount), lsR_ResourceInvalid);
+      LS_ERROR_CHECK(snapshot_decode_record(pRecords[subIndex], pStrings, pIds, &item));
+      LS_ERROR_CHECK(snapshot_decode_schedule(pSchedules, subIndex, pIds, pHeader->idCount, &item));
+      LS_ERROR_CHECK(pool_insertAt_concurrent(pPool, std::move(item), blockIndex * SnapshotPoolBlockSize + subIndex));
+    }
+  }
+
+epilogue:
+  lsFreePtr(&pDecoded);
+  lsUnmapFile(&file);
+  return result;
+}
+
+struct snapshot_load_task
+{
+  snapshot_pool_type type;
+  size_t blockIndex;
+  snapshot_segment_entry entry;
+};
+
+lsResult snapshot_load_pool_segments(const snapshot_pool_type type, const snapshot_segment_entry *pEntries, const size_t blockCount, _In_Out_ small_list<snapshot_load_task> *pTasks) // Assumes mutex lock
+{
+  lsResult result = lsR_Success;
+
+  if (type == spt_Users)
+    LS_ERROR_CHECK(pool_reserve_blocks(&_Users, blockCount));
+  else
+    LS_ERROR_CHECK(pool_reserve_blocks(&_Events, blockCount));
+
+  for (size_t blockIndex = 0; blockIndex < blockCount; blockIndex++)
+  {
+    if (pEntries[blockIndex].generation != 0)
+    {
+      snapshot_load_task task;
+      task.type = type;
+      task.blockIndex = blockIndex;
+      task.entry = pEntries[blockIndex];
+
+      LS_ERROR_CHECK(list_add(pTasks, task));
+    }
+
+    LS_ERROR_CHECK(list_add(&_SnapshotSegments[type], pEntries[blockIndex]));
+  }
+
+epilogue:
+  return result;
+}
+
+// Segments are independent, so they're decoded on up to `SnapshotMaxLoadThreads` threads (incl. the calling one), each inserting into its own blocks.
+lsResult snapshot_load_segments(const char *filename, const small_list<snapshot_load_task> &tasks) // Assumes mutex lock
+{
+  lsResult result = lsR_Success;
+
+  std::atomic<size_t> nextTask = 0;
+  std::atomic<lsResult> firstError = lsR_Success;
+  std::thread threads[SnapshotMaxLoadThreads];
+  size_t threadCount = lsMin((size_t)lsMax(std::thread::hardware_concurrency(), 1U), SnapshotMaxLoadThreads);
+
+  const auto worker = [&]() {
+    while (firstError.load(std::memory_order_relaxed) == lsR_Success)
+    {
+      const size_t taskIndex = nextTask.fetch_add(1, std::memory_order_relaxed);
+
+      if (taskIndex >= tasks.count)
+        break;
+
+      const snapshot_load_task &task = tasks[taskIndex];
+      const lsResult taskResult = task.type == spt_Users
+        ? snapshot_load_segment<user, snapshot_user_record>(&_Users, filename, task.type, task.blockIndex, task.entry)
+        : snapshot_load_segment<event, snapshot_event_record>(&_Events, filename, task.type, task.blockIndex, task.entry);
+
+      if (LS_FAILED(taskResult))
+      {
+        lsResult expected = lsR_Success;
+        firstError.compare_exchange_strong(expected, taskResult);
+      }
+    }
+  };
+
+  threadCount = lsMin(threadCount, tasks.count);
+
+  for (size_t i = 1; i < threadCount; i++)
+    threads[i] = std::thread(worker);
+
+  worker();
+
+  for (size_t i = 1; i < threadCount; i++)
+    threads[i].join();
+
+  pool_recount(&_Users);
+  pool_recount(&_Events);
+
+  LS_ERROR_CHECK(firstError.load());
+
+epilogue:
+  return result;
+}
+
+lsResult snapshot_load(const char *filename, _Out_ uint64_t *pJournalSequence)
+{
+  lsResult result = lsR_Success;
+
+  mapped_file file;
+  const snapshot_header *pHeader = nullptr;
+  const snapshot_segment_entry *pEntries = nullptr;
+  small_list<snapshot_load_task> tasks;
+
+  LS_ERROR_IF(filename == nullptr || pJournalSequence == nullptr, lsR_ArgumentNull);
+  LS_ERROR_CHECK(lsMapFile(filename, &file));
+
+  pHeader = reinterpret_cast<const snapshot_header *>(file.pData);
+  pEntries = reinterpret_cast<const snapshot_segment_entry *>(file.pData + sizeof(snapshot_header));
+
+  LS_ERROR_IF(file.size < sizeof(snapshot_header), lsR_ResourceInvalid);
+  LS_ERROR_IF(pHeader->magic != SnapshotMagic, lsR_ResourceInvalid);
+  LS_ERROR_IF(pHeader->version != SnapshotVersion || pHeader->poolCount != spt_Count, lsR_ResourceIncompatible);
+  LS_ERROR_IF(pHeader->fileSize != file.size, lsR_ResourceInvalid);
+  LS_ERROR_IF(pHeader->headerChecksum != snapshot_checksum(file.pData + SnapshotHeaderChecksumOffset, file.size - SnapshotHeaderChecksumOffset), lsR_ResourceInvalid);
+  LS_ERROR_IF(pHeader->blockCounts[spt_Users] > file.size || pHeader->blockCounts[spt_Events] > file.size, lsR_ResourceInvalid);
+  LS_ERROR_IF(file.size != sizeof(snapshot_header) + (pHeader->blockCounts[spt_Users] + pHeader->blockCounts[spt_Events]) * sizeof(snapshot_segment_entry), lsR_ResourceInvalid);
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_ThreadLock);
+
+    LS_ERROR_IF(_Users.count != 0 || _Events.count != 0 || _SnapshotIsPending, lsR_ResourceStateInvalid);
+
+    for (small_list<snapshot_segment_entry> &segments : _SnapshotSegments)
+      list_clear(&segments);
+
+    // Reserve all blocks up front, so the loading threads never reallocate the pools.
+    result = snapshot_load_pool_segments(spt_Users, pEntries, pHeader->blockCounts[spt_Users], &tasks);
+
+    if (LS_SUCCESS(result))
+      result = snapshot_load_pool_segments(spt_Events, pEntries + pHeader->blockCounts[spt_Users], pHeader->blockCounts[spt_Events], &tasks);
+
+    if (LS_SUCCESS(result))
+      result = snapshot_load_segments(filename, tasks);
+
+    if (LS_FAILED(result))
+    {
+      pool_clear(&_Users);
+      pool_clear(&_Events);
+
+      for (small_list<snapshot_segment_entry> &segments : _SnapshotSegments)
+        list_clear(&segments);
+
+      goto epilogue;
+    }
+
+    // Loaded items match their segments.
+    for (size_t blockIndex = 0; blockIndex < _Users.blockCount; blockIndex++)
+      pool_clear_dirty(&_Users, blockIndex);
+
+    for (size_t blockIndex = 0; blockIndex < _Events.blockCount; blockIndex++)
+      pool_clear_dirty(&_Events, blockIndex);
+
+    _SnapshotFilename = filename;
+    _SnapshotGeneration = pHeader->generation;
+
+    restore_schedule_day((size_t)pHeader->scheduleDay, pHeader->scheduleComputedTime);
+  }
+
+  *pJournalSequence = pHeader->journalSequence;
+
+epilogue:
+  lsUnmapFile(&file);
+  return result;
+}
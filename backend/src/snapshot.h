@@ -0,0 +1,138 @@
+#pragma once
+
+#include "core.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+// Segmented binary image of `_Users` and `_Events`:
+//
+//   `<filename>`: snapshot_header, snapshot_segment_entry[userBlockCount + eventBlockCount]
+//   `<filename>.u<block>.<generation>` / `<filename>.e<block>.<generation>`, one per non-empty `pool<T>` block:
+//     snapshot_segment_header, record[64], (users only: snapshot_user_schedule[64]), uint64_t ids[idCount], names[stringBytes] (not null terminated)
+//
+// With `SCHEDD_ZLIB` everything after the segment header is deflated, event timestamps are delta encoded beforehand (see `snapshot_segment_encoding`).
+// Segments that don't shrink are stored raw. Builds without zlib can still load raw segments, but refuse compressed ones.
+//
+// Only blocks with dirty slots are re-encoded & written, all other segments are carried over from the previous snapshot.
+// Segment files are never overwritten: dirty blocks get a file of the new generation and the manifest is replaced last, so a crash leaves the previous snapshot intact.
+// Superseded segment files are deleted once the new manifest is on disk. All values are native endian. JSON remains the export format.
+// The computed daily schedules are part of the user segments, the manifest states the day they're current for (see `get_schedule_day`).
+
+constexpr uint64_t SnapshotMagic = 0x50414E5344484353; // "SCHDSNAP"
+constexpr uint64_t SnapshotSegmentMagic = 0x544D475344484353; // "SCHDSGMT"
+constexpr uint32_t SnapshotVersion = 5;
+
+enum snapshot_pool_type : uint32_t
+{
+  spt_Users,
+  spt_Events,
+
+  spt_Count,
+};
+
+enum snapshot_segment_encoding : uint32_t
+{
+  sse_Raw,
+  sse_Deflate, // zlib stream of the records, ids & names. Timestamps are stored as the difference to the previous occupied slot's.
+};
+
+struct snapshot_header
+{
+  uint64_t magic;
+  uint64_t headerChecksum; // of everything after this field, incl. the segment table.
+  uint32_t version;
+  uint32_t poolCount;
+  uint64_t fileSize;
+  uint64_t journalSequence; // the last journal record contained in this snapshot.
+  uint64_t generation;
+  uint64_t scheduleDay; // `ScheduleDayNone` if the schedules are outdated.
+  uint64_t scheduleComputedTime;
+  uint64_t blockCounts[spt_Count];
+};
+
+struct snapshot_segment_entry
+{
+  uint64_t generation; // 0 if the block is empty & has no segment file.
+  uint64_t checksum; // of the whole segment file.
+  uint64_t size;
+};
+
+struct snapshot_segment_header
+{
+  uint64_t magic;
+  uint32_t version;
+  uint32_t poolType;
+  uint32_t encoding; // `snapshot_segment_encoding`.
+  uint32_t reserved;
+  uint64_t blockIndex;
+  uint64_t generation;
+  uint64_t occupancyMask;
+  uint64_t idCount;
+  uint64_t stringBytes;
+};
+
+struct snapshot_user_record
+{
+  uint64_t nameOffset;
+  uint64_t nameLength;
+  uint64_t completedTasksOffset; // index into the ids section.
+  uint64_t completedTaskCount;
+  uint64_t availableTimePerDayCount;
+  int64_t availableTimePerDay[7];
+};
+
+struct snapshot_user_schedule // not part of `snapshot_user_record`, as the journal doesn't carry schedules.
+{
+  uint64_t tasksOffset; // index into the ids section.
+  uint64_t taskCount;
+  uint64_t tooLongTasksOffset; // index into the ids section.
+  uint64_t tooLongTaskCount;
+};
+
+struct snapshot_event_record
+{
+  uint64_t nameOffset;
+  uint64_t nameLength;
+  uint64_t userIdsOffset; // index into the ids section.
+  uint64_t userIdCount;
+  int64_t durationTimeSpan;
+  uint64_t weight;
+  uint64_t weightGrowthFactor;
+  uint64_t possibleExecutionDays;
+  int64_t repetitionTimeSpan;
+  uint64_t creationTime;
+  uint64_t lastCompletedTime;
+  uint64_t lastModifiedTime;
+};
+
+static_assert(sizeof(snapshot_header) % sizeof(uint64_t) == 0);
+static_assert(sizeof(snapshot_segment_header) % sizeof(uint64_t) == 0);
+static_assert(sizeof(snapshot_user_record) % sizeof(uint64_t) == 0);
+static_assert(sizeof(snapshot_user_schedule) % sizeof(uint64_t) == 0);
+static_assert(sizeof(snapshot_event_record) % sizeof(uint64_t) == 0);
+
+//////////////////////////////////////////////////////////////////////////
+
+struct user;
+struct event;
+struct writer_file;
+
+uint64_t snapshot_checksum(const uint8_t *pData, const size_t size);
+
+// The segment codec, also measured by `schedd-bench`.
+lsResult snapshot_compress_segment(_In_Out_ writer_file *pFile); // Replaces `pFile->pData` with the compressed segment, if that's smaller.
+lsResult snapshot_decompress_segment(const uint8_t *pData, const size_t size, const size_t decodedSize, _Out_ uint8_t **ppDecoded); // Sized as if it had been stored raw. Expects the header to be validated.
+
+// Records are shared with the journal. Name & id ranges are filled in by the caller.
+void snapshot_record_from_user(const user &usr, _Out_ snapshot_user_record *pRecord);
+void snapshot_record_from_event(const event &evnt, _Out_ snapshot_event_record *pRecord);
+bool snapshot_record_valid(const snapshot_user_record &record, const uint64_t stringBytes, const uint64_t idCount);
+bool snapshot_record_valid(const snapshot_event_record &record, const uint64_t stringBytes, const uint64_t idCount);
+lsResult snapshot_user_from_record(const snapshot_user_record &record, const char *pStrings, const uint64_t *pIds, _Out_ user *pUser);
+lsResult snapshot_event_from_record(const snapshot_event_record &record, const char *pStrings, const uint64_t *pIds, _Out_ event *pEvent);
+
+// The checkpoint: `snapshot_build` under the mutex, then `snapshot_write` without it. Only one snapshot can be in flight at a time.
+lsResult snapshot_build(const char *filename, const uint64_t journalSequence); // Assumes mutex lock. Encodes the dirty blocks, returns `lsR_ResourceBusy` while the previous snapshot is still being written.
+lsResult snapshot_write(std::function<void(const lsResult writeResult)> &&callback); // Hands the built snapshot to the writer thread, `callback` is called once it's on disk.
+
+lsResult snapshot_load(const char *filename, _Out_ uint64_t *pJournalSequence); // Expects `_Users` and `_Events` to be empty, leaves them empty on failure.
@@ -0,0 +1,213 @@
+#include "static_assets.h"
+
+#include "io.h"
+#include "response_compression.h"
+#include "schedd.h"
+#include "small_list.h"
+
+#include <filesystem>
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////
+
+constexpr char StaticAssetHtmlContentType[] = "text/html; charset=utf-8";
+constexpr char StaticAssetVersionPrefix[] = "?v=";
+constexpr size_t StaticAssetVersionLength = 16; // 64 bit hex.
+
+struct static_asset_content_type
+{
+  const char *extension;
+  const char *contentType;
+};
+
+constexpr static_asset_content_type StaticAssetContentTypes[] =
+{
+  { ".html", StaticAssetHtmlContentType },
+  { ".css", "text/css; charset=utf-8" },
+  { ".js", "text/javascript; charset=utf-8" },
+  { ".json", "application/json" },
+  { ".svg", "image/svg+xml" },
+  { ".png", "image/png" },
+  { ".jpg", "image/jpeg" },
+  { ".ico", "image/x-icon" },
+  { ".webp", "image/webp" },
+  { ".woff2", "font/woff2" },
+};
+
+static small_list<static_asset> _StaticAssets; // Written once by `static_assets_load`, read-only afterwards.
+
+//////////////////////////////////////////////////////////////////////////
+
+static const char *_StaticAssetContentType(const char *path)
+{
+  const char *extension = strrchr(path, '.');
+
+  if (extension != nullptr)
+    for (const auto &type : StaticAssetContentTypes)
+      if (strcmp(extension, type.extension) == 0)
+        return type.contentType;
+
+  return "application/octet-stream";
+}
+
+static bool _StaticAssetIsHtml(const static_asset &asset)
+{
+  return asset.contentType == StaticAssetHtmlContentType;
+}
+
+static lsResult _StaticAssetLoadFile(const char *filename, const char *path)
+{
+  lsResult result = lsR_Success;
+
+  static_asset asset = {};
+
+  LS_ERROR_IF(strlen(path) > StaticAssetMaxPathLength, lsR_ArgumentOutOfBounds);
+  LS_ERROR_CHECK(lsReadFile(filename, &asset.pBody, &asset.bodySize));
+  LS_ERROR_IF(asset.bodySize > StaticAssetMaxBytes, lsR_ResourceInvalid);
+
+  lsCopyString(asset.path, LS_ARRAYSIZE(asset.path), path, strlen(path) + 1);
+  asset.contentType = _StaticAssetContentType(path);
+
+  LS_ERROR_CHECK(list_add(&_StaticAssets, asset));
+
+epilogue:
+  if (LS_FAILED(result))
+    lsFreePtr(&asset.pBody);
+
+  return result;
+}
+
+// Appends `?v=<etag>` to every quoted reference of another (non-HTML) asset. References are expected relative to the directory root.
+static lsResult _StaticAssetVersionReferences(static_asset *pHtml)
+{
+  lsResult result = lsR_Success;
+
+  constexpr char HexDigits[] = "0123456789abcdef";
+
+  std::string versioned;
+  uint8_t *pVersioned = nullptr;
+  size_t i = 0;
+
+  versioned.reserve(pHtml->bodySize);
+
+  while (i < pHtml->bodySize)
+  {
+    const char c = (char)pHtml->pBody[i];
+    versioned.push_back(c);
+    i++;
+
+    if (c != '"' && c != '\'')
+      continue;
+
+    for (const static_asset &asset : _StaticAssets)
+    {
+      const size_t pathLength = strlen(asset.path);
+
+      if (_StaticAssetIsHtml(asset) || i + pathLength >= pHtml->bodySize || pHtml->pBody[i + pathLength] != (uint8_t)c || memcmp(pHtml->pBody + i, asset.path, pathLength) != 0)
+        continue;
+
+      versioned.append(asset.path, pathLength);
+      versioned.append(StaticAssetVersionPrefix);
+
+      for (size_t digit = 0; digit < StaticAssetVersionLength; digit++)
+        versioned.push_back(HexDigits[(asset.etag >> ((StaticAssetVersionLength - 1 - digit) * 4)) & 0xF]);
+
+      i += pathLength;
+      break;
+    }
+  }
+
+  LS_ERROR_CHECK(lsAlloc(&pVersioned, versioned.size()));
+  memcpy(pVersioned, versioned.data(), versioned.size());
+
+  lsFreePtr(&pHtml->pBody);
+  pHtml->pBody = pVersioned;
+  pHtml->bodySize = versioned.size();
+
+epilogue:
+  return result;
+}
+
+static lsResult _StaticAssetCompress(static_asset *pAsset)
+{
+  lsResult result = lsR_Success;
+
+  std::string compressed;
+
+  if (LS_FAILED(response_compress(re_Gzip, reinterpret_cast<const char *>(pAsset->pBody), pAsset->bodySize, &compressed, ResponseCompressionMaxLevel)))
+    goto epilogue; // served uncompressed only.
+
+  LS_ERROR_CHECK(lsAlloc(&pAsset->pGzipBody, compressed.size()));
+  memcpy(pAsset->pGzipBody, compressed.data(), compressed.size());
+  pAsset->gzipBodySize = compressed.size();
+  pAsset->gzipEtag = etag_hash(pAsset->pGzipBody, pAsset->gzipBodySize);
+
+epilogue:
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult static_assets_load(const char *directory)
+{
+  lsResult result = lsR_Success;
+
+  std::error_code error;
+  size_t totalBytes = 0;
+  size_t totalGzipBytes = 0;
+
+  LS_ERROR_IF(directory == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(_StaticAssets.count != 0, lsR_ResourceStateInvalid);
+
+  for (auto it = std::filesystem::recursive_directory_iterator(directory, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+  {
+    if (!it->is_regular_file(error))
+      continue;
+
+    const std::string path = std::filesystem::relative(it->path(), directory, error).generic_string();
+
+    if (error || path.empty() || path[0] == '.')
+      continue;
+
+    if (LS_FAILED(_StaticAssetLoadFile(it->path().string().c_str(), path.c_str())))
+      print_error_line("Static assets: skipping '", path.c_str(), "'.");
+  }
+
+  LS_ERROR_IF(error, lsR_IOFailure);
+
+  // The versioned references in HTML files depend on the tags of everything else.
+  for (static_asset &asset : _StaticAssets)
+    if (!_StaticAssetIsHtml(asset))
+      asset.etag = etag_hash(asset.pBody, asset.bodySize);
+
+  for (static_asset &asset : _StaticAssets)
+  {
+    if (_StaticAssetIsHtml(asset))
+    {
+      LS_ERROR_CHECK(_StaticAssetVersionReferences(&asset));
+      asset.etag = etag_hash(asset.pBody, asset.bodySize);
+    }
+
+    LS_ERROR_CHECK(_StaticAssetCompress(&asset));
+
+    totalBytes += asset.bodySize;
+    totalGzipBytes += asset.pGzipBody != nullptr ? asset.gzipBodySize : asset.bodySize;
+  }
+
+  print_log_line("Static assets: loaded ", _StaticAssets.count, " files from '", directory, "', ", totalBytes, " bytes, ", totalGzipBytes, " bytes gzipped.");
+
+epilogue:
+  return result;
+}
+
+const static_asset *static_assets_find(const char *path)
+{
+  if (path == nullptr)
+    return nullptr;
+
+  for (const static_asset &asset : _StaticAssets)
+    if (strcmp(asset.path, path) == 0)
+      return &asset;
+
+  return nullptr;
+}
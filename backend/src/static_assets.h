@@ -0,0 +1,29 @@
+#pragma once
+
+#include "core.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+// The frontend, loaded into memory once at startup & served by the backend itself, so the API is same-origin & its POSTs don't need a CORS preflight.
+// Every asset has a precompressed gzip variant (if that's smaller), both representations have their own strong ETag. References to other assets in HTML files get `?v=<etag>` appended,
+// so those URLs change with the content & can be cached indefinitely, while the HTML itself is revalidated on every visit.
+
+constexpr size_t StaticAssetMaxBytes = 16 * 1024 * 1024; // larger files aren't served.
+constexpr size_t StaticAssetMaxPathLength = 255;
+constexpr char StaticAssetIndexPath[] = "index.html"; // served for `/`.
+
+// Kept for the lifetime of the process.
+struct static_asset
+{
+  char path[StaticAssetMaxPathLength + 1]; // relative to the directory, with `/` separators.
+  const char *contentType;
+  uint8_t *pBody;
+  size_t bodySize;
+  uint8_t *pGzipBody; // `nullptr` if compressing didn't make it smaller.
+  size_t gzipBodySize;
+  uint64_t etag; // of `pBody`, also the version in references.
+  uint64_t gzipEtag; // of `pGzipBody`.
+};
+
+lsResult static_assets_load(const char *directory); // Call once before serving, the assets are immutable afterwards.
+const static_asset *static_assets_find(const char *path); // `nullptr` if there's no asset at `path`.
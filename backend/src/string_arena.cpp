@@ -0,0 +1,251 @@
+#include "string_arena.h"
+
+#include <mutex>
+
+//////////////////////////////////////////////////////////////////////////
+
+static std::mutex _ArenaLock;
+static arena_string_entry **_ppArenaBuckets = nullptr;
+static size_t _ArenaBucketCount = 0;
+static size_t _ArenaEntryCount = 0;
+
+//////////////////////////////////////////////////////////////////////////
+
+uint64_t arena_string_hash(const char *text, const size_t length)
+{
+  // FNV-1a
+  uint64_t hash = 0xCBF29CE484222325ULL;
+
+  for (size_t i = 0; i < length; i++)
+    hash = (hash ^ (uint8_t)text[i]) * 0x100000001B3ULL;
+
+  return hash;
+}
+
+lsResult arena_grow_buckets() // Assumes arena lock
+{
+  lsResult result = lsR_Success;
+
+  const size_t newBucketCount = _ArenaBucketCount == 0 ? 1024 : _ArenaBucketCount * 2;
+  arena_string_entry **ppNewBuckets = nullptr;
+
+  LS_ERROR_CHECK(lsAllocZero(&ppNewBuckets, newBucketCount));
+
+  for (size_t i = 0; i < _ArenaBucketCount; i++)
+  {
+    arena_string_entry *pEntry = _ppArenaBuckets[i];
+
+    while (pEntry != nullptr)
+    {
+      arena_string_entry *pNext = pEntry->pNext;
+      const size_t bucket = pEntry->hash & (newBucketCount - 1);
+
+      pEntry->pNext = ppNewBuckets[bucket];
+      ppNewBuckets[bucket] = pEntry;
+
+      pEntry = pNext;
+    }
+  }
+
+  lsFreePtr(&_ppArenaBuckets);
+  _ppArenaBuckets = ppNewBuckets;
+  _ArenaBucketCount = newBucketCount;
+
+epilogue:
+  return result;
+}
+
+lsResult arena_intern(const char *text, const size_t length, _Out_ arena_string_entry **ppEntry)
+{
+  lsResult result = lsR_Success;
+
+  const uint64_t hash = arena_string_hash(text, length);
+  arena_string_entry *pEntry = nullptr;
+
+  LS_ERROR_IF(length > lsMaxValue<uint32_t>(), lsR_ArgumentOutOfBounds);
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_ArenaLock);
+
+    if (_ArenaBucketCount > 0)
+    {
+      for (pEntry = _ppArenaBuckets[hash & (_ArenaBucketCount - 1)]; pEntry != nullptr; pEntry = pEntry->pNext)
+      {
+        if (pEntry->hash == hash && pEntry->length == length && memcmp(pEntry->text, text, length) == 0)
+        {
+          pEntry->referenceCount++;
+          *ppEntry = pEntry;
+          goto epilogue;
+        }
+      }
+    }
+
+    if (_ArenaEntryCount >= _ArenaBucketCount)
+      LS_ERROR_CHECK(arena_grow_buckets());
+
+    {
+      uint8_t *pMemory = nullptr;
+      LS_ERROR_CHECK(lsAlloc(&pMemory, sizeof(arena_string_entry) + length));
+
+      pEntry = reinterpret_cast<arena_string_entry *>(pMemory);
+      new (&pEntry->referenceCount) std::atomic<uint32_t>(1);
+      pEntry->length = (uint32_t)length;
+      pEntry->hash = hash;
+      memcpy(pEntry->text, text, length);
+      pEntry->text[length] = '\0';
+
+      const size_t bucket = hash & (_ArenaBucketCount - 1);
+      pEntry->pNext = _ppArenaBuckets[bucket];
+      _ppArenaBuckets[bucket] = pEntry;
+      _ArenaEntryCount++;
+    }
+
+    *ppEntry = pEntry;
+  }
+
+epilogue:
+  return result;
+}
+
+void arena_release(arena_string_entry *pEntry)
+{
+  uint32_t referenceCount = pEntry->referenceCount.load(std::memory_order_relaxed);
+
+  // Not the last reference: no need to touch the intern table.
+  while (referenceCount > 1)
+    if (pEntry->referenceCount.compare_exchange_weak(referenceCount, referenceCount - 1, std::memory_order_acq_rel))
+      return;
+
+  // Possibly the last reference: decrement under the lock, so `arena_intern` can't revive the entry while it's being freed.
+  std::scoped_lock lock(_ArenaLock);
+
+  if (pEntry->referenceCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    return;
+
+  arena_string_entry **ppLink = &_ppArenaBuckets[pEntry->hash & (_ArenaBucketCount - 1)];
+
+  while (*ppLink != pEntry)
+    ppLink = &(*ppLink)->pNext;
+
+  *ppLink = pEntry->pNext;
+  _ArenaEntryCount--;
+
+  pEntry->referenceCount.~atomic();
+  lsFreePtr(&pEntry);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult arena_string_set(_Out_ arena_string *pString, const char *text, const size_t length)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(pString == nullptr || (text == nullptr && length > 0), lsR_ArgumentNull);
+
+  if (length <= ArenaStringInplaceCapacity)
+  {
+    char inplace[ArenaStringInplaceCapacity + 1]; // `text` may point into `pString`.
+
+    if (length > 0)
+      memcpy(inplace, text, length);
+
+    inplace[length] = '\0';
+
+    arena_string_clear(pString);
+
+    memcpy(pString->inplace, inplace, length + 1);
+    pString->inplaceLength = (uint8_t)length;
+  }
+  else
+  {
+    arena_string_entry *pEntry = nullptr;
+    LS_ERROR_CHECK(arena_intern(text, length, &pEntry));
+
+    arena_string_clear(pString);
+
+    memcpy(pString->inplace, &pEntry, sizeof(pEntry));
+    pString->inplaceLength = ArenaStringInterned;
+  }
+
+epilogue:
+  return result;
+}
+
+lsResult arena_string_set(_Out_ arena_string *pString, const char *text)
+{
+  return arena_string_set(pString, text, text == nullptr ? 0 : strlen(text));
+}
+
+void arena_string_clear(arena_string *pString)
+{
+  if (pString->inplaceLength == ArenaStringInterned)
+    arena_release(arena_string_get_entry(*pString));
+
+  pString->inplace[0] = '\0';
+  pString->inplaceLength = 0;
+}
+
+size_t arena_string_get_interned_count()
+{
+  std::scoped_lock lock(_ArenaLock);
+
+  return _ArenaEntryCount;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+arena_string::arena_string(const arena_string &copy)
+{
+  memcpy(inplace, copy.inplace, sizeof(inplace));
+  inplaceLength = copy.inplaceLength;
+
+  if (inplaceLength == ArenaStringInterned)
+    arena_string_get_entry(*this)->referenceCount.fetch_add(1, std::memory_order_relaxed); // the copied string holds a reference, so the entry can't be released concurrently.
+}
+
+arena_string::arena_string(arena_string &&move) noexcept
+{
+  memcpy(inplace, move.inplace, sizeof(inplace));
+  inplaceLength = move.inplaceLength;
+
+  move.inplace[0] = '\0';
+  move.inplaceLength = 0;
+}
+
+arena_string &arena_string::operator=(const arena_string &copy)
+{
+  if (this == &copy)
+    return *this;
+
+  if (copy.inplaceLength == ArenaStringInterned)
+    arena_string_get_entry(copy)->referenceCount.fetch_add(1, std::memory_order_relaxed);
+
+  arena_string_clear(this);
+
+  memcpy(inplace, copy.inplace, sizeof(inplace));
+  inplaceLength = copy.inplaceLength;
+
+  return *this;
+}
+
+arena_string &arena_string::operator=(arena_string &&move) noexcept
+{
+  if (this == &move)
+    return *this;
+
+  arena_string_clear(this);
+
+  memcpy(inplace, move.inplace, sizeof(inplace));
+  inplaceLength = move.inplaceLength;
+
+  move.inplace[0] = '\0';
+  move.inplaceLength = 0;
+
+  return *this;
+}
+
+arena_string::~arena_string()
+{
+  arena_string_clear(this);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "core.h"
+
+#include <atomic>
+
+//////////////////////////////////////////////////////////////////////////
+
+struct arena_string_entry
+{
+  std::atomic<uint32_t> referenceCount;
+  uint32_t length;
+  uint64_t hash;
+  arena_string_entry *pNext; // next entry in the same bucket of the intern table.
+  char text[1]; // `length` characters + '\0', allocated with the entry.
+};
+
+constexpr size_t ArenaStringInplaceCapacity = 22; // characters, excluding the null terminator.
+constexpr uint8_t ArenaStringInterned = 0xFF;
+
+// Strings up to `ArenaStringInplaceCapacity` characters are stored inline, longer ones are interned & reference counted in the arena.
+// Zeroed memory is a valid empty string, so this can live in `pool` blocks.
+struct arena_string
+{
+  char inplace[ArenaStringInplaceCapacity + 1]; // holds the `arena_string_entry *` if interned.
+  uint8_t inplaceLength = 0; // `ArenaStringInterned` if interned.
+
+  inline arena_string() { inplace[0] = '\0'; }
+  arena_string(const arena_string &copy);
+  arena_string(arena_string &&move) noexcept;
+  arena_string &operator = (const arena_string &copy);
+  arena_string &operator = (arena_string &&move) noexcept;
+  ~arena_string();
+};
+
+static_assert(sizeof(arena_string) == 24);
+
+inline arena_string_entry *arena_string_get_entry(const arena_string &string)
+{
+  arena_string_entry *pEntry;
+  memcpy(&pEntry, string.inplace, sizeof(pEntry));
+  return pEntry;
+}
+
+lsResult arena_string_set(_Out_ arena_string *pString, const char *text, const size_t length);
+lsResult arena_string_set(_Out_ arena_string *pString, const char *text);
+void arena_string_clear(arena_string *pString);
+
+inline const char *arena_string_get(const arena_string &string)
+{
+  return string.inplaceLength == ArenaStringInterned ? arena_string_get_entry(string)->text : string.inplace;
+}
+
+inline size_t arena_string_length(const arena_string &string)
+{
+  return string.inplaceLength == ArenaStringInterned ? arena_string_get_entry(string)->length : string.inplaceLength;
+}
+
+inline bool arena_string_equals(const arena_string &string, const char *text, const size_t length)
+{
+  return arena_string_length(string) == length && memcmp(arena_string_get(string), text, length) == 0;
+}
+
+inline bool arena_string_equals(const arena_string &a, const arena_string &b)
+{
+  if (a.inplaceLength == ArenaStringInterned && b.inplaceLength == ArenaStringInterned)
+    return arena_string_get_entry(a) == arena_string_get_entry(b); // interned strings are unique.
+
+  return arena_string_equals(a, arena_string_get(b), arena_string_length(b));
+}
+
+size_t arena_string_get_interned_count();
@@ -0,0 +1,194 @@
+#include "writer.h"
+
+#include "io.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//////////////////////////////////////////////////////////////////////////
+
+constexpr size_t WriterMaxBatches = 8;
+
+struct writer_batch
+{
+  const char *key = nullptr; // `nullptr` if the slot is empty.
+  small_list<writer_file, 1> files;
+  writer_callback callback;
+};
+
+static std::mutex _WriterLock;
+static std::condition_variable _WriterCondition;
+static std::thread *_pWriterThread = nullptr;
+static bool _WriterIsRunning = false;
+static writer_batch _WriterPending[WriterMaxBatches];
+
+//////////////////////////////////////////////////////////////////////////
+
+void writer_free_files(small_list<writer_file, 1> *pFiles)
+{
+  for (writer_file &file : *pFiles)
+    lsFreePtr(&file.pData);
+
+  list_clear(pFiles);
+}
+
+void writer_thread()
+{
+  while (true)
+  {
+    writer_batch batch;
+
+    // Scope Lock
+    {
+      std::unique_lock lock(_WriterLock);
+
+      const auto findPending = [&]() -> writer_batch * {
+        for (writer_batch &pending : _WriterPending)
+          if (pending.key != nullptr)
+            return &pending;
+
+        return nullptr;
+      };
+
+      writer_batch *pPending = nullptr;
+      _WriterCondition.wait(lock, [&] { return (pPending = findPending()) != nullptr || !_WriterIsRunning; });
+
+      if (pPending == nullptr)
+        return;
+
+      batch.key = pPending->key;
+      batch.files = std::move(pPending->files);
+      batch.callback = std::move(pPending->callback);
+
+      pPending->key = nullptr;
+      pPending->callback = nullptr;
+    }
+
+    lsResult result = lsR_Success;
+
+    for (const writer_file &file : batch.files)
+    {
+      result = lsWriteFileBytesAtomic(file.filename, file.pData, file.size);
+
+      if (LS_FAILED(result))
+      {
+        print_error_line("Failed to write '", file.filename, "'.");
+        break;
+      }
+    }
+
+    writer_free_files(&batch.files);
+
+    if (batch.callback)
+      batch.callback(result);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult writer_start()
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(_pWriterThread != nullptr, lsR_ResourceStateInvalid);
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_WriterLock);
+
+    _WriterIsRunning = true;
+  }
+
+  _pWriterThread = new std::thread(writer_thread);
+
+epilogue:
+  return result;
+}
+
+void writer_stop()
+{
+  if (_pWriterThread == nullptr)
+    return;
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_WriterLock);
+
+    _WriterIsRunning = false;
+  }
+
+  _WriterCondition.notify_all();
+
+  _pWriterThread->join();
+  delete _pWriterThread;
+  _pWriterThread = nullptr;
+}
+
+lsResult writer_enqueue(const char *filename, _In_Out_ uint8_t **ppData, const size_t size, writer_callback &&callback)
+{
+  lsResult result = lsR_Success;
+
+  small_list<writer_file, 1> files;
+  writer_file file;
+
+  LS_ERROR_IF(filename == nullptr || ppData == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(!lsCopyString(file.filename, LS_ARRAYSIZE(file.filename), filename, lsStringLength(filename) + 1), lsR_ArgumentOutOfBounds);
+
+  file.pData = *ppData;
+  file.size = size;
+  *ppData = nullptr;
+
+  LS_ERROR_CHECK(list_add(&files, file));
+  file.pData = nullptr;
+
+  LS_ERROR_CHECK(writer_enqueue_files(filename, std::move(files), std::move(callback)));
+
+epilogue:
+  lsFreePtr(&file.pData);
+  writer_free_files(&files);
+
+  return result;
+}
+
+lsResult writer_enqueue_files(const char *key, small_list<writer_file, 1> &&files, writer_callback &&callback)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(key == nullptr, lsR_ArgumentNull);
+
+  // Scope Lock
+  {
+    std::scoped_lock lock(_WriterLock);
+
+    writer_batch *pSlot = nullptr;
+
+    LS_ERROR_IF(!_WriterIsRunning, lsR_ResourceStateInvalid);
+
+    for (writer_batch &pending : _WriterPending)
+    {
+      if (pending.key != nullptr && strcmp(pending.key, key) == 0)
+      {
+        pSlot = &pending;
+        break;
+      }
+
+      if (pending.key == nullptr && pSlot == nullptr)
+        pSlot = &pending;
+    }
+
+    LS_ERROR_IF(pSlot == nullptr, lsR_ResourceFull);
+
+    writer_free_files(&pSlot->files); // superseded by the new batch.
+
+    pSlot->key = key;
+    pSlot->files = std::move(files);
+    pSlot->callback = std::move(callback);
+  }
+
+  _WriterCondition.notify_one();
+
+epilogue:
+  writer_free_files(&files); // only left over on failure.
+  return result;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "core.h"
+#include "small_list.h"
+
+#include <functional>
+
+//////////////////////////////////////////////////////////////////////////
+
+// Writes serialized file images on a dedicated thread, so neither the request handlers nor the reschedule worker wait on the disk.
+// Per key there is one batch being written & at most one pending batch. A newer pending batch replaces the older one, without calling its callback.
+
+constexpr size_t WriterMaxFilenameLength = 128;
+
+struct writer_file
+{
+  char filename[WriterMaxFilenameLength];
+  uint8_t *pData = nullptr; // allocated with `lsAlloc`, owned by the writer once enqueued.
+  size_t size = 0;
+};
+
+typedef std::function<void(const lsResult writeResult)> writer_callback; // Called on the writer thread after the batch has been written.
+
+lsResult writer_start();
+void writer_stop(); // Writes the pending batches before returning.
+
+lsResult writer_enqueue(const char *filename, _In_Out_ uint8_t **ppData, const size_t size, writer_callback &&callback = nullptr); // Takes ownership of `*ppData`, `filename` has to outlive the write.
+lsResult writer_enqueue_files(const char *key, small_list<writer_file, 1> &&files, writer_callback &&callback = nullptr); // Writes the files in order & stops at the first failure. `key` has to outlive the write.